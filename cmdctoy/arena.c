@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if CMDCTOY_POSIX && defined(__GLIBC__)
+#include <execinfo.h>
+#endif /* CMDCTOY_POSIX && defined(__GLIBC__) */
+#include "arena.h"
+#include "list.h"
+#include "toydef.h"
+#include "toylib.h"
+
+struct arena_block;
+union arena_header;
+
+struct arena_block
+  {
+    struct list_item list_item;
+    struct stdlib_arena * arena;
+    size_t size;
+    /* Where it was allocated, when the memory profile is on */
+    struct memory_site * site;
+  };
+
+/* Sized and aligned for anything that follows it */
+union arena_header
+  {
+    struct arena_block block;
+    long int align_long;
+    long double align_long_double;
+    void * align_pointer;
+  };
+
+static union arena_header * allocate_block(struct stdlib_arena *, size_t);
+static apifunction_stdlib_free arena_free;
+static apifunction_stdlib_malloc arena_malloc;
+static apifunction_stdlib_realloc arena_realloc;
+static void forget_block(union arena_header *);
+static struct memory_site * record_block(struct stdlib_arena *, union arena_header *);
+
+static struct memory_profile * profile;
+/*
+ * Non-zero while an arena is calling its parent, which might be an arena,
+ * too.  Only the outermost arena's blocks are recorded in the profile
+ */
+static int nested;
+/* The nice-name of the module that's working, or NULL */
+static const char * worker;
+
+/* There's no parent to give to api_initialize, so it isn't available */
+static struct api_stdlib api_stdlib_arena_defaults =
+  {
+    NULL,
+    &arena_free,
+    &arena_malloc,
+    &arena_realloc,
+    0,
+    0
+  };
+
+static union arena_header * allocate_block(struct stdlib_arena * arena, size_t size)
+  {
+    union arena_header * header;
+
+    if (size > (size_t) -1 - sizeof *header)
+      return NULL;
+    ++nested;
+    header = arena->parent->malloc(arena->parent, sizeof *header + size);
+    --nested;
+    if (header == NULL)
+      return NULL;
+    header->block.arena = arena;
+    header->block.size = size;
+    header->block.site = NULL;
+    (void) arena->api_list->add_item_to_list_tail(arena->api_list, &header->block.list_item, &arena->blocks);
+    ++arena->objects;
+    arena->bytes += (unsigned long int) size;
+    ++arena->api.allocations;
+    arena->api.allocated_bytes += size;
+    return header;
+  }
+
+static void arena_free(struct api_stdlib * api, void * ptr)
+  {
+    struct stdlib_arena * arena;
+    union arena_header * header;
+
+    (void) api;
+
+    if (ptr == NULL)
+      return;
+    header = (union arena_header *) ptr - 1;
+    arena = header->block.arena;
+    forget_block(header);
+    (void) arena->api_list->remove_list_item(arena->api_list, &header->block.list_item);
+    --arena->objects;
+    arena->bytes -= (unsigned long int) header->block.size;
+    ++nested;
+    arena->parent->free(arena->parent, header);
+    --nested;
+  }
+
+static void * arena_malloc(struct api_stdlib * api, size_t size)
+  {
+    struct stdlib_arena * arena;
+    union arena_header * header;
+
+    arena = type_with_member_at_ptr(struct stdlib_arena, api, api);
+    header = allocate_block(arena, size);
+    if (header == NULL)
+      return NULL;
+    header->block.site = record_block(arena, header);
+    return header + 1;
+  }
+
+/* A reallocated block is counted as being allocated again, at the new site */
+static void * arena_realloc(struct api_stdlib * api, void * ptr, size_t size)
+  {
+    struct stdlib_arena * arena;
+    union arena_header * header;
+    union arena_header * new_header;
+
+    if (ptr == NULL)
+      {
+        arena = type_with_member_at_ptr(struct stdlib_arena, api, api);
+        header = allocate_block(arena, size);
+        if (header == NULL)
+          return NULL;
+        header->block.site = record_block(arena, header);
+        return header + 1;
+      }
+    header = (union arena_header *) ptr - 1;
+    arena = header->block.arena;
+    if (size > (size_t) -1 - sizeof *header)
+      return NULL;
+    /* The block might move, so it's unlinked first and linked again, wherever it ends up */
+    (void) arena->api_list->remove_list_item(arena->api_list, &header->block.list_item);
+    ++nested;
+    new_header = arena->parent->realloc(arena->parent, header, sizeof *header + size);
+    --nested;
+    if (new_header == NULL)
+      {
+        (void) arena->api_list->add_item_to_list_tail(arena->api_list, &header->block.list_item, &arena->blocks);
+        return NULL;
+      }
+    forget_block(new_header);
+    arena->bytes -= (unsigned long int) new_header->block.size;
+    arena->bytes += (unsigned long int) size;
+    new_header->block.size = size;
+    (void) arena->api_list->add_item_to_list_tail(arena->api_list, &new_header->block.list_item, &arena->blocks);
+    ++arena->api.allocations;
+    arena->api.allocated_bytes += size;
+    new_header->block.site = record_block(arena, new_header);
+    return new_header + 1;
+  }
+
+static void forget_block(union arena_header * header)
+  {
+    struct memory_site * site;
+
+    site = header->block.site;
+    if (site == NULL)
+      return;
+    --site->objects;
+    site->bytes -= (unsigned long int) header->block.size;
+    header->block.site = NULL;
+  }
+
+void initialize_arena(struct stdlib_arena * arena, const char * name, struct api_stdlib * parent, struct api_list * list_api)
+  {
+    arena->api = api_stdlib_arena_defaults;
+    arena->name = name;
+    arena->shared = 0;
+    arena->parent = parent;
+    arena->api_list = list_api;
+    (void) list_api->initialize_list(list_api, &arena->blocks);
+    arena->objects = 0;
+    arena->bytes = 0;
+  }
+
+/* NULL unless start_memory_profile has been called */
+struct memory_profile * memory_profile(void)
+  {
+    return profile;
+  }
+
+/*
+ * Called by arena_malloc and arena_realloc, so the return-address after
+ * theirs is where the allocation was asked for.  Without a way to find the
+ * return-addresses, the name is all that tells sites apart
+ */
+static struct memory_site * record_block(struct stdlib_arena * arena, union arena_header * header)
+  {
+    void * caller;
+    size_t first;
+    unsigned long int hash;
+    size_t i;
+    const char * name;
+    struct memory_site * site;
+#if CMDCTOY_POSIX && defined(__GLIBC__)
+    int count;
+    void * frames[memory_profile_frames + 2];
+    int frame;
+#endif /* CMDCTOY_POSIX && defined(__GLIBC__) */
+
+    if (profile == NULL || nested)
+      return NULL;
+
+    name = arena->shared && worker != NULL ? worker : arena->name;
+    hash = 5381;
+    for (i = 0; name[i] != '\0'; ++i)
+      hash = hash * 33 + (unsigned char) name[i];
+    caller = NULL;
+#if CMDCTOY_POSIX && defined(__GLIBC__)
+    /* Skipping this function and the arena's */
+    count = backtrace(frames, countof(frames));
+    if (count > 2)
+      caller = frames[2];
+    for (frame = 2; frame < count; ++frame)
+      hash = hash * 31 + (unsigned long int) (size_t) frames[frame];
+#endif /* CMDCTOY_POSIX && defined(__GLIBC__) */
+
+    /* Open addressing, and when every site is taken, the allocation isn't recorded */
+    first = hash % memory_profile_sites;
+    i = first;
+    do
+      {
+        site = profile->sites + i;
+        if (site->name[0] == '\0')
+          {
+            strncpy(site->name, name, sizeof site->name - 1);
+            site->hash = hash;
+            site->caller = caller;
+            site->objects = 0;
+            site->bytes = 0;
+            site->allocations = 0;
+            site->allocated_bytes = 0;
+            ++profile->count;
+            break;
+          }
+        if (site->hash == hash && site->caller == caller && strncmp(site->name, name, sizeof site->name - 1) == 0)
+          break;
+        i = (i + 1) % memory_profile_sites;
+        site = NULL;
+      }
+    while (i != first);
+    if (site == NULL)
+      return NULL;
+
+    ++site->objects;
+    site->bytes += (unsigned long int) header->block.size;
+    ++site->allocations;
+    site->allocated_bytes += (unsigned long int) header->block.size;
+    return site;
+  }
+
+/* Frees whatever is still outstanding */
+void release_arena(struct stdlib_arena * arena)
+  {
+    union arena_header * header;
+    struct list_item * list_item;
+
+    while ((list_item = arena->api_list->remove_item_from_list_head(arena->api_list, &arena->blocks)) != NULL)
+      {
+        /* The block is at the start of the header */
+        header = type_with_member_at_ptr(struct arena_block, list_item, list_item);
+        forget_block(header);
+        ++nested;
+        arena->parent->free(arena->parent, header);
+        --nested;
+      }
+    arena->objects = 0;
+    arena->bytes = 0;
+  }
+
+/* Starts a new phase: what's outstanding is kept, and the counts of allocations start again */
+void reset_memory_profile(void)
+  {
+    size_t i;
+
+    if (profile == NULL)
+      return;
+    for (i = 0; i < memory_profile_sites; ++i)
+      {
+        profile->sites[i].allocations = 0;
+        profile->sites[i].allocated_bytes = 0;
+      }
+    profile->since = time(NULL);
+  }
+
+/* Gives the name that was set before, so that it can be put back */
+const char * set_memory_profile_worker(const char * name)
+  {
+    const char * old_worker;
+
+    old_worker = worker;
+    worker = name;
+    return old_worker;
+  }
+
+/* Only blocks allocated after this are recorded */
+int start_memory_profile(struct api_stdlib * parent)
+  {
+    size_t i;
+
+    if (profile != NULL)
+      return EXIT_SUCCESS;
+    profile = parent->malloc(parent, sizeof *profile);
+    if (profile == NULL)
+      return EXIT_FAILURE;
+    profile->since = time(NULL);
+    profile->count = 0;
+    for (i = 0; i < memory_profile_sites; ++i)
+      {
+        profile->sites[i].name[0] = '\0';
+        profile->sites[i].name[memory_profile_name_size - 1] = '\0';
+      }
+    return EXIT_SUCCESS;
+  }
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+#ifndef INC_ARENA
+#define INC_ARENA
+
+#include <stddef.h>
+#include <time.h>
+#include "list.h"
+#include "toylib.h"
+
+enum memory_profile_value
+  {
+    /* How many call-sites are told apart, at most */
+    memory_profile_sites = 1024,
+    /* How many return-addresses identify a call-site */
+    memory_profile_frames = 8,
+    /* Longer names of arenas are cut short */
+    memory_profile_name_size = 32,
+    memory_profile_zero = 0
+  };
+
+struct memory_profile;
+struct memory_site;
+struct stdlib_arena;
+
+/*
+ * An arena is an api_stdlib that allocates from another, its parent, and
+ * keeps a list of what it has allocated and hasn't yet been freed, so that
+ * it can be counted and freed all at once.  Whichever arena a block is
+ * freed or reallocated through, it stays with the arena it came from
+ */
+struct stdlib_arena
+  {
+    struct api_stdlib api;
+    /* Whose allocations these are, for the memory profile */
+    const char * name;
+    /*
+     * Non-zero for an arena that modules allocate from through the APIs they
+     * share, such as the program's own.  Its blocks are profiled under the
+     * name of the module that was working, instead of under 'name'
+     */
+    int shared;
+    struct api_stdlib * parent;
+    struct api_list * api_list;
+    struct list blocks;
+    /* Outstanding */
+    unsigned long int objects;
+    unsigned long int bytes;
+  };
+
+/* The allocations asked for by an arena's user at one place, by way of one path of calls */
+struct memory_site
+  {
+    /* Copied, since a module's name goes away with it */
+    char name[memory_profile_name_size];
+    unsigned long int hash;
+    /* Where the allocation was asked for, if that's known */
+    void * caller;
+    /* Outstanding */
+    unsigned long int objects;
+    unsigned long int bytes;
+    /* Since the profile was started or reset */
+    unsigned long int allocations;
+    unsigned long int allocated_bytes;
+  };
+
+/* Sites are found by hash, and unused sites have an empty name */
+struct memory_profile
+  {
+    time_t since;
+    size_t count;
+    struct memory_site sites[memory_profile_sites];
+  };
+
+extern void initialize_arena(struct stdlib_arena *, const char *, struct api_stdlib *, struct api_list *);
+extern struct memory_profile * memory_profile(void);
+extern void release_arena(struct stdlib_arena *);
+extern void reset_memory_profile(void);
+extern const char * set_memory_profile_worker(const char *);
+extern int start_memory_profile(struct api_stdlib *);
+
+#endif /* INC_ARENA */
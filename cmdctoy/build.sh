@@ -3,8 +3,13 @@
 mkdir bin/ 2> /dev/null
 
 # Build the core program:
-gcc -ansi -pedantic -Wall -Wextra -Werror -g -o bin/cmdctoy -D CMDCTOY_POSIX=1 btree.c builtins.c cmd_exit.c cmd_help.c cmd_hexd.c cmd_load.c cmd_mono.c cmd_type.c command.c depend.c gui.c list.c main.c main1st.c mod2.c module.c process.c stage2.c toy.c toyio.c toylib.c toyscope.c type.c -ldl
+gcc -ansi -pedantic -Wall -Wextra -Werror -g -o bin/cmdctoy -D CMDCTOY_POSIX=1 arena.c btree.c builtins.c cmd_bnch.c cmd_comp.c cmd_exit.c cmd_help.c cmd_hexd.c cmd_jobs.c cmd_load.c cmd_math.c cmd_mono.c cmd_serv.c cmd_shm.c cmd_src.c cmd_stat.c cmd_text.c cmd_type.c command.c depend.c gui.c list.c main.c main1st.c mod2.c module.c process.c shmchan.c slab.c stage2.c toy.c toyio.c toylib.c toyscope.c type.c -ldl
 
 # As example items from the builtins, rebuild these loadable modules, too:
 gcc -ansi -pedantic -Wall -Wextra -Werror -shared -g -o bin/gui.so -fPIC -D BUILTIN_GET_USER_INPUT=0 gui.c
 gcc -ansi -pedantic -Wall -Wextra -Werror -shared -g -o bin/cmd_help.so -fPIC -D BUILTIN_CMD_HELP=0 cmd_help.c
+gcc -ansi -pedantic -Wall -Wextra -Werror -shared -g -o bin/cmd_serv.so -fPIC -D BUILTIN_CMD_SERVER=0 -D CMDCTOY_POSIX=1 cmd_serv.c
+
+# For clients of the shared-memory channel, build this object to link with, and a client that measures round trips:
+gcc -ansi -pedantic -Wall -Wextra -Werror -g -c -o bin/shmchan.o -D CMDCTOY_POSIX=1 shmchan.c
+gcc -ansi -pedantic -Wall -Wextra -Werror -g -o bin/shmbench -D CMDCTOY_POSIX=1 shmbench.c bin/shmchan.o
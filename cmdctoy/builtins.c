@@ -17,6 +17,12 @@ struct builtins;
 static apifunction_dependency_observe_call builtin_cleanup;
 static apifunction_dependency_observe_call builtin_shutdown;
 
+#if BUILTIN_CMD_BENCH
+extern union module builtin_module_cmd_bench;
+#endif
+#if BUILTIN_CMD_COMPLETE
+extern union module builtin_module_cmd_complete;
+#endif
 #if BUILTIN_CMD_EXIT
 extern union module builtin_module_cmd_exit;
 #endif
@@ -26,12 +32,33 @@ extern union module builtin_module_cmd_help;
 #if BUILTIN_CMD_HEXDUMP
 extern union module builtin_module_cmd_hexdump;
 #endif
+#if BUILTIN_CMD_JOBS
+extern union module builtin_module_cmd_jobs;
+#endif
 #if BUILTIN_CMD_LOAD
 extern union module builtin_module_cmd_load;
 #endif
+#if BUILTIN_CMD_MATH
+extern union module builtin_module_cmd_math;
+#endif
 #if BUILTIN_CMD_MONO
 extern union module builtin_module_cmd_monolith;
 #endif
+#if BUILTIN_CMD_SERVER
+extern union module builtin_module_cmd_server;
+#endif
+#if BUILTIN_CMD_SHMCHAN
+extern union module builtin_module_cmd_shmchan;
+#endif
+#if BUILTIN_CMD_SOURCE
+extern union module builtin_module_cmd_source;
+#endif
+#if BUILTIN_CMD_STAT
+extern union module builtin_module_cmd_stat;
+#endif
+#if BUILTIN_CMD_TEXT
+extern union module builtin_module_cmd_text;
+#endif
 #if BUILTIN_CMD_TYPE
 extern union module builtin_module_cmd_type;
 #endif
@@ -44,6 +71,12 @@ extern union module builtin_module_mod2;
 
 static union module * builtin_modules_array[] =
   {
+#if BUILTIN_CMD_BENCH
+    &builtin_module_cmd_bench,
+#endif
+#if BUILTIN_CMD_COMPLETE
+    &builtin_module_cmd_complete,
+#endif
 #if BUILTIN_CMD_EXIT
     &builtin_module_cmd_exit,
 #endif
@@ -53,12 +86,33 @@ static union module * builtin_modules_array[] =
 #if BUILTIN_CMD_HEXDUMP
     &builtin_module_cmd_hexdump,
 #endif
+#if BUILTIN_CMD_JOBS
+    &builtin_module_cmd_jobs,
+#endif
 #if BUILTIN_CMD_LOAD
     &builtin_module_cmd_load,
 #endif
+#if BUILTIN_CMD_MATH
+    &builtin_module_cmd_math,
+#endif
 #if BUILTIN_CMD_MONO
     &builtin_module_cmd_monolith,
 #endif
+#if BUILTIN_CMD_SERVER
+    &builtin_module_cmd_server,
+#endif
+#if BUILTIN_CMD_SHMCHAN
+    &builtin_module_cmd_shmchan,
+#endif
+#if BUILTIN_CMD_SOURCE
+    &builtin_module_cmd_source,
+#endif
+#if BUILTIN_CMD_STAT
+    &builtin_module_cmd_stat,
+#endif
+#if BUILTIN_CMD_TEXT
+    &builtin_module_cmd_text,
+#endif
 #if BUILTIN_CMD_TYPE
     &builtin_module_cmd_type,
 #endif
@@ -72,6 +126,15 @@ static union module * builtin_modules_array[] =
   };
 static union module ** builtin_modules = builtin_modules_array;
 static size_t builtin_modules_count = countof(builtin_modules_array) - 1;
+/* These are last in the array, since a session that isn't interactive doesn't load them */
+static size_t builtin_interactive_count = 0
+#if BUILTIN_GET_USER_INPUT
+  + 1
+#endif
+#if BUILTIN_MOD2
+  + 1
+#endif
+  ;
 
 struct builtin
   {
@@ -131,7 +194,7 @@ static void builtin_shutdown(struct api_dependency * api, struct dependency * de
           return;
         /* We have special knowledge that 'builtins' is at the front of the allocation to be freed */
         builtins = type_with_member_at_ptr(struct builtins, cleanup, dependency_observe);
-        (void) builtins->top->api_stdio->fprintf(builtins->top->api_stdio, stderr, "All built-in modules have been released\n");
+        builtins->top->log(builtins->top->work_module, apivalue_log_level_notice, "All built-in modules have been released", NULL, 0);
         builtins->top->api_stdlib->free(builtins->top->api_stdlib, builtins);
         return;
 
@@ -142,6 +205,7 @@ static void builtin_shutdown(struct api_dependency * api, struct dependency * de
 
 int builtin_startup(struct top * top)
   {
+    size_t count;
     enum apivalue_dependency dependency_rv;
     size_t i;
     size_t j;
@@ -157,16 +221,19 @@ int builtin_startup(struct top * top)
       }
       * usage;
 
-    if (builtin_modules_count == 0)
+    count = builtin_modules_count;
+    if (!top->interactive)
+      count -= builtin_interactive_count;
+    if (count == 0)
       return EXIT_SUCCESS;
 
     need_free = 0;
     top->api_dependency->initialize_want(top->api_dependency, &temp_want);
 
-    mem = top->api_stdlib->malloc(top->api_stdlib, sizeof *usage + ((builtin_modules_count - 1) * sizeof usage->alignment));
+    mem = top->api_stdlib->malloc(top->api_stdlib, sizeof *usage + ((count - 1) * sizeof usage->alignment));
     if (mem == NULL)
       {
-        (void) top->api_stdio->fprintf(top->api_stdio, stderr, "Out of memory while allocating built-in modules\n");
+        top->log(top->work_module, apivalue_log_level_error, "Out of memory while allocating built-in modules", NULL, 0);
         goto err_usage;
       }
     need_free = 1;
@@ -178,19 +245,19 @@ int builtin_startup(struct top * top)
     dependency_rv = top->api_dependency->want(top->api_dependency, &usage->inner.dependency, &temp_want);
     if (dependency_rv != apivalue_dependency_success)
       {
-        (void) top->api_stdio->fprintf(top->api_stdio, stderr, "Dependency API 'want' unexpectedly failed for built-in modules\n");
+        top->log(top->work_module, apivalue_log_level_error, "Dependency API 'want' unexpectedly failed for built-in modules", NULL, 0);
         goto err_want;
       }
     dependency_rv = top->api_dependency->observe(top->api_dependency, &usage->inner.dependency, &usage->inner.cleanup);
     if (dependency_rv != apivalue_dependency_success)
       {
-        (void) top->api_stdio->fprintf(top->api_stdio, stderr, "Dependency API 'observe' unexpectedly failed for built-in modules\n");
+        top->log(top->work_module, apivalue_log_level_error, "Dependency API 'observe' unexpectedly failed for built-in modules", NULL, 0);
         goto err_observe;
       }
     /* The clean-up is now responsible for freeing */
     need_free = 0;
     /* Failure-free pass */
-    for (i = 0; i < builtin_modules_count; ++i)
+    for (i = 0; i < count; ++i)
       {
         usage->inner.builtins[i].live_module = NULL;
         top->api_dependency->initialize_observe(top->api_dependency, &usage->inner.builtins[i].cleanup, &builtin_cleanup);
@@ -200,41 +267,41 @@ int builtin_startup(struct top * top)
         usage->inner.builtins[i].top = top;
       }
     /* Can fail */
-    for (i = 0; i < builtin_modules_count; ++i)
+    for (i = 0; i < count; ++i)
       {
         dependency_rv = top->api_dependency->want(top->api_dependency, &usage->inner.dependency, &usage->inner.builtins[i].builtins_want);
         if (dependency_rv != apivalue_dependency_success)
           {
-            (void) top->api_stdio->fprintf(top->api_stdio, stderr, "Dependency API 'want' unexpectedly failed for a built-in module\n");
+            top->log(top->work_module, apivalue_log_level_error, "Dependency API 'want' unexpectedly failed for a built-in module", NULL, 0);
             goto err_builtins_want;
           }
       }
-    for (i = 0; i < builtin_modules_count; ++i)
+    for (i = 0; i < count; ++i)
       {
         module = builtin_modules[i];
         rv = top->module_api->live_module_from_module(top, module, &usage->inner.builtins[i].module_want, &usage->inner.builtins[i].live_module);
         if (rv != EXIT_SUCCESS)
           {
-            (void) top->api_stdio->fprintf(top->api_stdio, stderr, "Failed to create live module for a built-in module\n");
+            top->log(top->work_module, apivalue_log_level_error, "Failed to create live module for a built-in module", NULL, 0);
             goto err_live_module_want;
           }
       }
-    for (i = 0; i < builtin_modules_count; ++i)
+    for (i = 0; i < count; ++i)
       {
         module = builtin_modules[i];
         dependency_rv = top->api_dependency->observe(top->api_dependency, &usage->inner.builtins[i].live_module->dependency, &usage->inner.builtins[i].cleanup);
         if (dependency_rv != apivalue_dependency_success)
           {
-            (void) top->api_stdio->fprintf(top->api_stdio, stderr, "Dependency API 'observe' unexpectedly failed for a built-in module\n");
+            top->log(top->work_module, apivalue_log_level_error, "Dependency API 'observe' unexpectedly failed for a built-in module", NULL, 0);
             goto err_live_module_observe;
           }
       }
-    for (i = 0; i < builtin_modules_count; ++i)
+    for (i = 0; i < count; ++i)
       {
         rv = top->module_api->load(top, usage->inner.builtins[i].live_module);
         if (rv != EXIT_SUCCESS)
           {
-            (void) top->api_stdio->fprintf(top->api_stdio, stderr, "A built-in module failed to load\n");
+            top->log(top->work_module, apivalue_log_level_error, "A built-in module failed to load", NULL, 0);
             goto err_load;
           }
       }
@@ -242,27 +309,27 @@ int builtin_startup(struct top * top)
     top->api_dependency->unwant(top->api_dependency, &usage->inner.dependency, &temp_want);
     return EXIT_SUCCESS;
 
-    i = builtin_modules_count;
+    i = count;
     err_load:
     for (j = 0; j < i; ++j)
       top->module_api->unload(top, usage->inner.builtins[i].live_module);
 
-    i = builtin_modules_count;
+    i = count;
     err_live_module_observe:
     for (j = 0; j < i; ++j)
       top->api_dependency->unobserve(top->api_dependency, &usage->inner.builtins[i].live_module->dependency, &usage->inner.builtins[i].cleanup);
 
-    i = builtin_modules_count;
+    i = count;
     err_live_module_want:
     for (j = 0; j < i; ++j)
       top->api_dependency->unwant(top->api_dependency, &usage->inner.builtins[i].live_module->dependency, &usage->inner.builtins[i].module_want);
 
-    i = builtin_modules_count;
+    i = count;
     err_builtins_want:
     for (j = 0; j < i; ++j)
       top->api_dependency->unwant(top->api_dependency, &usage->inner.dependency, &usage->inner.builtins[i].builtins_want);
 
-    i = builtin_modules_count;
+    i = count;
     /* Our final observer frees itself */
     err_observe:
 
@@ -8,6 +8,12 @@
 
 extern int builtin_startup(struct top *);
 
+#ifndef BUILTIN_CMD_BENCH
+#define BUILTIN_CMD_BENCH 1
+#endif
+#ifndef BUILTIN_CMD_COMPLETE
+#define BUILTIN_CMD_COMPLETE 1
+#endif
 #ifndef BUILTIN_CMD_EXIT
 #define BUILTIN_CMD_EXIT 1
 #endif
@@ -17,6 +23,9 @@ extern int builtin_startup(struct top *);
 #ifndef BUILTIN_CMD_HEXDUMP
 #define BUILTIN_CMD_HEXDUMP 1
 #endif
+#ifndef BUILTIN_CMD_JOBS
+#define BUILTIN_CMD_JOBS 1
+#endif
 #ifndef BUILTIN_CMD_LOAD
 /* TODO: Support non-POSIX */
 #if CMDCTOY_POSIX
@@ -25,9 +34,37 @@ extern int builtin_startup(struct top *);
 #define BUILTIN_CMD_LOAD 0
 #endif /* CMDCTOY_POSIX */
 #endif /* BUILTIN_CMD_LOAD */
+#ifndef BUILTIN_CMD_MATH
+#define BUILTIN_CMD_MATH 1
+#endif
 #ifndef BUILTIN_CMD_MONO
 #define BUILTIN_CMD_MONO 1
 #endif
+#ifndef BUILTIN_CMD_SERVER
+/* TODO: Support non-POSIX */
+#if CMDCTOY_POSIX
+#define BUILTIN_CMD_SERVER 1
+#else
+#define BUILTIN_CMD_SERVER 0
+#endif /* CMDCTOY_POSIX */
+#endif /* BUILTIN_CMD_SERVER */
+#ifndef BUILTIN_CMD_SHMCHAN
+/* TODO: Support more than Linux */
+#if CMDCTOY_POSIX && defined(__linux__)
+#define BUILTIN_CMD_SHMCHAN 1
+#else
+#define BUILTIN_CMD_SHMCHAN 0
+#endif /* CMDCTOY_POSIX && defined(__linux__) */
+#endif /* BUILTIN_CMD_SHMCHAN */
+#ifndef BUILTIN_CMD_SOURCE
+#define BUILTIN_CMD_SOURCE 1
+#endif
+#ifndef BUILTIN_CMD_STAT
+#define BUILTIN_CMD_STAT 1
+#endif
+#ifndef BUILTIN_CMD_TEXT
+#define BUILTIN_CMD_TEXT 1
+#endif
 #ifndef BUILTIN_CMD_TYPE
 #define BUILTIN_CMD_TYPE 1
 #endif
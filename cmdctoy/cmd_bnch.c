@@ -0,0 +1,415 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+#if CMDCTOY_POSIX
+/* For clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+#endif /* CMDCTOY_POSIX */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "builtins.h"
+#include "command.h"
+#include "toy.h"
+#include "toydef.h"
+#include "toyio.h"
+#include "toylib.h"
+#include "list.h"
+#include "module.h"
+
+struct bench;
+struct cmd_bench;
+
+typedef int func_bench(struct cmd_bench *, unsigned long int, unsigned long int);
+
+/* A benchmark, with how many rounds and of what size it does by default */
+struct bench
+  {
+    const char * name;
+    func_bench * func;
+    unsigned long int rounds;
+    unsigned long int size;
+    const char * usage;
+  };
+
+struct cmd_bench
+  {
+    struct command command;
+    struct top * ctx;
+  };
+
+static func_bench bench_format;
+static int format_lines(struct cmd_bench *, unsigned long int, const unsigned char *, size_t, int, double *, size_t *);
+static func_bench bench_tokenize;
+static apifunction_command cmd_bench;
+static func_module_event module_event;
+static double now(void);
+static int parse_count(struct top *, const char *, const char *, unsigned long int *);
+
+static struct command command_bench;
+static struct live_module * live_module;
+
+#if BUILTIN_CMD_BENCH
+union module builtin_module_cmd_bench =
+#else
+union module module =
+#endif
+  {
+    {
+      {
+        module_signature,
+        "2024120200",
+        apivalue_module_api_version
+      },
+      &module_event,
+      {
+        NULL,
+        NULL,
+        NULL,
+        NULL
+      },
+      "cmd_bench"
+    }
+  };
+
+static const struct bench benches[] =
+  {
+    {
+      "format",
+      &bench_format,
+      100000,
+      16,
+      "  bench format [LINES [BYTES]]        Format LINES lines of numbers, a pointer and BYTES hex bytes,\n"
+      "                                      with the append_* formatters and then with fprintf\n"
+    },
+    {
+      "tokenize",
+      &bench_tokenize,
+      100000,
+      200,
+      "  bench tokenize [LINES [ARGUMENTS]]  Tokenize a generated line of ARGUMENTS arguments, LINES times\n"
+    }
+  };
+
+static struct command command_bench =
+  {
+    NULL,
+    "bench",
+    &cmd_bench,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+/*
+ * The lines are like those of 'hexdump' and 'list_identifiers'.  They're
+ * gathered in memory, so that only the formatting is measured, and both
+ * ways must give the same number of bytes
+ */
+static int bench_format(struct cmd_bench * cmd, unsigned long int rounds, unsigned long int size)
+  {
+    unsigned char * bytes;
+    struct top * ctx;
+    double elapsed[2];
+    size_t i;
+    size_t lengths[2];
+
+    ctx = cmd->ctx;
+
+    bytes = ctx->api_stdlib->malloc(ctx->api_stdlib, size);
+    if (bytes == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory for the bytes\n");
+        return EXIT_FAILURE;
+      }
+    for (i = 0; i < size; ++i)
+      bytes[i] = (unsigned char) (i * 37);
+    for (i = 0; i < 2; ++i)
+      {
+        if (format_lines(cmd, rounds, bytes, size, (int) i, elapsed + i, lengths + i) != EXIT_SUCCESS)
+          break;
+      }
+    ctx->api_stdlib->free(ctx->api_stdlib, bytes);
+    if (i < 2)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory for the formatted lines\n");
+        return EXIT_FAILURE;
+      }
+    if (lengths[0] != lengths[1])
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "The formatters gave '%lu' bytes, but fprintf gave '%lu'\n", (unsigned long int) lengths[0], (unsigned long int) lengths[1]);
+        return EXIT_FAILURE;
+      }
+
+    for (i = 0; i < 2; ++i)
+      {
+        if (elapsed[i] <= 0)
+          elapsed[i] = 1e-9;
+      }
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "format: %lu lines of %lu bytes\n", rounds, (unsigned long int) (lengths[0] / rounds));
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "format: append_*: %.3f s, %.1f ns/line, %.1f MB/s\n", elapsed[0], elapsed[0] * 1e9 / rounds, lengths[0] / elapsed[0] / 1e6);
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "format: fprintf:  %.3f s, %.1f ns/line, %.1f MB/s\n", elapsed[1], elapsed[1] * 1e9 / rounds, lengths[1] / elapsed[1] / 1e6);
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "format: fprintf takes %.2f times as long as append_*\n", elapsed[1] / elapsed[0]);
+    return EXIT_SUCCESS;
+  }
+
+/*
+ * The line is like a machine-generated one: many arguments, with values
+ * that are quoted, have spaces or are escaped, so every path is taken
+ */
+static int bench_tokenize(struct cmd_bench * cmd, unsigned long int rounds, unsigned long int size)
+  {
+    size_t count;
+    enum apivalue_command command_rv;
+    struct top * ctx;
+    double elapsed;
+    size_t i;
+    size_t length;
+    char * line;
+    unsigned long int round;
+    double start;
+    struct command_token * tokens;
+    unsigned long int total;
+
+    ctx = cmd->ctx;
+
+    if (size == 0 || size > ((size_t) -1 - 1) / 96)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Too many arguments for the line\n");
+        return EXIT_FAILURE;
+      }
+    line = ctx->api_stdlib->malloc(ctx->api_stdlib, size * 96 + 1);
+    tokens = ctx->api_stdlib->malloc(ctx->api_stdlib, size * sizeof *tokens);
+    if (line == NULL || tokens == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory for the line\n");
+        ctx->api_stdlib->free(ctx->api_stdlib, tokens);
+        ctx->api_stdlib->free(ctx->api_stdlib, line);
+        return EXIT_FAILURE;
+      }
+    length = 0;
+    for (i = 0; i < size; ++i)
+      {
+        switch (i % 4)
+          {
+            case 0:
+            length += sprintf(line + length, "argument%lu ", (unsigned long int) i);
+            break;
+
+            case 1:
+            length += sprintf(line + length, "key%lu=\"a value with \\\"spaces\\\" %lu\" ", (unsigned long int) i, (unsigned long int) i);
+            break;
+
+            case 2:
+            length += sprintf(line + length, "'literal $%lu | & >' ", (unsigned long int) i);
+            break;
+
+            default:
+            length += sprintf(line + length, "escaped\\ %lu\\ value ", (unsigned long int) i);
+            break;
+          }
+      }
+
+    total = 0;
+    start = now();
+    for (round = 0; round < rounds; ++round)
+      {
+        command_rv = ctx->api_command->tokenize(ctx->api_command, line, length, tokens, size, &count);
+        if (command_rv != apivalue_command_success || count != size)
+          {
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Tokenizing failed with '%d', giving '%lu' arguments\n", (int) command_rv, (unsigned long int) count);
+            break;
+          }
+        total += (unsigned long int) count;
+      }
+    elapsed = now() - start;
+    ctx->api_stdlib->free(ctx->api_stdlib, tokens);
+    ctx->api_stdlib->free(ctx->api_stdlib, line);
+    if (round < rounds)
+      return EXIT_FAILURE;
+
+    if (elapsed <= 0)
+      elapsed = 1e-9;
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "tokenize: %lu lines of %lu bytes and %lu arguments in %.3f s\n", rounds, (unsigned long int) length, total / rounds, elapsed);
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "tokenize: %.0f lines/s, %.1f MB/s, %.1f ns/argument\n", rounds / elapsed, rounds * (double) length / elapsed / 1e6, total > 0 ? elapsed * 1e9 / total : 0.0);
+    return EXIT_SUCCESS;
+  }
+
+/* Measures a part of the program that matters for speed, in-process, so it can be re-run after changes */
+static int cmd_bench(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    const struct bench * bench;
+    struct cmd_bench * cmd;
+    struct top * ctx;
+    size_t i;
+    unsigned long int rounds;
+    unsigned long int size;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_bench, command, command);
+    ctx = cmd->ctx;
+
+    bench = NULL;
+    if (argc >= 2 && argc <= 4)
+      {
+        for (i = 0; i < countof(benches); ++i)
+          {
+            if (strcmp(argv[1], benches[i].name) == 0)
+              bench = benches + i;
+          }
+      }
+    if (bench == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage:\n");
+        for (i = 0; i < countof(benches); ++i)
+          (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "%s", benches[i].usage);
+        return EXIT_FAILURE;
+      }
+    rounds = bench->rounds;
+    size = bench->size;
+    if (argc >= 3 && parse_count(ctx, argv[2], "rounds", &rounds) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    if (argc == 4 && parse_count(ctx, argv[3], "size", &size) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    return bench->func(cmd, rounds, size);
+  }
+
+static int module_event(enum apivalue_module_event_type type, void * event_data)
+  {
+    struct cmd_bench * command;
+    struct top * ctx;
+    int rv;
+
+    switch (type)
+      {
+        case apivalue_module_event_type_loaded:
+        if (live_module != NULL)
+          return EXIT_FAILURE;
+        live_module = event_data;
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_thread_started:
+        ctx = event_data;
+        command = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *command);
+        if (command == NULL)
+          {
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'bench' command", NULL, 0);
+            return EXIT_FAILURE;
+          }
+        live_module->module.v1.module_pointers[0] = command;
+        command->command = command_bench;
+        command->command.live_module = live_module;
+        command->ctx = ctx;
+        (void) ctx->api_list->initialize_list_item(ctx->api_list, &command->command.list_item);
+        rv = ctx->api_command->add(ctx->api_command, &command->command);
+        if (rv != EXIT_SUCCESS)
+          ctx->log(live_module, apivalue_log_level_error, "Unable to register the 'bench' command", NULL, 0);
+        return rv;
+
+        case apivalue_module_event_type_thread_stop_requested:
+        case apivalue_module_event_type_thread_stopped:
+        case apivalue_module_event_type_unload_requested:
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_unload:
+        /* Assume success until proven otherwise */
+        rv = EXIT_SUCCESS;
+        command = live_module->module.v1.module_pointers[0];
+        if (command != NULL)
+          {
+            ctx = command->ctx;
+            rv = ctx->api_command->remove(ctx->api_command, &command->command);
+            if (rv == EXIT_SUCCESS)
+              ctx->api_stdlib->free(ctx->api_stdlib, command);
+          }
+        live_module = NULL;
+        return rv;
+      }
+    return EXIT_FAILURE;
+  }
+
+/* Standard output goes to a sink in memory, as it would to a file, then it's put back */
+static int format_lines(struct cmd_bench * cmd, unsigned long int rounds, const unsigned char * bytes, size_t size, int use_fprintf, double * elapsed, size_t * length)
+  {
+    struct stdio_chain chain;
+    struct top * ctx;
+    size_t i;
+    struct stdio_chain * old_output;
+    struct stdio_sink * old_sink;
+    int rv;
+    unsigned long int round;
+    struct stdio_sink sink;
+    double start;
+    struct api_stdio * stdio_api;
+
+    ctx = cmd->ctx;
+    stdio_api = ctx->api_stdio;
+    old_output = stdio_api->output;
+    old_sink = stdio_api->sink;
+    stdio_api->initialize_chain(stdio_api, &chain, ctx->api_stdlib);
+    stdio_api->initialize_sink(stdio_api, &sink, apivalue_stdio_sink_memory, ctx->api_stdlib);
+    sink.chain = &chain;
+    stdio_api->output = NULL;
+    stdio_api->sink = &sink;
+
+    start = now();
+    for (round = 0; round < rounds; ++round)
+      {
+        if (use_fprintf)
+          {
+            (void) stdio_api->fprintf(stdio_api, stdout, "%lu %p %s", round, (void *) bytes, "identifier_name");
+            for (i = 0; i < size; ++i)
+              (void) stdio_api->fprintf(stdio_api, stdout, " %02X", bytes[i]);
+            (void) stdio_api->fprintf(stdio_api, stdout, "\n");
+          }
+          else
+          {
+            (void) stdio_api->append_unsigned(stdio_api, round, stdout);
+            (void) stdio_api->append_string(stdio_api, " ", stdout);
+            (void) stdio_api->append_pointer(stdio_api, bytes, stdout);
+            (void) stdio_api->append_string(stdio_api, " identifier_name", stdout);
+            (void) stdio_api->append_hex(stdio_api, bytes, size, " ", stdout);
+            (void) stdio_api->append_string(stdio_api, "\n", stdout);
+          }
+      }
+    rv = stdio_api->release_sink(stdio_api, &sink);
+    *elapsed = now() - start;
+
+    stdio_api->sink = old_sink;
+    stdio_api->output = old_output;
+    *length = chain.length;
+    stdio_api->release_chain(stdio_api, &chain);
+    return rv;
+  }
+
+/* In seconds, from some fixed point */
+static double now(void)
+  {
+#if CMDCTOY_POSIX
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+      return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+#endif /* CMDCTOY_POSIX */
+    return (double) clock() / CLOCKS_PER_SEC;
+  }
+
+static int parse_count(struct top * ctx, const char * text, const char * what, unsigned long int * count)
+  {
+    char * endptr;
+
+    *count = strtoul(text, &endptr, 0);
+    if (*text == '\0' || *endptr != '\0' || *count == 0)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Specified %s does not appear to be a positive 'unsigned long int'\n", what);
+        return EXIT_FAILURE;
+      }
+    return EXIT_SUCCESS;
+  }
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "builtins.h"
+#include "command.h"
+#include "toy.h"
+#include "toydef.h"
+#include "toyio.h"
+#include "toylib.h"
+#include "list.h"
+#include "module.h"
+
+struct cmd_complete;
+
+struct cmd_complete
+  {
+    struct command command;
+    struct top * ctx;
+  };
+
+static apifunction_command cmd_complete;
+static func_module_event module_event;
+
+static struct command command_complete;
+static struct live_module * live_module;
+
+#if BUILTIN_CMD_COMPLETE
+union module builtin_module_cmd_complete =
+#else
+union module module =
+#endif
+  {
+    {
+      {
+        module_signature,
+        "2024120200",
+        apivalue_module_api_version
+      },
+      &module_event,
+      {
+        NULL,
+        NULL,
+        NULL,
+        NULL
+      },
+      "cmd_complete"
+    }
+  };
+
+/* The candidates only change when commands are added or removed, which forgets kept outputs */
+static struct command command_complete =
+  {
+    NULL,
+    "complete",
+    &cmd_complete,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    apivalue_command_flag_pure
+  };
+
+/* Shows one candidate per line, for tab-completion by a client */
+static int cmd_complete(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_complete * cmd;
+    size_t count;
+    struct top * ctx;
+    size_t i;
+    struct command * const * matches;
+
+    cmd = type_with_member_at_ptr(struct cmd_complete, command, command);
+    ctx = cmd->ctx;
+
+    if (argc > 2)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage:\n  complete [PREFIX]  Show the commands whose names start with PREFIX\n");
+        return EXIT_FAILURE;
+      }
+    matches = api->match(api, argc == 2 ? argv[1] : "", &count);
+    for (i = 0; i < count; ++i)
+      (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%s\n", matches[i]->name);
+    /* Like 'grep', nothing matching is a failure */
+    return count > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+static int module_event(enum apivalue_module_event_type type, void * event_data)
+  {
+    struct cmd_complete * command;
+    struct top * ctx;
+    int rv;
+
+    switch (type)
+      {
+        case apivalue_module_event_type_loaded:
+        if (live_module != NULL)
+          return EXIT_FAILURE;
+        live_module = event_data;
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_thread_started:
+        ctx = event_data;
+        command = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *command);
+        if (command == NULL)
+          {
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'complete' command", NULL, 0);
+            return EXIT_FAILURE;
+          }
+        live_module->module.v1.module_pointers[0] = command;
+        command->command = command_complete;
+        command->command.live_module = live_module;
+        command->ctx = ctx;
+        (void) ctx->api_list->initialize_list_item(ctx->api_list, &command->command.list_item);
+        rv = ctx->api_command->add(ctx->api_command, &command->command);
+        if (rv != EXIT_SUCCESS)
+          ctx->log(live_module, apivalue_log_level_error, "Unable to register the 'complete' command", NULL, 0);
+        return rv;
+
+        case apivalue_module_event_type_thread_stop_requested:
+        case apivalue_module_event_type_thread_stopped:
+        case apivalue_module_event_type_unload_requested:
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_unload:
+        /* Assume success until proven otherwise */
+        rv = EXIT_SUCCESS;
+        command = live_module->module.v1.module_pointers[0];
+        if (command != NULL)
+          {
+            ctx = command->ctx;
+            rv = ctx->api_command->remove(ctx->api_command, &command->command);
+            if (rv == EXIT_SUCCESS)
+              ctx->api_stdlib->free(ctx->api_stdlib, command);
+          }
+        live_module = NULL;
+        return rv;
+      }
+    return EXIT_FAILURE;
+  }
@@ -35,7 +35,7 @@ union module module =
       {
         module_signature,
         "2024120200",
-        1
+        apivalue_module_api_version
       },
       &module_event,
       {
@@ -56,7 +56,11 @@ static struct command command_exit =
     {
       NULL,
       NULL
-    }
+    },
+    NULL,
+    NULL,
+    0,
+    0
   };
 
 static int cmd_exit(struct api_command * api, struct command * command, int argc, char ** argv)
@@ -94,7 +98,7 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
         command = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *command);
         if (command == NULL)
           {
-            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while registering 'exit' command\n");
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'exit' command", NULL, 0);
             return EXIT_FAILURE;
           }
         live_module->module.v1.module_pointers[0] = command;
@@ -104,7 +108,7 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
         (void) ctx->api_list->initialize_list_item(ctx->api_list, &command->command.list_item);
         rv = ctx->api_command->add(ctx->api_command, &command->command);
         if (rv != EXIT_SUCCESS)
-          (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Error '%d' while attempting to register 'exit' command\n", rv);
+          ctx->log(live_module, apivalue_log_level_error, "Unable to register the 'exit' command", NULL, 0);
         return rv;
 
         case apivalue_module_event_type_thread_stop_requested:
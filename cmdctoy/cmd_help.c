@@ -36,7 +36,7 @@ union module module =
       {
         module_signature,
         "2024120200",
-        1
+        apivalue_module_api_version
       },
       &module_event,
       {
@@ -57,7 +57,11 @@ static struct command command_help =
     {
       NULL,
       NULL
-    }
+    },
+    NULL,
+    NULL,
+    0,
+    0
   };
 
 static int cmd_help(struct api_command * api, struct command * command, int argc, char ** argv)
@@ -78,7 +82,7 @@ static int cmd_help(struct api_command * api, struct command * command, int argc
       {
         /* We might as well repurpose 'command' */
         command = type_with_member_at_ptr(struct command, list_item, list_item);
-        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "  '%s' from the '%s' module\n", command->name, command->live_module->module.v1.nice_name);
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "  '%s' from the '%s' module%s\n", command->name, command->live_module->module.v1.nice_name, ctx->api_command->find(ctx->api_command, command->name) == command ? "" : " (shadowed)");
       }
     return EXIT_SUCCESS;
   }
@@ -102,7 +106,7 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
         command = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *command);
         if (command == NULL)
           {
-            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while registering 'help' command\n");
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'help' command", NULL, 0);
             return EXIT_FAILURE;
           }
         live_module->module.v1.module_pointers[0] = command;
@@ -112,7 +116,7 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
         (void) ctx->api_list->initialize_list_item(ctx->api_list, &command->command.list_item);
         rv = ctx->api_command->add(ctx->api_command, &command->command);
         if (rv != EXIT_SUCCESS)
-          (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Error '%d' while attempting to register 'help' command\n", rv);
+          ctx->log(live_module, apivalue_log_level_error, "Unable to register the 'help' command", NULL, 0);
         return rv;
 
         case apivalue_module_event_type_thread_stop_requested:
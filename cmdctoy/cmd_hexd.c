@@ -43,7 +43,7 @@ union module module =
       {
         module_signature,
         "2024120200",
-        1
+        apivalue_module_api_version
       },
       &module_event,
       {
@@ -64,7 +64,11 @@ static struct command command_hexdump =
     {
       NULL,
       NULL
-    }
+    },
+    NULL,
+    NULL,
+    0,
+    0
   };
 
 static int cmd_hexdump(struct api_command * api, struct command * command, int argc, char ** argv)
@@ -137,56 +141,42 @@ static int cmd_hexdump(struct api_command * api, struct command * command, int a
 
 static void hexdump(struct top * ctx, const void * memory, unsigned long int bytes)
   {
-    const unsigned char * p;
-    const unsigned char * q;
+    unsigned int count;
     unsigned int i;
+    const unsigned char * p;
+    struct api_stdio * stdio_api;
+    char text[16];
+    static const char padding[] = " XX XX XX XX XX XX XX XX";
 
+    stdio_api = ctx->api_stdio;
     p = memory;
     while (bytes)
       {
-        q = p;
-        ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%p: ", (void *) p);
-        for (i = 0; i < 8 && bytes; ++i)
-          {
-            ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%02X ", *p);
-            ++p;
-            --bytes;
-          }
-        if (i == 8)
-          ctx->api_stdio->fprintf(ctx->api_stdio, stdout, " ");
-        for (; i < 16 && bytes; ++i)
-          {
-            ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%02X ", *p);
-            ++p;
-            --bytes;
-          }
-        bytes += i;
-        while (i < 8)
-          {
-            ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "XX ");
-            ++i;
-          }
-        if (i == 8)
-          ctx->api_stdio->fprintf(ctx->api_stdio, stdout, " ");
-        while (i < 16)
-          {
-            ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "XX ");
-            ++i;
-          }
-        ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "| ");
-        p = q;
-        for (i = 0; i < 16 && bytes; ++i)
+        count = bytes < 16 ? (unsigned int) bytes : 16;
+        (void) stdio_api->append_pointer(stdio_api, p, stdout);
+        (void) stdio_api->append_string(stdio_api, ":", stdout);
+        /* The halves are apart, and missing bytes are shown as "XX" */
+        if (count <= 8)
           {
-            ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%c", isprint(*p) && !isspace(*p) ? *p : ' ');
-            ++p;
-            --bytes;
+            (void) stdio_api->append_hex(stdio_api, p, count, " ", stdout);
+            (void) stdio_api->fwrite(stdio_api, padding, 1, (8 - count) * 3, stdout);
+            (void) stdio_api->append_string(stdio_api, " ", stdout);
+            (void) stdio_api->fwrite(stdio_api, padding, 1, 8 * 3, stdout);
           }
-        while (i < 16)
+          else
           {
-            ctx->api_stdio->fprintf(ctx->api_stdio, stdout, " ");
-            ++i;
+            (void) stdio_api->append_hex(stdio_api, p, 8, " ", stdout);
+            (void) stdio_api->append_string(stdio_api, " ", stdout);
+            (void) stdio_api->append_hex(stdio_api, p + 8, count - 8, " ", stdout);
+            (void) stdio_api->fwrite(stdio_api, padding, 1, (16 - count) * 3, stdout);
           }
-        ctx->api_stdio->fprintf(ctx->api_stdio, stdout, " |\n");
+        for (i = 0; i < 16; ++i)
+          text[i] = i < count && isprint(p[i]) && !isspace(p[i]) ? (char) p[i] : ' ';
+        (void) stdio_api->append_string(stdio_api, " | ", stdout);
+        (void) stdio_api->fwrite(stdio_api, text, 1, sizeof text, stdout);
+        (void) stdio_api->append_string(stdio_api, " |\n", stdout);
+        p += count;
+        bytes -= count;
       }
   }
 
@@ -209,7 +199,7 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
         command = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *command);
         if (command == NULL)
           {
-            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while registering 'hexdump' command\n");
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'hexdump' command", NULL, 0);
             return EXIT_FAILURE;
           }
         live_module->module.v1.module_pointers[0] = command;
@@ -219,7 +209,7 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
         (void) ctx->api_list->initialize_list_item(ctx->api_list, &command->command.list_item);
         rv = ctx->api_command->add(ctx->api_command, &command->command);
         if (rv != EXIT_SUCCESS)
-          (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Error '%d' while attempting to register 'hexdump' command\n", rv);
+          ctx->log(live_module, apivalue_log_level_error, "Unable to register the 'hexdump' command", NULL, 0);
         return rv;
 
         case apivalue_module_event_type_thread_stop_requested:
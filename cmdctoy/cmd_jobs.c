@@ -0,0 +1,464 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "builtins.h"
+#include "command.h"
+#include "toy.h"
+#include "toydef.h"
+#include "toyio.h"
+#include "toylib.h"
+#include "list.h"
+#include "module.h"
+
+struct cmd_jobs;
+struct job;
+struct job_table;
+
+enum job_state
+  {
+    job_state_pending,
+    job_state_running,
+    job_states
+  };
+
+struct cmd_jobs
+  {
+    struct command command;
+    struct top * ctx;
+    struct job_table * table;
+  };
+
+struct job_table
+  {
+    /* Jobs that haven't finished, oldest first */
+    struct list jobs;
+    unsigned int next_number;
+  };
+
+/*
+ * Jobs are co-operative, like all other work, so a job runs to completion
+ * once it has started.  Its standard output is kept aside until then
+ */
+struct job
+  {
+    struct work_item work_item;
+    struct list_item list_item;
+    struct job_table * table;
+    unsigned int number;
+    enum job_state state;
+    FILE * output;
+    size_t length;
+    char * line;
+  };
+
+static apifunction_command cmd_jobs;
+static apifunction_command cmd_kill;
+static apifunction_command cmd_wait;
+static struct job * find_job(struct top *, struct job_table *, const char *);
+static void finish_job(struct top *, struct job *, int);
+static func_module_event module_event;
+static func_work run_job;
+static apifunction_command_background start_job;
+
+static struct command command_jobs;
+static struct command command_kill;
+static struct command command_wait;
+static struct live_module * live_module;
+
+#if BUILTIN_CMD_JOBS
+union module builtin_module_cmd_jobs =
+#else
+union module module =
+#endif
+  {
+    {
+      {
+        module_signature,
+        "2024120200",
+        apivalue_module_api_version
+      },
+      &module_event,
+      {
+        NULL,
+        NULL,
+        NULL,
+        NULL
+      },
+      "cmd_jobs"
+    }
+  };
+
+static struct command command_jobs =
+  {
+    NULL,
+    "jobs",
+    &cmd_jobs,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static struct command command_kill =
+  {
+    NULL,
+    "kill",
+    &cmd_kill,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static struct command command_wait =
+  {
+    NULL,
+    "wait",
+    &cmd_wait,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static int cmd_jobs(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_jobs * cmd;
+    struct top * ctx;
+    struct job * job;
+    struct list_item * list_item;
+
+    (void) api;
+    (void) argv;
+
+    cmd = type_with_member_at_ptr(struct cmd_jobs, command, command);
+    ctx = cmd->ctx;
+
+    if (argc != 1)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage: jobs\n");
+        return EXIT_FAILURE;
+      }
+    for (list_item = cmd->table->jobs.head.next; list_item != &cmd->table->jobs.head; list_item = list_item->next)
+      {
+        job = type_with_member_at_ptr(struct job, list_item, list_item);
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "[%u] %s  %s\n", job->number, job->state == job_state_running ? "Running" : "Pending", job->line);
+      }
+    return EXIT_SUCCESS;
+  }
+
+static int cmd_kill(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_jobs * cmd;
+    struct top * ctx;
+    struct job * job;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_jobs, command, command);
+    ctx = cmd->ctx;
+
+    if (argc != 2)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage: kill JOB\n");
+        return EXIT_FAILURE;
+      }
+    job = find_job(ctx, cmd->table, argv[1]);
+    if (job == NULL)
+      return EXIT_FAILURE;
+    if (job->state != job_state_pending)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Job [%u] has already started, so can't be killed\n", job->number);
+        return EXIT_FAILURE;
+      }
+    (void) ctx->api_list->remove_list_item(ctx->api_list, &job->work_item.list_item);
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "[%u] Killed  %s\n", job->number, job->line);
+    (void) ctx->api_list->remove_list_item(ctx->api_list, &job->list_item);
+    if (job->output != NULL)
+      (void) fclose(job->output);
+    ctx->api_stdlib->free(ctx->api_stdlib, job);
+    return EXIT_SUCCESS;
+  }
+
+/* Waiting runs a pending job straight away, since nothing else could run while we wait */
+static int cmd_wait(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_jobs * cmd;
+    struct top * ctx;
+    struct job * job;
+    struct list_item * list_item;
+    int rv;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_jobs, command, command);
+    ctx = cmd->ctx;
+
+    if (argc > 2)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage: wait [JOB]\n");
+        return EXIT_FAILURE;
+      }
+    if (argc == 2)
+      {
+        job = find_job(ctx, cmd->table, argv[1]);
+        if (job == NULL)
+          return EXIT_FAILURE;
+        if (job->state != job_state_pending)
+          {
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Job [%u] is the one waiting, so can't be waited for\n", job->number);
+            return EXIT_FAILURE;
+          }
+        (void) ctx->api_list->remove_list_item(ctx->api_list, &job->work_item.list_item);
+        return run_job(&job->work_item);
+      }
+    rv = EXIT_SUCCESS;
+    list_item = cmd->table->jobs.head.next;
+    while (list_item != &cmd->table->jobs.head)
+      {
+        job = type_with_member_at_ptr(struct job, list_item, list_item);
+        list_item = list_item->next;
+        if (job->state != job_state_pending)
+          continue;
+        (void) ctx->api_list->remove_list_item(ctx->api_list, &job->work_item.list_item);
+        rv = run_job(&job->work_item);
+        /* The job might have started or finished others */
+        list_item = cmd->table->jobs.head.next;
+      }
+    return rv;
+  }
+
+static struct job * find_job(struct top * ctx, struct job_table * table, const char * name)
+  {
+    char * end;
+    struct job * job;
+    struct list_item * list_item;
+    unsigned long int number;
+
+    if (*name == '%')
+      ++name;
+    number = strtoul(name, &end, 10);
+    if (*name == '\0' || *end != '\0')
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "'%s' isn't a job number\n", name);
+        return NULL;
+      }
+    for (list_item = table->jobs.head.next; list_item != &table->jobs.head; list_item = list_item->next)
+      {
+        job = type_with_member_at_ptr(struct job, list_item, list_item);
+        if (job->number == number)
+          return job;
+      }
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "No job [%lu]\n", number);
+    return NULL;
+  }
+
+/* Reports completion, then releases the job's output all at once */
+static void finish_job(struct top * ctx, struct job * job, int status)
+  {
+    char buffer[BUFSIZ];
+    size_t count;
+
+    (void) ctx->api_list->remove_list_item(ctx->api_list, &job->list_item);
+    if (status == EXIT_SUCCESS)
+      (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "[%u] Done  %s\n", job->number, job->line);
+      else
+      (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "[%u] Exit %d  %s\n", job->number, status, job->line);
+    if (job->output != NULL)
+      {
+        rewind(job->output);
+        while ((count = fread(buffer, 1, sizeof buffer, job->output)) > 0)
+          (void) ctx->api_stdio->fwrite(ctx->api_stdio, buffer, 1, count, stdout);
+        (void) fclose(job->output);
+      }
+    if (ctx->api_list->list_is_empty(ctx->api_list, &job->table->jobs))
+      job->table->next_number = 1;
+    ctx->api_stdlib->free(ctx->api_stdlib, job);
+  }
+
+static int module_event(enum apivalue_module_event_type type, void * event_data)
+  {
+    struct cmd_jobs (* commands)[3];
+    struct top * ctx;
+    struct log_field field;
+    size_t i;
+    size_t j;
+    int rv;
+    struct job_table * table;
+    struct usage
+      {
+        struct cmd_jobs commands[3];
+        struct job_table table;
+      }
+      * usage;
+
+    switch (type)
+      {
+        case apivalue_module_event_type_loaded:
+        if (live_module != NULL)
+          return EXIT_FAILURE;
+        live_module = event_data;
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_thread_started:
+        ctx = event_data;
+        usage = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *usage);
+        if (usage == NULL)
+          {
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'jobs', 'kill', 'wait' commands", NULL, 0);
+            return EXIT_FAILURE;
+          }
+        commands = &usage->commands;
+        table = &usage->table;
+        live_module->module.v1.module_pointers[0] = commands;
+        ctx->api_list->initialize_list(ctx->api_list, &table->jobs);
+        table->next_number = 1;
+        (*commands)[0].command = command_jobs;
+        (*commands)[1].command = command_kill;
+        (*commands)[2].command = command_wait;
+        rv = EXIT_SUCCESS;
+        for (i = 0; i < countof(*commands); ++i)
+          {
+            (*commands)[i].ctx = ctx;
+            (*commands)[i].table = table;
+            (*commands)[i].command.live_module = live_module;
+            (void) ctx->api_list->initialize_list_item(ctx->api_list, &(*commands)[i].command.list_item);
+            rv = ctx->api_command->add(ctx->api_command, &(*commands)[i].command);
+            if (rv != EXIT_SUCCESS)
+              {
+                field.key = "command";
+                field.value = (*commands)[i].command.name;
+                ctx->log(live_module, apivalue_log_level_error, "Unable to register a command", &field, 1);
+                for (j = 0; j < i; ++j)
+                  (void) ctx->api_command->remove(ctx->api_command, &(*commands)[j].command);
+                ctx->api_stdlib->free(ctx->api_stdlib, commands);
+                live_module->module.v1.module_pointers[0] = NULL;
+                return rv;
+              }
+          }
+        ctx->api_command->background = &start_job;
+        return rv;
+
+        case apivalue_module_event_type_thread_stop_requested:
+        case apivalue_module_event_type_thread_stopped:
+        case apivalue_module_event_type_unload_requested:
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_unload:
+        /* Assume success until proven otherwise */
+        rv = EXIT_SUCCESS;
+        commands = live_module->module.v1.module_pointers[0];
+        if (commands != NULL)
+          {
+            ctx = (*commands)[0].ctx;
+            if (ctx->api_command->background == &start_job)
+              ctx->api_command->background = NULL;
+            /* Work is only unloaded once there's none left, so there are no jobs */
+            for (i = 0; i < countof(*commands); ++i)
+              {
+                rv = ctx->api_command->remove(ctx->api_command, &(*commands)[i].command);
+                if (rv != EXIT_SUCCESS)
+                  return rv;
+              }
+            ctx->api_stdlib->free(ctx->api_stdlib, commands);
+          }
+        live_module = NULL;
+        return rv;
+      }
+    return EXIT_FAILURE;
+  }
+
+static int run_job(struct work_item * work_item)
+  {
+    struct top * ctx;
+    struct job * job;
+    struct stdio_sink * old_sink;
+    int rv;
+    struct stdio_sink sink;
+    struct api_stdio * stdio_api;
+
+    job = type_with_member_at_ptr(struct job, work_item, work_item);
+    ctx = work_item->ctx;
+    stdio_api = ctx->api_stdio;
+    job->state = job_state_running;
+    if (job->output == NULL)
+      {
+        rv = ctx->api_command->line(ctx->api_command, job->line, job->length);
+        finish_job(ctx, job, rv);
+        return rv;
+      }
+    old_sink = stdio_api->sink;
+    stdio_api->initialize_sink(stdio_api, &sink, apivalue_stdio_sink_file, ctx->api_stdlib);
+    sink.file = job->output;
+    stdio_api->sink = &sink;
+    rv = ctx->api_command->line(ctx->api_command, job->line, job->length);
+    stdio_api->sink = old_sink;
+    (void) stdio_api->release_sink(stdio_api, &sink);
+    finish_job(ctx, job, rv);
+    return rv;
+  }
+
+static int start_job(struct api_command * api, const char * line, size_t length)
+  {
+    struct cmd_jobs (* commands)[3];
+    struct top * ctx;
+    struct job * job;
+    struct job_table * table;
+
+    (void) api;
+
+    commands = live_module->module.v1.module_pointers[0];
+    ctx = (*commands)[0].ctx;
+    table = (*commands)[0].table;
+
+    /* Only for the sake of showing the line */
+    while (length > 0 && isspace((unsigned char) *line))
+      {
+        ++line;
+        --length;
+      }
+    while (length > 0 && isspace((unsigned char) line[length - 1]))
+      --length;
+
+    if (length > (size_t) -1 - sizeof *job - 1)
+      goto err_job;
+    job = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *job + length + 1);
+    if (job == NULL)
+      goto err_job;
+    job->line = (char *) (job + 1);
+    memcpy(job->line, line, length);
+    job->line[length] = '\0';
+    job->length = length;
+    job->table = table;
+    job->number = table->next_number++;
+    job->state = job_state_pending;
+    /* Without somewhere to keep the output, it just isn't kept aside */
+    job->output = tmpfile();
+    (void) ctx->api_list->initialize_list_item(ctx->api_list, &job->list_item);
+    (void) ctx->api_list->add_item_to_list_tail(ctx->api_list, &job->list_item, &table->jobs);
+    (void) ctx->api_list->initialize_list_item(ctx->api_list, &job->work_item.list_item);
+    job->work_item.work = &run_job;
+    (void) ctx->schedule_last(live_module, &job->work_item, ctx->work_list);
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "[%u] %s\n", job->number, job->line);
+    return EXIT_SUCCESS;
+
+    err_job:
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory for a job, so command has been ignored\n");
+    return EXIT_FAILURE;
+  }
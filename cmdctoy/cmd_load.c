@@ -17,6 +17,7 @@
 #include "toylib.h"
 #include "modpriv.h"
 #include "module.h"
+#include "type.h"
 
 struct cmd_load;
 struct module_observer;
@@ -43,6 +44,7 @@ static apifunction_command cmd_list_modules;
 static apifunction_command cmd_load;
 static apifunction_command cmd_unload;
 static void help(struct top *);
+static void log_failure(struct top *, const char *, const char *, const char *, const char *, int);
 static apifunction_dependency_observe_call module_observe;
 static func_module_event module_event;
 static func_work module_unloaded;
@@ -62,7 +64,7 @@ union module module =
       {
         module_signature,
         "2024120200",
-        1
+        apivalue_module_api_version
       },
       &module_event,
       {
@@ -83,7 +85,11 @@ static struct command command_list_modules =
     {
       NULL,
       NULL
-    }
+    },
+    NULL,
+    NULL,
+    0,
+    0
   };
 
 static struct command command_load =
@@ -94,7 +100,11 @@ static struct command command_load =
     {
       NULL,
       NULL
-    }
+    },
+    NULL,
+    NULL,
+    0,
+    0
   };
 
 static struct command command_unload =
@@ -105,7 +115,11 @@ static struct command command_unload =
     {
       NULL,
       NULL
-    }
+    },
+    NULL,
+    NULL,
+    0,
+    0
   };
 
 static int cmd_list_modules(struct api_command * api, struct command * command, int argc, char ** argv)
@@ -115,12 +129,14 @@ static int cmd_list_modules(struct api_command * api, struct command * command,
     struct list_item * list_item;
     struct module_private * module_private;
     char serial[sizeof module_private->live_module.module.v1.required.module_serial + 1];
+    struct api_stdio * stdio_api;
 
     (void) api;
     (void) argv;
 
     cmd = type_with_member_at_ptr(struct cmd_load, command, command);
     ctx = cmd->ctx;
+    stdio_api = ctx->api_stdio;
 
     if (argc != 1)
       {
@@ -132,7 +148,17 @@ static int cmd_list_modules(struct api_command * api, struct command * command,
       {
         module_private = type_with_member_at_ptr(struct module_private, list_item, list_item);
         memcpy(serial, module_private->live_module.module.v1.required.module_serial, sizeof module_private->live_module.module.v1.required.module_serial);
-        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "Module #%lu with serial '%s' is named '%s'\n", module_private->order, serial, module_private->live_module.module.v1.nice_name);
+        (void) stdio_api->append_string(stdio_api, "Module #", stdout);
+        (void) stdio_api->append_unsigned(stdio_api, module_private->order, stdout);
+        (void) stdio_api->append_string(stdio_api, " with serial '", stdout);
+        (void) stdio_api->append_string(stdio_api, serial, stdout);
+        (void) stdio_api->append_string(stdio_api, "' is named '", stdout);
+        (void) stdio_api->append_string(stdio_api, module_private->live_module.module.v1.nice_name, stdout);
+        (void) stdio_api->append_string(stdio_api, "' (objects: ", stdout);
+        (void) stdio_api->append_unsigned(stdio_api, module_private->arena.objects, stdout);
+        (void) stdio_api->append_string(stdio_api, ", bytes: ", stdout);
+        (void) stdio_api->append_unsigned(stdio_api, module_private->arena.bytes, stdout);
+        (void) stdio_api->append_string(stdio_api, ")\n", stdout);
       }
     return EXIT_SUCCESS;
   }
@@ -147,7 +173,6 @@ static int cmd_load(struct api_command * api, struct command * command, int argc
     int need_cmd_load_unwant;
     int need_dlclose;
     int need_free;
-    int new_errno;
     int old_errno;
     int rv;
     struct module_observer * module_cleanup;
@@ -170,7 +195,7 @@ static int cmd_load(struct api_command * api, struct command * command, int argc
     module_cleanup = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *module_cleanup);
     if (module_cleanup == NULL)
       {
-        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while allocating module clean-up\n");
+        log_failure(ctx, "Out of memory while allocating module clean-up", argv[1], NULL, NULL, 0);
         goto err_module_cleanup;
       }
     need_free = 1;
@@ -181,35 +206,33 @@ static int cmd_load(struct api_command * api, struct command * command, int argc
     module_cleanup->work_item.work = &module_unloaded;
     /* POSIX load */
     need_dlclose = 0;
+    /* The reason comes from dlerror, so errno isn't reported */
     old_errno = errno;
-    errno = 0;
     dl_handle = dlopen(argv[1], RTLD_NOW);
-    new_errno = errno;
     errno = old_errno;
     if (dl_handle == NULL)
       {
-        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Failed to load module with reason '%s' and errno was '%d'\n", dlerror(), new_errno);
+        log_failure(ctx, "Failed to load module", argv[1], dlerror(), NULL, 0);
         goto err_dl_handle;
       }
     need_dlclose = 1;
     /* Note handle in closer */
     module_cleanup->dl_handle = dl_handle;
     /* Find module */
+    /* The reason comes from dlerror, so errno isn't reported */
     old_errno = errno;
-    errno = 0;
     dl_sym = dlsym(dl_handle, "module");
-    new_errno = errno;
     errno = old_errno;
     if (dl_sym == NULL)
       {
-        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Failed to find module object with reason '%s' and errno was '%d'\n", dlerror(), new_errno);
+        log_failure(ctx, "Failed to find module object", argv[1], dlerror(), NULL, 0);
         goto err_dl_sym;
       }
     /* Create/get a live module from the module */
     rv = ctx->module_api->live_module_from_module(ctx, dl_sym, &module_cleanup->dependency_want, &module_cleanup->live_module);
     if (rv != EXIT_SUCCESS)
       {
-        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unable to create/get live module from module\n");
+        log_failure(ctx, "Unable to create/get live module from module", argv[1], NULL, NULL, 0);
         goto err_live_module;
       }
     /* Pin the cmd_load module until the observer has performed clean-up */
@@ -218,14 +241,14 @@ static int cmd_load(struct api_command * api, struct command * command, int argc
     dependency_rv = ctx->api_dependency->want(ctx->api_dependency, &live_module->dependency, &module_cleanup->cmd_load_want);
     if (dependency_rv != apivalue_dependency_success)
       {
-        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unable to associate shut-down of live module with cmd_load module\n");
+        log_failure(ctx, "Unable to associate shut-down of live module with cmd_load module", argv[1], NULL, NULL, 0);
         goto err_cmd_load_want;
       }
     /* Attach observer */
     dependency_rv = ctx->api_dependency->observe(ctx->api_dependency, &module_cleanup->live_module->dependency, &module_cleanup->dependency_observe);
     if (dependency_rv != apivalue_dependency_success)
       {
-        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unable to provide proper shut-down for live module\n");
+        log_failure(ctx, "Unable to provide proper shut-down for live module", argv[1], NULL, NULL, 0);
         goto err_dependency_observe;
       }
     /* The observer is now responsible for freeing the clean-up and for 'dlclose' */
@@ -236,14 +259,14 @@ static int cmd_load(struct api_command * api, struct command * command, int argc
     rv = ctx->module_api->load(ctx, module_cleanup->live_module);
     if (rv != EXIT_SUCCESS)
       {
-        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Failed to load module with error '%d'\n", rv);
+        log_failure(ctx, "Failed to load module", argv[1], NULL, "status", rv);
         goto err_load;
       }
     /* Grant the thread context to the module */
     rv = ctx->module_api->thread_started(ctx, module_cleanup->live_module);
     if (rv != EXIT_SUCCESS)
       {
-        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Failed to grant thread context to loaded module with error '%d'\n", rv);
+        log_failure(ctx, "Failed to grant thread context to loaded module", argv[1], NULL, "status", rv);
         goto err_thread_started;
       }
     (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "Module '%s' loaded\n", module_cleanup->live_module->module.v1.nice_name);
@@ -345,6 +368,33 @@ static void help(struct top * ctx)
     (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "%s", usage);
   }
 
+/* With whichever of the module's path, a reason and a number are known */
+static void log_failure(struct top * ctx, const char * message, const char * path, const char * reason, const char * key, int value)
+  {
+    size_t count;
+    struct log_field fields[3];
+    char number[16];
+
+    count = 0;
+    if (path != NULL)
+      {
+        fields[count].key = "path";
+        fields[count++].value = path;
+      }
+    if (reason != NULL)
+      {
+        fields[count].key = "reason";
+        fields[count++].value = reason;
+      }
+    if (key != NULL)
+      {
+        sprintf(number, "%d", value);
+        fields[count].key = key;
+        fields[count++].value = number;
+      }
+    ctx->log(live_module, apivalue_log_level_error, message, fields, count);
+  }
+
 static void module_observe(struct api_dependency * api, struct dependency * dependency, struct dependency_observe * dependency_observe, enum apivalue_dependency type, void * pointer)
   {
     struct module_observer * module_cleanup;
@@ -369,7 +419,7 @@ static void module_observe(struct api_dependency * api, struct dependency * depe
         rv = module_cleanup->ctx->schedule_last(live_module, &module_cleanup->work_item, module_cleanup->ctx->work_list);
         if (rv != EXIT_SUCCESS)
           {
-            (void) module_cleanup->ctx->api_stdio->fprintf(module_cleanup->ctx->api_stdio, stderr, "Unable to clean up loaded module, so it's been leaked\n");
+            log_failure(module_cleanup->ctx, "Unable to clean up loaded module, so it's been leaked", NULL, NULL, "status", rv);
             return;
           }
 
@@ -382,6 +432,7 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
   {
     struct cmd_load (* commands)[3];
     struct top * ctx;
+    struct log_field field;
     size_t i;
     size_t j;
     int rv;
@@ -399,7 +450,7 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
         commands = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *commands);
         if (commands == NULL)
           {
-            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while registering 'load', 'list_modules', 'unload' commands\n");
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'load', 'list_modules', 'unload' commands", NULL, 0);
             return EXIT_FAILURE;
           }
         live_module->module.v1.module_pointers[0] = commands;
@@ -416,7 +467,9 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
             rv = ctx->api_command->add(ctx->api_command, &(*commands)[i].command);
             if (rv != EXIT_SUCCESS)
               {
-                (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Error '%d' while attempting to register '%s' command\n", rv, (*commands)[i].command.name);
+                field.key = "command";
+                field.value = (*commands)[i].command.name;
+                ctx->log(live_module, apivalue_log_level_error, "Unable to register a command", &field, 1);
                 for (j = 0; j < i; ++j)
                   (void) ctx->api_command->remove(ctx->api_command, &(*commands)[i].command);
                 return rv;
@@ -441,7 +494,9 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
             rv = ctx->api_command->remove(ctx->api_command, &(*commands)[i].command);
             if (rv != EXIT_SUCCESS)
               {
-                (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Error '%d' while attempting to deregister '%s' command\n", rv, (*commands)[i].command.name);
+                field.key = "command";
+                field.value = (*commands)[i].command.name;
+                ctx->log(live_module, apivalue_log_level_error, "Unable to deregister a command", &field, 1);
                 /* Oh well.  Leak */
                 return rv;
               }
@@ -469,6 +524,8 @@ static int module_unloaded(struct work_item * work_item)
     ctx = module_cleanup->ctx;
     ctx->api_dependency->initialize_want(ctx->api_dependency, &temp_want);
     ctx->api_dependency->swap_want(ctx->api_dependency, &live_module->dependency, &module_cleanup->cmd_load_want, &temp_want);
+    /* Cached knowledge about types might refer to the module's types */
+    ctx->api_type->forget_caches(ctx->api_type);
     /* POSIX */
     dl_handle = module_cleanup->dl_handle;
     old_errno = errno;
@@ -478,7 +535,7 @@ static int module_unloaded(struct work_item * work_item)
     errno = old_errno;
     if (rv != 0 || new_errno != 0)
       {
-        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "A module was unloaded, but 'dlclose' failed with return-value '%d' and errno '%d' with message '%s'\n", rv, new_errno, strerror(new_errno));
+        log_failure(ctx, "A module was unloaded, but 'dlclose' failed", NULL, new_errno != 0 ? strerror(new_errno) : dlerror(), "status", rv);
         rv = EXIT_FAILURE;
       }
       else
@@ -0,0 +1,977 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "builtins.h"
+#include "command.h"
+#include "toy.h"
+#include "toydef.h"
+#include "toyio.h"
+#include "toylib.h"
+#include "toyscope.h"
+#include "list.h"
+#include "module.h"
+#include "type.h"
+
+struct cmd_math;
+struct math_kernels;
+struct math_scalar;
+
+enum math_field
+  {
+    math_field_signed,
+    math_field_unsigned,
+    math_field_floating,
+    math_fields
+  };
+
+enum math_kind
+  {
+    math_kind_signed_char,
+    math_kind_unsigned_char,
+    math_kind_short,
+    math_kind_unsigned_short,
+    math_kind_int,
+    math_kind_unsigned_int,
+    math_kind_long,
+    math_kind_unsigned_long,
+    math_kind_float,
+    math_kind_double,
+    math_kind_long_double,
+    math_kinds
+  };
+
+enum math_reduction
+  {
+    math_reduction_sum,
+    math_reduction_min,
+    math_reduction_max,
+    math_reductions
+  };
+
+struct cmd_math
+  {
+    struct command command;
+    struct top * ctx;
+  };
+
+/* Only the member for the element type's math_field is used */
+struct math_scalar
+  {
+    long int l;
+    unsigned long int u;
+    long double f;
+  };
+
+typedef void func_math_axpy(void *, const void *, size_t, const struct math_scalar *);
+typedef void func_math_fill(void *, size_t, const struct math_scalar *);
+typedef void func_math_reduce(const void *, size_t, struct math_scalar *);
+typedef void func_math_scale(void *, size_t, const struct math_scalar *);
+
+struct math_kernels
+  {
+    enum math_field field;
+    /* For showing floating results without losing much */
+    int digits;
+    func_math_axpy * axpy;
+    func_math_fill * fill;
+    func_math_reduce * reduce[math_reductions];
+    func_math_scale * scale;
+  };
+
+static apifunction_command cmd_axpy;
+static apifunction_command cmd_fill;
+static apifunction_command cmd_make_array;
+static apifunction_command cmd_max;
+static apifunction_command cmd_min;
+static apifunction_command cmd_scale;
+static apifunction_command cmd_sort;
+static apifunction_command cmd_sum;
+static int find_array(struct top *, char *, struct toy_scope_identifier **, struct type_array **, const struct math_kernels **);
+static enum math_kind kind_of_type(struct type_object *);
+static func_module_event module_event;
+static int parse_scalar(struct top *, const struct math_kernels *, char *, struct math_scalar *);
+static int reduce(struct command *, int, char **, enum math_reduction);
+
+static struct command command_axpy;
+static struct command command_fill;
+static struct command command_make_array;
+static struct command command_max;
+static struct command command_min;
+static struct command command_scale;
+static struct command command_sort;
+static struct command command_sum;
+static struct live_module * live_module;
+
+/*
+ * Each kernel works on whole arrays, so that the per-element work is a
+ * simple loop that a compiler can unroll and vectorize.  Sums use several
+ * accumulators, to avoid waiting on each addition.  Integer arithmetic is
+ * done in 'unsigned long int', so that overflow wraps instead of being
+ * undefined
+ */
+#define MATH_KERNELS(name, type, field, wide) \
+  static void math_axpy_##name(void * y_array, const void * x_array, size_t count, const struct math_scalar * alpha) \
+    { \
+      wide a; \
+      size_t i; \
+      const type * x; \
+      type * y; \
+ \
+      y = y_array; \
+      x = x_array; \
+      a = (wide) alpha->field; \
+      for (i = 0; i < count; ++i) \
+        y[i] = (type) ((wide) y[i] + a * (wide) x[i]); \
+    } \
+ \
+  static void math_fill_##name(void * array, size_t count, const struct math_scalar * value) \
+    { \
+      type * a; \
+      size_t i; \
+      type v; \
+ \
+      a = array; \
+      v = (type) value->field; \
+      for (i = 0; i < count; ++i) \
+        a[i] = v; \
+    } \
+ \
+  static void math_max_##name(const void * array, size_t count, struct math_scalar * result) \
+    { \
+      const type * a; \
+      size_t i; \
+      type m0; \
+      type m1; \
+      type m2; \
+      type m3; \
+ \
+      a = array; \
+      m0 = m1 = m2 = m3 = a[0]; \
+      for (i = 0; i + 4 <= count; i += 4) \
+        { \
+          if (a[i + 0] > m0) \
+            m0 = a[i + 0]; \
+          if (a[i + 1] > m1) \
+            m1 = a[i + 1]; \
+          if (a[i + 2] > m2) \
+            m2 = a[i + 2]; \
+          if (a[i + 3] > m3) \
+            m3 = a[i + 3]; \
+        } \
+      for (; i < count; ++i) \
+        { \
+          if (a[i] > m0) \
+            m0 = a[i]; \
+        } \
+      if (m1 > m0) \
+        m0 = m1; \
+      if (m3 > m2) \
+        m2 = m3; \
+      if (m2 > m0) \
+        m0 = m2; \
+      result->field = m0; \
+    } \
+ \
+  static void math_min_##name(const void * array, size_t count, struct math_scalar * result) \
+    { \
+      const type * a; \
+      size_t i; \
+      type m0; \
+      type m1; \
+      type m2; \
+      type m3; \
+ \
+      a = array; \
+      m0 = m1 = m2 = m3 = a[0]; \
+      for (i = 0; i + 4 <= count; i += 4) \
+        { \
+          if (a[i + 0] < m0) \
+            m0 = a[i + 0]; \
+          if (a[i + 1] < m1) \
+            m1 = a[i + 1]; \
+          if (a[i + 2] < m2) \
+            m2 = a[i + 2]; \
+          if (a[i + 3] < m3) \
+            m3 = a[i + 3]; \
+        } \
+      for (; i < count; ++i) \
+        { \
+          if (a[i] < m0) \
+            m0 = a[i]; \
+        } \
+      if (m1 < m0) \
+        m0 = m1; \
+      if (m3 < m2) \
+        m2 = m3; \
+      if (m2 < m0) \
+        m0 = m2; \
+      result->field = m0; \
+    } \
+ \
+  static void math_scale_##name(void * array, size_t count, const struct math_scalar * factor) \
+    { \
+      type * a; \
+      wide f; \
+      size_t i; \
+ \
+      a = array; \
+      f = (wide) factor->field; \
+      for (i = 0; i < count; ++i) \
+        a[i] = (type) ((wide) a[i] * f); \
+    } \
+ \
+  static void math_sum_##name(const void * array, size_t count, struct math_scalar * result) \
+    { \
+      const type * a; \
+      size_t i; \
+      wide s0; \
+      wide s1; \
+      wide s2; \
+      wide s3; \
+ \
+      a = array; \
+      s0 = s1 = s2 = s3 = 0; \
+      for (i = 0; i + 4 <= count; i += 4) \
+        { \
+          s0 += (wide) a[i + 0]; \
+          s1 += (wide) a[i + 1]; \
+          s2 += (wide) a[i + 2]; \
+          s3 += (wide) a[i + 3]; \
+        } \
+      for (; i < count; ++i) \
+        s0 += (wide) a[i]; \
+      result->field = (s0 + s1) + (s2 + s3); \
+    }
+
+MATH_KERNELS(signed_char, signed char, l, unsigned long int)
+MATH_KERNELS(unsigned_char, unsigned char, u, unsigned long int)
+MATH_KERNELS(short, short int, l, unsigned long int)
+MATH_KERNELS(unsigned_short, unsigned short int, u, unsigned long int)
+MATH_KERNELS(int, int, l, unsigned long int)
+MATH_KERNELS(unsigned_int, unsigned int, u, unsigned long int)
+MATH_KERNELS(long, long int, l, unsigned long int)
+MATH_KERNELS(unsigned_long, unsigned long int, u, unsigned long int)
+MATH_KERNELS(float, float, f, double)
+MATH_KERNELS(double, double, f, double)
+MATH_KERNELS(long_double, long double, f, long double)
+
+#define MATH_KERNELS_ENTRY(name, field, digits) \
+  { \
+    field, \
+    digits, \
+    &math_axpy_##name, \
+    &math_fill_##name, \
+    { \
+      &math_sum_##name, \
+      &math_min_##name, \
+      &math_max_##name \
+    }, \
+    &math_scale_##name \
+  }
+
+/* Indexed by math_kind */
+static const struct math_kernels math_kernels[] =
+  {
+    MATH_KERNELS_ENTRY(signed_char, math_field_signed, 0),
+    MATH_KERNELS_ENTRY(unsigned_char, math_field_unsigned, 0),
+    MATH_KERNELS_ENTRY(short, math_field_signed, 0),
+    MATH_KERNELS_ENTRY(unsigned_short, math_field_unsigned, 0),
+    MATH_KERNELS_ENTRY(int, math_field_signed, 0),
+    MATH_KERNELS_ENTRY(unsigned_int, math_field_unsigned, 0),
+    MATH_KERNELS_ENTRY(long, math_field_signed, 0),
+    MATH_KERNELS_ENTRY(unsigned_long, math_field_unsigned, 0),
+    MATH_KERNELS_ENTRY(float, math_field_floating, FLT_DIG + 3),
+    MATH_KERNELS_ENTRY(double, math_field_floating, DBL_DIG + 2),
+    MATH_KERNELS_ENTRY(long_double, math_field_floating, LDBL_DIG + 2)
+  };
+
+#if BUILTIN_CMD_MATH
+union module builtin_module_cmd_math =
+#else
+union module module =
+#endif
+  {
+    {
+      {
+        module_signature,
+        "2024120200",
+        apivalue_module_api_version
+      },
+      &module_event,
+      {
+        NULL,
+        NULL,
+        NULL,
+        NULL
+      },
+      "cmd_math"
+    }
+  };
+
+static struct command command_axpy =
+  {
+    NULL,
+    "axpy",
+    &cmd_axpy,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static struct command command_fill =
+  {
+    NULL,
+    "fill",
+    &cmd_fill,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static struct command command_make_array =
+  {
+    NULL,
+    "make_array",
+    &cmd_make_array,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static struct command command_max =
+  {
+    NULL,
+    "max",
+    &cmd_max,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static struct command command_min =
+  {
+    NULL,
+    "min",
+    &cmd_min,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static struct command command_scale =
+  {
+    NULL,
+    "scale",
+    &cmd_scale,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static struct command command_sort =
+  {
+    NULL,
+    "sort",
+    &cmd_sort,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static struct command command_sum =
+  {
+    NULL,
+    "sum",
+    &cmd_sum,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static int cmd_axpy(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct math_scalar alpha;
+    struct cmd_math * cmd;
+    struct top * ctx;
+    const struct math_kernels * kernels;
+    const struct math_kernels * kernels_x;
+    struct api_type * type_api;
+    struct type_array * type_x;
+    struct type_array * type_y;
+    struct toy_scope_identifier * x;
+    struct toy_scope_identifier * y;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_math, command, command);
+    ctx = cmd->ctx;
+    type_api = ctx->api_type;
+
+    if (argc != 4)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage:\n  axpy Y ALPHA X  For each element, Y = Y + ALPHA * X\n");
+        return EXIT_FAILURE;
+      }
+    if (find_array(ctx, argv[1], &y, &type_y, &kernels) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    if (find_array(ctx, argv[3], &x, &type_x, &kernels_x) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    if (type_api->compatible_types(type_api, &type_y->object.type, &type_x->object.type) != apivalue_type_success)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Types '%s' and '%s' are not compatible\n", type_y->object.type.nice_name, type_x->object.type.nice_name);
+        return EXIT_FAILURE;
+      }
+    if (parse_scalar(ctx, kernels, argv[2], &alpha) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    kernels->axpy(y->value, x->value, type_y->element_count, &alpha);
+    return EXIT_SUCCESS;
+  }
+
+static int cmd_fill(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_math * cmd;
+    struct top * ctx;
+    struct toy_scope_identifier * identifier;
+    const struct math_kernels * kernels;
+    struct type_array * type;
+    struct math_scalar value;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_math, command, command);
+    ctx = cmd->ctx;
+
+    if (argc != 3)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage:\n  fill IDENTIFIER VALUE  Set every element to VALUE\n");
+        return EXIT_FAILURE;
+      }
+    if (find_array(ctx, argv[1], &identifier, &type, &kernels) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    if (parse_scalar(ctx, kernels, argv[2], &value) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    kernels->fill(identifier->value, type->element_count, &value);
+    return EXIT_SUCCESS;
+  }
+
+static int cmd_make_array(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct type_array * array_type;
+    struct toy_scope_chain * chain;
+    struct cmd_math * cmd;
+    unsigned long int count;
+    struct top * ctx;
+    struct type_object * element_type;
+    char * endptr;
+    size_t i;
+    struct toy_scope_identifier * identifier;
+    int new_errno;
+    int old_errno;
+    struct api_toy_scope * toy_scope_api;
+    enum apivalue_toy_scope toy_scope_rv;
+    struct type * type;
+    struct api_type * type_api;
+    enum apivalue_type type_rv;
+    static const char usage[] =
+      "Usage:\n"
+      "  make_array IDENTIFIER TYPE COUNT  Make a zeroed array of COUNT elements of TYPE\n"
+      "Notes:\n"
+      "  TYPE is a type's name or \"sd\" identifier, such as 'double' or\n"
+      "  'sd_integer_unsigned_long'.  Only arrays of arithmetic types can be\n"
+      "  used for math, but any array can be sorted.\n"
+      ;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_math, command, command);
+    ctx = cmd->ctx;
+    toy_scope_api = ctx->api_toy_scope;
+    type_api = ctx->api_type;
+
+    if (argc != 4)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "%s", usage);
+        return EXIT_FAILURE;
+      }
+    chain = toy_scope_api->primary_chain;
+    if (chain == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "There is no toy-scope-chain to put the identifier into\n");
+        return EXIT_FAILURE;
+      }
+
+    for (i = 0; i < type_api->type_count; ++i)
+      {
+        type = type_api->types[i].type;
+        if (strcmp(argv[2], type_api->types[i].identifier) == 0 || strcmp(argv[2], type->nice_name) == 0)
+          break;
+      }
+    if (i == type_api->type_count)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unknown type '%s'\n", argv[2]);
+        return EXIT_FAILURE;
+      }
+    element_type = type_with_member_at_ptr(struct type_object, type, type);
+    if (type->partition != apivalue_type_partition_object || element_type->size == 0)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Type '%s' is not a complete object type\n", type->nice_name);
+        return EXIT_FAILURE;
+      }
+
+    old_errno = errno;
+    errno = 0;
+    count = strtoul(argv[3], &endptr, 0);
+    new_errno = errno;
+    errno = old_errno;
+    if (new_errno != 0 || *endptr != '\0' || count == 0 || count != (size_t) count)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unrecognized or unsupported COUNT '%s'\n", argv[3]);
+        return EXIT_FAILURE;
+      }
+
+    type_rv = type_api->array_type(type_api, element_type, (size_t) count, &array_type);
+    if (type_rv != apivalue_type_success)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unable to make the array type, with error '%d'\n", type_rv);
+        return EXIT_FAILURE;
+      }
+    toy_scope_rv = toy_scope_api->allocate_identifier(toy_scope_api, &identifier, argv[1], &array_type->object.type);
+    if (toy_scope_rv != apivalue_toy_scope_success)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Allocating identifier failed with error '%d'\n", toy_scope_rv);
+        return EXIT_FAILURE;
+      }
+    memset(identifier->value, 0, array_type->object.size);
+    /* Add it to the top scope */
+    toy_scope_rv = toy_scope_api->add_identifier_to_scope(toy_scope_api, identifier, chain->scopes[chain->count - 1]);
+    if (toy_scope_rv != apivalue_toy_scope_success)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Adding identifier failed with error '%d'\n", toy_scope_rv);
+        ctx->api_stdlib->free(ctx->api_stdlib, identifier);
+        return EXIT_FAILURE;
+      }
+    return EXIT_SUCCESS;
+  }
+
+static int cmd_max(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    (void) api;
+
+    return reduce(command, argc, argv, math_reduction_max);
+  }
+
+static int cmd_min(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    (void) api;
+
+    return reduce(command, argc, argv, math_reduction_min);
+  }
+
+static int cmd_scale(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_math * cmd;
+    struct top * ctx;
+    struct math_scalar factor;
+    struct toy_scope_identifier * identifier;
+    const struct math_kernels * kernels;
+    struct type_array * type;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_math, command, command);
+    ctx = cmd->ctx;
+
+    if (argc != 3)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage:\n  scale IDENTIFIER FACTOR  Multiply every element by FACTOR\n");
+        return EXIT_FAILURE;
+      }
+    if (find_array(ctx, argv[1], &identifier, &type, &kernels) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    if (parse_scalar(ctx, kernels, argv[2], &factor) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    kernels->scale(identifier->value, type->element_count, &factor);
+    return EXIT_SUCCESS;
+  }
+
+static int cmd_sort(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct type_array * array_type;
+    struct toy_scope_chain * chain;
+    struct cmd_math * cmd;
+    struct top * ctx;
+    int descending;
+    struct toy_scope_identifier * identifier;
+    char * member_name;
+    struct type_object * object_type;
+    struct api_toy_scope * toy_scope_api;
+    struct type * type;
+    struct api_type * type_api;
+    enum apivalue_type type_rv;
+    static const char usage[] =
+      "Usage:\n"
+      "  sort IDENTIFIER [MEMBER] [desc]  Sort an array in place\n"
+      "Notes:\n"
+      "  Arrays of integers, 'float' and 'double' are radix-sorted.  Arrays of\n"
+      "  structures are sorted by the arithmetic MEMBER, keeping the order of\n"
+      "  equal elements.\n"
+      ;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_math, command, command);
+    ctx = cmd->ctx;
+    toy_scope_api = ctx->api_toy_scope;
+    type_api = ctx->api_type;
+
+    descending = 0;
+    if (argc > 2 && strcmp(argv[argc - 1], "desc") == 0)
+      {
+        descending = 1;
+        --argc;
+      }
+    if (argc != 2 && argc != 3)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "%s", usage);
+        return EXIT_FAILURE;
+      }
+    member_name = argc == 3 ? argv[2] : NULL;
+
+    chain = toy_scope_api->primary_chain;
+    if (chain == NULL || toy_scope_api->find_identifier_in_scope_chain(toy_scope_api, &identifier, argv[1], chain) != apivalue_toy_scope_success)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Identifier '%s' not found\n", argv[1]);
+        return EXIT_FAILURE;
+      }
+    type = identifier->type;
+    object_type = type_with_member_at_ptr(struct type_object, type, type);
+    if (type == NULL || type->partition != apivalue_type_partition_object || object_type->object_type != apivalue_type_object_array || identifier->value == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Identifier '%s' is not an array\n", argv[1]);
+        return EXIT_FAILURE;
+      }
+    array_type = type_with_member_at_ptr(struct type_array, object, object_type);
+    type_rv = type_api->sort_array(type_api, array_type, identifier->value, member_name, descending);
+    switch (type_rv)
+      {
+        case apivalue_type_success:
+        return EXIT_SUCCESS;
+
+        case apivalue_type_error_not_found:
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Type '%s' has no member '%s'\n", array_type->element_type->type.nice_name, member_name);
+        return EXIT_FAILURE;
+
+        case apivalue_type_error_not_compatible:
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Elements of type '%s' can't be sorted that way\n", array_type->element_type->type.nice_name);
+        return EXIT_FAILURE;
+
+        default:
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Sorting failed with error '%d'\n", type_rv);
+        return EXIT_FAILURE;
+      }
+  }
+
+static int cmd_sum(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    (void) api;
+
+    return reduce(command, argc, argv, math_reduction_sum);
+  }
+
+static int find_array(struct top * ctx, char * name, struct toy_scope_identifier ** identifier, struct type_array ** array_type, const struct math_kernels ** kernels)
+  {
+    struct toy_scope_chain * chain;
+    enum math_kind kind;
+    struct type_object * object_type;
+    struct api_toy_scope * toy_scope_api;
+    struct type * type;
+
+    toy_scope_api = ctx->api_toy_scope;
+    chain = toy_scope_api->primary_chain;
+    if (chain == NULL || toy_scope_api->find_identifier_in_scope_chain(toy_scope_api, identifier, name, chain) != apivalue_toy_scope_success)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Identifier '%s' not found\n", name);
+        return EXIT_FAILURE;
+      }
+    type = (*identifier)->type;
+    if (type == NULL || type->partition != apivalue_type_partition_object || (*identifier)->value == NULL)
+      goto err_type;
+    object_type = type_with_member_at_ptr(struct type_object, type, type);
+    if (object_type->object_type != apivalue_type_object_array)
+      goto err_type;
+    *array_type = type_with_member_at_ptr(struct type_array, object, object_type);
+    kind = kind_of_type((*array_type)->element_type);
+    if (kind == math_kinds || (*array_type)->element_count == 0)
+      goto err_type;
+    *kernels = math_kernels + kind;
+    return EXIT_SUCCESS;
+
+    err_type:
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Identifier '%s' is not an array of a supported arithmetic type\n", name);
+    return EXIT_FAILURE;
+  }
+
+static enum math_kind kind_of_type(struct type_object * object_type)
+  {
+    struct type_arithmetic * arithmetic_type;
+    struct type_floating * floating_type;
+    struct type_integer * integer_type;
+    int is_unsigned;
+
+    if (object_type->object_type != apivalue_type_object_arithmetic)
+      return math_kinds;
+    arithmetic_type = type_with_member_at_ptr(struct type_arithmetic, object, object_type);
+    if (arithmetic_type->arithmetic_type == apivalue_type_arithmetic_floating)
+      {
+        floating_type = type_with_member_at_ptr(struct type_floating, arithmetic, arithmetic_type);
+        switch (floating_type->floating_type)
+          {
+            case apivalue_type_floating_float:
+            return math_kind_float;
+
+            case apivalue_type_floating_double:
+            return math_kind_double;
+
+            case apivalue_type_floating_long_double:
+            return math_kind_long_double;
+
+            case apivalue_type_floatings:
+            break;
+          }
+        return math_kinds;
+      }
+    integer_type = type_with_member_at_ptr(struct type_integer, arithmetic, arithmetic_type);
+    is_unsigned = integer_type->sign == apivalue_type_unsigned;
+    switch (integer_type->integer_type)
+      {
+        case apivalue_type_integer_char:
+        if (integer_type->sign == apivalue_type_sign_implementation_defined)
+          is_unsigned = CHAR_MIN == 0;
+        return is_unsigned ? math_kind_unsigned_char : math_kind_signed_char;
+
+        case apivalue_type_integer_short:
+        return is_unsigned ? math_kind_unsigned_short : math_kind_short;
+
+        case apivalue_type_integer_int:
+        return is_unsigned ? math_kind_unsigned_int : math_kind_int;
+
+        case apivalue_type_integer_long:
+        return is_unsigned ? math_kind_unsigned_long : math_kind_long;
+
+        case apivalue_type_integer_size_t:
+        if (object_type->size == sizeof (unsigned int))
+          return math_kind_unsigned_int;
+        if (object_type->size == sizeof (unsigned long int))
+          return math_kind_unsigned_long;
+        return math_kinds;
+
+        /* C89 has no 'long long int' and enumerations aren't numbers to do math with */
+        case apivalue_type_integer_longlong:
+        case apivalue_type_integer_enum:
+        case apivalue_type_integers:
+        break;
+      }
+    return math_kinds;
+  }
+
+static int parse_scalar(struct top * ctx, const struct math_kernels * kernels, char * text, struct math_scalar * scalar)
+  {
+    char * endptr;
+    int new_errno;
+    int old_errno;
+
+    scalar->l = 0;
+    scalar->u = 0;
+    scalar->f = 0;
+    old_errno = errno;
+    errno = 0;
+    switch (kernels->field)
+      {
+        case math_field_signed:
+        scalar->l = strtol(text, &endptr, 0);
+        break;
+
+        case math_field_unsigned:
+        scalar->u = strtoul(text, &endptr, 0);
+        break;
+
+        case math_field_floating:
+        case math_fields:
+        scalar->f = strtod(text, &endptr);
+        break;
+      }
+    new_errno = errno;
+    errno = old_errno;
+    if (new_errno != 0 || *endptr != '\0' || endptr == text)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unrecognized number '%s'\n", text);
+        return EXIT_FAILURE;
+      }
+    return EXIT_SUCCESS;
+  }
+
+static int reduce(struct command * command, int argc, char ** argv, enum math_reduction reduction)
+  {
+    struct cmd_math * cmd;
+    struct top * ctx;
+    struct toy_scope_identifier * identifier;
+    const struct math_kernels * kernels;
+    struct math_scalar result;
+    struct type_array * type;
+
+    cmd = type_with_member_at_ptr(struct cmd_math, command, command);
+    ctx = cmd->ctx;
+
+    if (argc != 2)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage:\n  %s IDENTIFIER\n", command->name);
+        return EXIT_FAILURE;
+      }
+    if (find_array(ctx, argv[1], &identifier, &type, &kernels) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    kernels->reduce[reduction](identifier->value, type->element_count, &result);
+    switch (kernels->field)
+      {
+        case math_field_signed:
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%ld\n", result.l);
+        break;
+
+        case math_field_unsigned:
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%lu\n", result.u);
+        break;
+
+        case math_field_floating:
+        case math_fields:
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%.*Lg\n", kernels->digits, result.f);
+        break;
+      }
+    return EXIT_SUCCESS;
+  }
+
+static int module_event(enum apivalue_module_event_type type, void * event_data)
+  {
+    struct cmd_math (* commands)[8];
+    struct top * ctx;
+    struct log_field field;
+    size_t i;
+    size_t j;
+    int rv;
+
+    switch (type)
+      {
+        case apivalue_module_event_type_loaded:
+        if (live_module != NULL)
+          return EXIT_FAILURE;
+        live_module = event_data;
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_thread_started:
+        ctx = event_data;
+        commands = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *commands);
+        if (commands == NULL)
+          {
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'axpy', 'fill', 'make_array', 'max', 'min', 'scale', 'sort', 'sum' commands", NULL, 0);
+            return EXIT_FAILURE;
+          }
+        live_module->module.v1.module_pointers[0] = commands;
+        (*commands)[0].command = command_axpy;
+        (*commands)[1].command = command_fill;
+        (*commands)[2].command = command_make_array;
+        (*commands)[3].command = command_max;
+        (*commands)[4].command = command_min;
+        (*commands)[5].command = command_scale;
+        (*commands)[6].command = command_sort;
+        (*commands)[7].command = command_sum;
+        rv = EXIT_SUCCESS;
+        for (i = 0; i < countof(*commands); ++i)
+          {
+            (*commands)[i].ctx = ctx;
+            (*commands)[i].command.live_module = live_module;
+            (void) ctx->api_list->initialize_list_item(ctx->api_list, &(*commands)[i].command.list_item);
+            rv = ctx->api_command->add(ctx->api_command, &(*commands)[i].command);
+            if (rv != EXIT_SUCCESS)
+              {
+                field.key = "command";
+                field.value = (*commands)[i].command.name;
+                ctx->log(live_module, apivalue_log_level_error, "Unable to register a command", &field, 1);
+                for (j = 0; j < i; ++j)
+                  (void) ctx->api_command->remove(ctx->api_command, &(*commands)[j].command);
+                ctx->api_stdlib->free(ctx->api_stdlib, commands);
+                live_module->module.v1.module_pointers[0] = NULL;
+                return rv;
+              }
+          }
+        return rv;
+
+        case apivalue_module_event_type_thread_stop_requested:
+        case apivalue_module_event_type_thread_stopped:
+        case apivalue_module_event_type_unload_requested:
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_unload:
+        /* Assume success until proven otherwise */
+        rv = EXIT_SUCCESS;
+        commands = live_module->module.v1.module_pointers[0];
+        if (commands != NULL)
+          {
+            ctx = (*commands)[0].ctx;
+            for (i = 0; i < countof(*commands); ++i)
+              {
+                rv = ctx->api_command->remove(ctx->api_command, &(*commands)[i].command);
+                if (rv != EXIT_SUCCESS)
+                  return rv;
+              }
+            ctx->api_stdlib->free(ctx->api_stdlib, commands);
+          }
+        live_module = NULL;
+        return rv;
+      }
+    return EXIT_FAILURE;
+  }
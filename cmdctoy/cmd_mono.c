@@ -44,7 +44,7 @@ union module module =
       {
         module_signature,
         "2024120200",
-        1
+        apivalue_module_api_version
       },
       &module_event,
       {
@@ -65,7 +65,11 @@ static struct command command_delete_identifier =
     {
       NULL,
       NULL
-    }
+    },
+    NULL,
+    NULL,
+    0,
+    0
   };
 
 static struct command command_find_identifier =
@@ -76,7 +80,11 @@ static struct command command_find_identifier =
     {
       NULL,
       NULL
-    }
+    },
+    NULL,
+    NULL,
+    0,
+    apivalue_command_flag_pure
   };
 
 static struct command command_list_identifiers =
@@ -87,7 +95,11 @@ static struct command command_list_identifiers =
     {
       NULL,
       NULL
-    }
+    },
+    NULL,
+    NULL,
+    0,
+    apivalue_command_flag_pure
   };
 
 static struct command command_load_types =
@@ -98,7 +110,11 @@ static struct command command_load_types =
     {
       NULL,
       NULL
-    }
+    },
+    NULL,
+    NULL,
+    0,
+    0
   };
 
 static struct command command_make_identifier =
@@ -109,7 +125,11 @@ static struct command command_make_identifier =
     {
       NULL,
       NULL
-    }
+    },
+    NULL,
+    NULL,
+    0,
+    0
   };
 
 static struct command command_swap_scopes =
@@ -120,7 +140,11 @@ static struct command command_swap_scopes =
     {
       NULL,
       NULL
-    }
+    },
+    NULL,
+    NULL,
+    0,
+    0
   };
 
 static int cmd_delete_identifier(struct api_command * api, struct command * command, int argc, char ** argv)
@@ -235,7 +259,9 @@ static int cmd_list_identifiers(struct api_command * api, struct command * comma
         for (btree_node = btree_api->ordered_visit(btree_api, &scope->btree, NULL, apivalue_btree_direction_more); btree_node != NULL; btree_node = btree_api->ordered_visit(btree_api, &scope->btree, btree_node, apivalue_btree_direction_more))
           {
             identifier = type_with_member_at_ptr(struct toy_scope_identifier, btree_node, btree_node);
-            (void) stdio_api->fprintf(stdio_api, stdout, "    %s\n", identifier->name);
+            (void) stdio_api->append_string(stdio_api, "    ", stdout);
+            (void) stdio_api->append_string(stdio_api, identifier->name, stdout);
+            (void) stdio_api->append_string(stdio_api, "\n", stdout);
           }
       }
     return EXIT_SUCCESS;
@@ -388,6 +414,7 @@ static int cmd_swap_scopes(struct api_command * api, struct command * command, i
     scope = chain->scopes[0];
     chain->scopes[0] = chain->scopes[1];
     chain->scopes[1] = scope;
+    ++ctx->api_toy_scope->version;
     return EXIT_SUCCESS;
   }
 
@@ -396,6 +423,7 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
     struct api_command * command_api;
     struct cmd_monolith (* commands)[6];
     struct top * ctx;
+    struct log_field field;
     size_t i;
     size_t j;
     struct api_list * list_api;
@@ -449,7 +477,7 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
         commands = stdlib_api->malloc(stdlib_api, sizeof *commands);
         if (commands == NULL)
           {
-            (void) stdio_api->fprintf(stdio_api, stderr, "Out of memory while registering 'delete_identifier', 'find_identifier', 'list_identifiers', 'load_types', 'make_identifier', 'swap_scopes' commands\n");
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'delete_identifier', 'find_identifier', 'list_identifiers', 'load_types', 'make_identifier', 'swap_scopes' commands", NULL, 0);
             rv = EXIT_FAILURE;
             goto err_commands;
           }
@@ -473,12 +501,17 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
             rv = command_api->add(command_api, &(*commands)[i].command);
             if (rv != EXIT_SUCCESS)
               {
-                (void) stdio_api->fprintf(stdio_api, stderr, "Error '%d' while attempting to register '%s' command\n", rv, (*commands)[i].command.name);
+                field.key = "command";
+                field.value = (*commands)[i].command.name;
+                ctx->log(live_module, apivalue_log_level_error, "Unable to register a command", &field, 1);
                 for (j = 0; j < i; ++j)
                   (void) command_api->remove(command_api, &(*commands)[i].command);
                 return rv;
               }
           }
+        /* Let other modules find identifiers */
+        toy_scope_api->primary_chain = &primary_scope_chain->chain;
+        ++toy_scope_api->version;
         return rv;
 
         stdlib_api->free(stdlib_api, commands);
@@ -500,6 +533,8 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
         primary_scope_chain = live_module->module.v1.module_pointers[0];
         if (primary_scope_chain != NULL)
           {
+            if (primary_scope_chain->ctx->api_toy_scope->primary_chain == &primary_scope_chain->chain)
+              primary_scope_chain->ctx->api_toy_scope->primary_chain = NULL;
             primary_scope_chain->ctx->api_stdlib->free(primary_scope_chain->ctx->api_stdlib, primary_scope_chain);
             live_module->module.v1.module_pointers[0] = NULL;
           }
@@ -517,7 +552,9 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
             rv = command_api->remove(command_api, &(*commands)[i].command);
             if (rv != EXIT_SUCCESS)
               {
-                (void) stdio_api->fprintf(stdio_api, stderr, "Error '%d' while attempting to deregister '%s' command\n", rv, (*commands)[i].command.name);
+                field.key = "command";
+                field.value = (*commands)[i].command.name;
+                ctx->log(live_module, apivalue_log_level_error, "Unable to deregister a command", &field, 1);
                 /* Oh well.  Leak */
                 return rv;
               }
@@ -0,0 +1,543 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+/* TODO: Support non-POSIX */
+#if CMDCTOY_POSIX
+/* For MSG_NOSIGNAL */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "builtins.h"
+#include "command.h"
+#include "toy.h"
+#include "toydef.h"
+#include "toyio.h"
+#include "toylib.h"
+#include "list.h"
+#include "module.h"
+
+struct cmd_server;
+struct server;
+struct session;
+
+enum
+  {
+    /* A client's command-line can't be longer than this */
+    session_line_limit = 1048576,
+    session_buffer_size = 4096
+  };
+
+struct cmd_server
+  {
+    struct command command;
+    struct top * ctx;
+    struct server * server;
+  };
+
+struct server
+  {
+    /* Waits for clients to connect */
+    struct work_item work_item;
+    struct top * ctx;
+    int descriptor;
+    char * path;
+    struct list sessions;
+    unsigned int next_number;
+  };
+
+/*
+ * Each client has its own buffers, so that a slow client doesn't hold up
+ * the others.  What's been read, but not yet run, is from 'input_start' to
+ * 'input_end' and what's waiting to be sent is from 'output_start' to
+ * 'output_end'
+ */
+struct session
+  {
+    struct work_item work_item;
+    struct list_item list_item;
+    struct server * server;
+    unsigned int number;
+    int descriptor;
+    char * input;
+    size_t input_capacity;
+    size_t input_start;
+    size_t input_end;
+    char * output;
+    size_t output_capacity;
+    size_t output_start;
+    size_t output_end;
+    /* The client won't send anymore */
+    int at_end;
+    /* The server is stopping, so finish sending, then close */
+    int stopping;
+  };
+
+static func_work accept_session;
+static apifunction_command cmd_server;
+static void close_session(struct top *, struct session *);
+static func_module_event module_event;
+static int send_output(struct session *);
+static func_work serve_session;
+static int set_nonblocking(int);
+static int start_server(struct top *, struct server *, const char *);
+static void stop_server(struct top *, struct server *);
+
+static struct command command_server;
+static struct live_module * live_module;
+
+#if BUILTIN_CMD_SERVER
+union module builtin_module_cmd_server =
+#else
+union module module =
+#endif
+  {
+    {
+      {
+        module_signature,
+        "2024120200",
+        apivalue_module_api_version
+      },
+      &module_event,
+      {
+        NULL,
+        NULL,
+        NULL,
+        NULL
+      },
+      "cmd_server"
+    }
+  };
+
+static struct command command_server =
+  {
+    NULL,
+    "server",
+    &cmd_server,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static int accept_session(struct work_item * work_item)
+  {
+    struct top * ctx;
+    int descriptor;
+    struct server * server;
+    struct session * session;
+
+    server = type_with_member_at_ptr(struct server, work_item, work_item);
+    ctx = server->ctx;
+
+    if (*(ctx->shutdown_requested))
+      {
+        stop_server(ctx, server);
+        return EXIT_SUCCESS;
+      }
+
+    descriptor = accept(server->descriptor, NULL, NULL);
+    if (descriptor < 0)
+      {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED)
+          {
+            (void) ctx->schedule_ready(live_module, work_item, server->descriptor, apivalue_work_ready_readable);
+            return EXIT_SUCCESS;
+          }
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Error accepting a client, with error '%d' and message '%s', so the server has stopped\n", errno, strerror(errno));
+        stop_server(ctx, server);
+        return EXIT_FAILURE;
+      }
+    if (set_nonblocking(descriptor) != EXIT_SUCCESS)
+      goto err_session;
+    session = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *session);
+    if (session == NULL)
+      goto err_session;
+    session->server = server;
+    session->number = server->next_number++;
+    session->descriptor = descriptor;
+    session->input = NULL;
+    session->input_capacity = 0;
+    session->input_start = 0;
+    session->input_end = 0;
+    session->output = NULL;
+    session->output_capacity = 0;
+    session->output_start = 0;
+    session->output_end = 0;
+    session->at_end = 0;
+    session->stopping = 0;
+    (void) ctx->api_list->add_item_to_list_tail(ctx->api_list, &session->list_item, &server->sessions);
+    (void) ctx->api_list->initialize_list_item(ctx->api_list, &session->work_item.list_item);
+    session->work_item.work = &serve_session;
+    (void) ctx->schedule_last(live_module, &session->work_item, ctx->work_list);
+
+    /* There might be more */
+    (void) ctx->schedule_last(live_module, work_item, ctx->work_list);
+    return EXIT_SUCCESS;
+
+    err_session:
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unable to set up a session, so a client has been turned away\n");
+    (void) close(descriptor);
+    (void) ctx->schedule_last(live_module, work_item, ctx->work_list);
+    return EXIT_FAILURE;
+  }
+
+static int cmd_server(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_server * cmd;
+    struct top * ctx;
+    struct list_item * list_item;
+    struct server * server;
+    struct session * session;
+    static const char usage[] =
+      "Usage:\n"
+      "  server             Show the server's sessions\n"
+      "  server start PATH  Accept clients at the Unix-domain socket PATH\n"
+      "  server stop        Stop accepting clients, and close sessions\n"
+      "Notes:\n"
+      "  For each command-line a client sends, the reply is a line with the\n"
+      "  command's status and the lengths of its standard output and standard\n"
+      "  error, then the standard output, then the standard error.\n"
+      ;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_server, command, command);
+    ctx = cmd->ctx;
+    server = cmd->server;
+
+    if (argc == 1)
+      {
+        if (server->descriptor < 0)
+          {
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "Not serving\n");
+            return EXIT_SUCCESS;
+          }
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "Serving at '%s'\n", server->path);
+        for (list_item = server->sessions.head.next; list_item != &server->sessions.head; list_item = list_item->next)
+          {
+            session = type_with_member_at_ptr(struct session, list_item, list_item);
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "  Session #%u%s\n", session->number, session->stopping ? " (stopping)" : "");
+          }
+        return EXIT_SUCCESS;
+      }
+    if (argc == 3 && strcmp(argv[1], "start") == 0)
+      {
+        if (server->descriptor >= 0)
+          {
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Already serving at '%s'\n", server->path);
+            return EXIT_FAILURE;
+          }
+        return start_server(ctx, server, argv[2]);
+      }
+    if (argc == 2 && strcmp(argv[1], "stop") == 0)
+      {
+        if (server->descriptor < 0)
+          {
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Not serving\n");
+            return EXIT_FAILURE;
+          }
+        stop_server(ctx, server);
+        return EXIT_SUCCESS;
+      }
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "%s", usage);
+    return EXIT_FAILURE;
+  }
+
+static void close_session(struct top * ctx, struct session * session)
+  {
+    if (session->work_item.list_item.next != NULL)
+      (void) ctx->api_list->remove_list_item(ctx->api_list, &session->work_item.list_item);
+    (void) ctx->api_list->remove_list_item(ctx->api_list, &session->list_item);
+    (void) close(session->descriptor);
+    ctx->api_stdlib->free(ctx->api_stdlib, session->input);
+    ctx->api_stdlib->free(ctx->api_stdlib, session->output);
+    ctx->api_stdlib->free(ctx->api_stdlib, session);
+  }
+
+/* Returns EXIT_SUCCESS once everything has been sent */
+static int send_output(struct session * session)
+  {
+    ssize_t count;
+
+    while (session->output_start < session->output_end)
+      {
+        count = send(session->descriptor, session->output + session->output_start, session->output_end - session->output_start, MSG_NOSIGNAL);
+        if (count < 0)
+          {
+            if (errno == EINTR)
+              continue;
+            return EXIT_FAILURE;
+          }
+        session->output_start += (size_t) count;
+      }
+    session->output_start = 0;
+    session->output_end = 0;
+    return EXIT_SUCCESS;
+  }
+
+/* Each call does one thing: sends, runs one command-line or reads */
+static int serve_session(struct work_item * work_item)
+  {
+    ssize_t count;
+    struct top * ctx;
+    char * line;
+    size_t length;
+    char * newline;
+    int rv;
+    struct session * session;
+
+    session = type_with_member_at_ptr(struct session, work_item, work_item);
+    ctx = session->server->ctx;
+
+    if (session->output_start < session->output_end)
+      {
+        if (send_output(session) != EXIT_SUCCESS)
+          {
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && !*(ctx->shutdown_requested))
+              {
+                (void) ctx->schedule_ready(live_module, work_item, session->descriptor, apivalue_work_ready_writable);
+                return EXIT_SUCCESS;
+              }
+            close_session(ctx, session);
+            return EXIT_FAILURE;
+          }
+      }
+    if (*(ctx->shutdown_requested) || session->stopping)
+      {
+        close_session(ctx, session);
+        return EXIT_SUCCESS;
+      }
+
+    line = session->input + session->input_start;
+    length = session->input_end - session->input_start;
+    newline = length > 0 ? memchr(line, '\n', length) : NULL;
+    if (newline != NULL)
+      {
+        length = (size_t) (newline - line);
+        session->input_start += length + 1;
+        rv = ctx->api_command->reply(ctx->api_command, line, length, ctx->api_stdlib, &session->output, &session->output_capacity, &session->output_end);
+        if (rv != EXIT_SUCCESS)
+          {
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory for the output of session #%u, so it has been closed\n", session->number);
+            close_session(ctx, session);
+            return EXIT_FAILURE;
+          }
+        (void) ctx->schedule_last(live_module, work_item, ctx->work_list);
+        return EXIT_SUCCESS;
+      }
+    if (session->at_end)
+      {
+        close_session(ctx, session);
+        return EXIT_SUCCESS;
+      }
+
+    /* Keep the unfinished line at the front, and read more after it */
+    if (length >= session_line_limit || ctx->api_stdio->grow_buffer(ctx->api_stdio, ctx->api_stdlib, &session->input, &session->input_capacity, session->input_start + length + session_buffer_size) != EXIT_SUCCESS)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Command-line from session #%u is too long, so the session has been closed\n", session->number);
+        close_session(ctx, session);
+        return EXIT_FAILURE;
+      }
+    memmove(session->input, session->input + session->input_start, length);
+    session->input_start = 0;
+    session->input_end = length;
+    count = recv(session->descriptor, session->input + length, session->input_capacity - length, 0);
+    if (count < 0)
+      {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+          {
+            (void) ctx->schedule_ready(live_module, work_item, session->descriptor, apivalue_work_ready_readable);
+            return EXIT_SUCCESS;
+          }
+        close_session(ctx, session);
+        return EXIT_FAILURE;
+      }
+    if (count == 0)
+      session->at_end = 1;
+    session->input_end += (size_t) count;
+    (void) ctx->schedule_last(live_module, work_item, ctx->work_list);
+    return EXIT_SUCCESS;
+  }
+
+static int set_nonblocking(int descriptor)
+  {
+    int flags;
+
+    flags = fcntl(descriptor, F_GETFL);
+    if (flags < 0 || fcntl(descriptor, F_SETFL, flags | O_NONBLOCK) < 0)
+      return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+  }
+
+static int start_server(struct top * ctx, struct server * server, const char * path)
+  {
+    struct sockaddr_un address;
+    int descriptor;
+    size_t length;
+
+    length = strlen(path);
+    if (length >= sizeof address.sun_path)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Socket path is longer than %lu characters\n", (unsigned long int) sizeof address.sun_path - 1);
+        return EXIT_FAILURE;
+      }
+    server->path = ctx->api_stdlib->malloc(ctx->api_stdlib, length + 1);
+    if (server->path == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while starting the server\n");
+        return EXIT_FAILURE;
+      }
+    memcpy(server->path, path, length + 1);
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path, length + 1);
+
+    descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (descriptor < 0)
+      goto err_socket;
+    if (set_nonblocking(descriptor) != EXIT_SUCCESS)
+      goto err_bind;
+    if (bind(descriptor, (struct sockaddr *) &address, sizeof address) < 0)
+      goto err_bind;
+    if (listen(descriptor, SOMAXCONN) < 0)
+      goto err_listen;
+    server->descriptor = descriptor;
+    (void) ctx->api_list->initialize_list_item(ctx->api_list, &server->work_item.list_item);
+    server->work_item.work = &accept_session;
+    (void) ctx->schedule_ready(live_module, &server->work_item, descriptor, apivalue_work_ready_readable);
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "Serving at '%s'\n", server->path);
+    return EXIT_SUCCESS;
+
+    err_listen:
+    (void) unlink(server->path);
+    err_bind:
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unable to serve at '%s', with error '%d' and message '%s'\n", path, errno, strerror(errno));
+    (void) close(descriptor);
+    goto err_path;
+
+    err_socket:
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unable to make a socket, with error '%d' and message '%s'\n", errno, strerror(errno));
+
+    err_path:
+    ctx->api_stdlib->free(ctx->api_stdlib, server->path);
+    server->path = NULL;
+    return EXIT_FAILURE;
+  }
+
+/* Sessions finish sending what they have, then close */
+static void stop_server(struct top * ctx, struct server * server)
+  {
+    struct list_item * list_item;
+    struct session * session;
+
+    if (server->descriptor < 0)
+      return;
+    if (server->work_item.list_item.next != NULL)
+      (void) ctx->api_list->remove_list_item(ctx->api_list, &server->work_item.list_item);
+    (void) close(server->descriptor);
+    (void) unlink(server->path);
+    ctx->api_stdlib->free(ctx->api_stdlib, server->path);
+    server->path = NULL;
+    server->descriptor = -1;
+    for (list_item = server->sessions.head.next; list_item != &server->sessions.head; list_item = list_item->next)
+      {
+        session = type_with_member_at_ptr(struct session, list_item, list_item);
+        session->stopping = 1;
+        /* A waiting session is woken, and a running one will notice */
+        if (session->work_item.list_item.next != NULL)
+          {
+            (void) ctx->api_list->remove_list_item(ctx->api_list, &session->work_item.list_item);
+            (void) ctx->schedule_last(live_module, &session->work_item, ctx->work_list);
+          }
+      }
+  }
+
+static int module_event(enum apivalue_module_event_type type, void * event_data)
+  {
+    struct cmd_server * command;
+    struct top * ctx;
+    struct list_item * list_item;
+    int rv;
+    struct server * server;
+    struct usage
+      {
+        struct cmd_server command;
+        struct server server;
+      }
+      * usage;
+
+    switch (type)
+      {
+        case apivalue_module_event_type_loaded:
+        if (live_module != NULL)
+          return EXIT_FAILURE;
+        live_module = event_data;
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_thread_started:
+        ctx = event_data;
+        usage = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *usage);
+        if (usage == NULL)
+          {
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'server' command", NULL, 0);
+            return EXIT_FAILURE;
+          }
+        command = &usage->command;
+        server = &usage->server;
+        live_module->module.v1.module_pointers[0] = command;
+        server->ctx = ctx;
+        server->descriptor = -1;
+        server->path = NULL;
+        ctx->api_list->initialize_list(ctx->api_list, &server->sessions);
+        server->next_number = 1;
+        command->command = command_server;
+        command->command.live_module = live_module;
+        command->ctx = ctx;
+        command->server = server;
+        (void) ctx->api_list->initialize_list_item(ctx->api_list, &command->command.list_item);
+        rv = ctx->api_command->add(ctx->api_command, &command->command);
+        if (rv != EXIT_SUCCESS)
+          {
+            ctx->log(live_module, apivalue_log_level_error, "Unable to register the 'server' command", NULL, 0);
+            ctx->api_stdlib->free(ctx->api_stdlib, usage);
+            live_module->module.v1.module_pointers[0] = NULL;
+          }
+        return rv;
+
+        case apivalue_module_event_type_thread_stop_requested:
+        case apivalue_module_event_type_thread_stopped:
+        case apivalue_module_event_type_unload_requested:
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_unload:
+        /* Assume success until proven otherwise */
+        rv = EXIT_SUCCESS;
+        command = live_module->module.v1.module_pointers[0];
+        if (command != NULL)
+          {
+            ctx = command->ctx;
+            server = command->server;
+            stop_server(ctx, server);
+            while ((list_item = server->sessions.head.next) != &server->sessions.head)
+              close_session(ctx, type_with_member_at_ptr(struct session, list_item, list_item));
+            rv = ctx->api_command->remove(ctx->api_command, &command->command);
+            if (rv == EXIT_SUCCESS)
+              ctx->api_stdlib->free(ctx->api_stdlib, command);
+          }
+        live_module = NULL;
+        return rv;
+      }
+    return EXIT_FAILURE;
+  }
+
+#endif /* CMDCTOY_POSIX */
@@ -0,0 +1,483 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+/* TODO: Support more than Linux */
+#if CMDCTOY_POSIX && defined(__linux__)
+/* For flock, ftruncate and mkfifo */
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "builtins.h"
+#include "command.h"
+#include "shmchan.h"
+#include "toy.h"
+#include "toydef.h"
+#include "toyio.h"
+#include "toylib.h"
+#include "list.h"
+#include "module.h"
+
+struct channel_server;
+struct cmd_shmchan;
+
+enum
+  {
+    /* The client's command-line can't be longer than this */
+    channel_line_limit = 1048576,
+    channel_buffer_size = 4096,
+    /* Scheduler turns to keep checking an empty ring, or a full one, before sleeping */
+    channel_idle_turns = 1024
+  };
+
+/*
+ * Serves one client at a time.  What's been taken from the requests ring,
+ * but not yet run, is from the start of 'input' to 'input_end' and what's
+ * waiting for room in the replies ring is from 'output_start' to 'output_end'
+ */
+struct channel_server
+  {
+    struct work_item work_item;
+    struct top * ctx;
+    /* NULL when not serving */
+    struct shmchan * channel;
+    char * path;
+    char * bell_path;
+    /* The channel's file, whose lock shows whether a client is attached */
+    int descriptor;
+    /* The server wakes upon reading from the bell, and also holds it open for writing, so it never hangs up */
+    int bell;
+    int bell_writer;
+    char * input;
+    size_t input_capacity;
+    size_t input_end;
+    char * output;
+    size_t output_capacity;
+    size_t output_start;
+    size_t output_end;
+    /* Since something was last read from, or written to, the client */
+    unsigned int idle_turns;
+  };
+
+struct cmd_shmchan
+  {
+    struct command command;
+    struct top * ctx;
+    struct channel_server * server;
+  };
+
+static int client_attached(struct channel_server *);
+static apifunction_command cmd_shmchan;
+static func_module_event module_event;
+static func_work serve_channel;
+static int sleep_or_spin(struct top *, struct channel_server *);
+static int start_channel(struct top *, struct channel_server *, const char *);
+static void stop_channel(struct top *, struct channel_server *);
+
+static struct command command_shmchan;
+static struct live_module * live_module;
+
+#if BUILTIN_CMD_SHMCHAN
+union module builtin_module_cmd_shmchan =
+#else
+union module module =
+#endif
+  {
+    {
+      {
+        module_signature,
+        "2024120200",
+        apivalue_module_api_version
+      },
+      &module_event,
+      {
+        NULL,
+        NULL,
+        NULL,
+        NULL
+      },
+      "cmd_shmchan"
+    }
+  };
+
+static struct command command_shmchan =
+  {
+    NULL,
+    "shmchan",
+    &cmd_shmchan,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+/* The client's lock is released by the system, too, if it exits without closing */
+static int client_attached(struct channel_server * server)
+  {
+    if (flock(server->descriptor, LOCK_EX | LOCK_NB) != 0)
+      return 1;
+    (void) flock(server->descriptor, LOCK_UN);
+    return 0;
+  }
+
+static int cmd_shmchan(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_shmchan * cmd;
+    struct top * ctx;
+    struct channel_server * server;
+    static const char usage[] =
+      "Usage:\n"
+      "  shmchan             Show where the channel is\n"
+      "  shmchan start PATH  Make a shared-memory channel at PATH, for a client\n"
+      "  shmchan stop        Remove the channel\n"
+      "Notes:\n"
+      "  Clients use shmchan.h and shmchan.c.  Replies are as for 'server'.\n"
+      ;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_shmchan, command, command);
+    ctx = cmd->ctx;
+    server = cmd->server;
+
+    if (argc == 1)
+      {
+        if (server->channel == NULL)
+          (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "Not serving\n");
+          else
+          (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "Serving at '%s'\n", server->path);
+        return EXIT_SUCCESS;
+      }
+    if (argc == 3 && strcmp(argv[1], "start") == 0)
+      {
+        if (server->channel != NULL)
+          {
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Already serving at '%s'\n", server->path);
+            return EXIT_FAILURE;
+          }
+        return start_channel(ctx, server, argv[2]);
+      }
+    if (argc == 2 && strcmp(argv[1], "stop") == 0)
+      {
+        if (server->channel == NULL)
+          {
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Not serving\n");
+            return EXIT_FAILURE;
+          }
+        stop_channel(ctx, server);
+        return EXIT_SUCCESS;
+      }
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "%s", usage);
+    return EXIT_FAILURE;
+  }
+
+/* Each call does one thing: replies, runs one command-line, takes requests or sleeps */
+static int serve_channel(struct work_item * work_item)
+  {
+    struct shmchan * channel;
+    struct top * ctx;
+    size_t count;
+    size_t length;
+    char * newline;
+    int rv;
+    struct channel_server * server;
+
+    server = type_with_member_at_ptr(struct channel_server, work_item, work_item);
+    ctx = server->ctx;
+    channel = server->channel;
+
+    if (*(ctx->shutdown_requested))
+      {
+        stop_channel(ctx, server);
+        return EXIT_SUCCESS;
+      }
+    /* Awake */
+    channel->requests.consumer_waiting = 0;
+    channel->replies.producer_waiting = 0;
+
+    if (shmchan_accept(channel))
+      {
+        server->input_end = 0;
+        server->output_start = 0;
+        server->output_end = 0;
+      }
+
+    if (server->output_start < server->output_end)
+      {
+        count = shmchan_write(channel, &channel->replies, server->output + server->output_start, server->output_end - server->output_start);
+        server->output_start += count;
+        if (server->output_start == server->output_end)
+          {
+            server->output_start = 0;
+            server->output_end = 0;
+          }
+        if (count > 0)
+          {
+            server->idle_turns = 0;
+            (void) ctx->schedule_last(live_module, work_item, ctx->work_list);
+            return EXIT_SUCCESS;
+          }
+        /* A full ring means the client is behind, or gone, in which case what's left is for nobody */
+        if (!client_attached(server))
+          {
+            server->output_start = 0;
+            server->output_end = 0;
+            (void) ctx->schedule_last(live_module, work_item, ctx->work_list);
+            return EXIT_SUCCESS;
+          }
+        return sleep_or_spin(ctx, server);
+      }
+
+    newline = server->input_end > 0 ? memchr(server->input, '\n', server->input_end) : NULL;
+    if (newline != NULL)
+      {
+        length = (size_t) (newline - server->input);
+        rv = ctx->api_command->reply(ctx->api_command, server->input, length, ctx->api_stdlib, &server->output, &server->output_capacity, &server->output_end);
+        /* The command might have stopped the channel */
+        if (server->channel == NULL)
+          return rv;
+        server->input_end -= length + 1;
+        memmove(server->input, newline + 1, server->input_end);
+        if (rv != EXIT_SUCCESS)
+          {
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory for the output of a shared-memory command, so the channel has been stopped\n");
+            stop_channel(ctx, server);
+            return EXIT_FAILURE;
+          }
+        (void) ctx->schedule_last(live_module, work_item, ctx->work_list);
+        return EXIT_SUCCESS;
+      }
+
+    if (server->input_end >= channel_line_limit || ctx->api_stdio->grow_buffer(ctx->api_stdio, ctx->api_stdlib, &server->input, &server->input_capacity, server->input_end + channel_buffer_size) != EXIT_SUCCESS)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Shared-memory command-line is too long, so the channel has been stopped\n");
+        stop_channel(ctx, server);
+        return EXIT_FAILURE;
+      }
+    count = shmchan_read(channel, &channel->requests, server->input + server->input_end, server->input_capacity - server->input_end);
+    if (count > 0)
+      {
+        server->input_end += count;
+        server->idle_turns = 0;
+        (void) ctx->schedule_last(live_module, work_item, ctx->work_list);
+        return EXIT_SUCCESS;
+      }
+
+    return sleep_or_spin(ctx, server);
+  }
+
+/*
+ * When there's nothing to read, or no room to reply.  A busy client soon
+ * sends, or reads, again, so keep checking for a while, without a system
+ * call on either side.  Other work still gets its turns.  After that, empty
+ * the bell and wait for it
+ */
+static int sleep_or_spin(struct top * ctx, struct channel_server * server)
+  {
+    char bell[64];
+    struct shmchan * channel;
+    int sleep;
+
+    channel = server->channel;
+    if (++server->idle_turns < channel_idle_turns && shmchan_should_spin())
+      {
+        (void) ctx->schedule_last(live_module, &server->work_item, ctx->work_list);
+        return EXIT_SUCCESS;
+      }
+    server->idle_turns = 0;
+
+    while (read(server->bell, bell, sizeof bell) > 0)
+      ;
+    if (server->output_start < server->output_end)
+      sleep = shmchan_ready_to_sleep_for_room(channel, &channel->replies);
+      else
+      sleep = shmchan_ready_to_sleep(channel, &channel->requests);
+    if (sleep)
+      (void) ctx->schedule_ready(live_module, &server->work_item, server->bell, apivalue_work_ready_readable);
+      else
+      (void) ctx->schedule_last(live_module, &server->work_item, ctx->work_list);
+    return EXIT_SUCCESS;
+  }
+
+static int start_channel(struct top * ctx, struct channel_server * server, const char * path)
+  {
+    int descriptor;
+    const char * failed_path;
+    size_t length;
+    void * mapping;
+
+    length = strlen(path);
+    server->path = ctx->api_stdlib->malloc(ctx->api_stdlib, length + 1 + length + sizeof ".bell");
+    if (server->path == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while starting the channel\n");
+        return EXIT_FAILURE;
+      }
+    memcpy(server->path, path, length + 1);
+    server->bell_path = server->path + length + 1;
+    memcpy(server->bell_path, path, length);
+    memcpy(server->bell_path + length, ".bell", sizeof ".bell");
+
+    failed_path = path;
+    /* As with binding a socket, existing files are left alone, so only what's made here is removed */
+    descriptor = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (descriptor < 0)
+      goto err_open;
+    if (ftruncate(descriptor, (off_t) shmchan_size()) != 0)
+      goto err_map;
+    mapping = mmap(NULL, shmchan_size(), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    if (mapping == MAP_FAILED)
+      goto err_map;
+
+    failed_path = server->bell_path;
+    if (mkfifo(server->bell_path, 0600) != 0)
+      goto err_fifo;
+    server->bell = open(server->bell_path, O_RDONLY | O_NONBLOCK);
+    if (server->bell < 0)
+      goto err_bell;
+    server->bell_writer = open(server->bell_path, O_WRONLY | O_NONBLOCK);
+    if (server->bell_writer < 0)
+      goto err_bell_writer;
+
+    /* The file is zeroes, so only the sizes need to be set */
+    server->channel = mapping;
+    server->descriptor = descriptor;
+    server->channel->server_process = (long int) getpid();
+    server->channel->ring_size = shmchan_ring_size;
+    server->channel->signature = shmchan_signature;
+    server->input_end = 0;
+    server->output_start = 0;
+    server->output_end = 0;
+    server->idle_turns = 0;
+    (void) ctx->api_list->initialize_list_item(ctx->api_list, &server->work_item.list_item);
+    server->work_item.work = &serve_channel;
+    (void) ctx->schedule_last(live_module, &server->work_item, ctx->work_list);
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "Serving at '%s'\n", server->path);
+    return EXIT_SUCCESS;
+
+    err_bell_writer:
+    (void) close(server->bell);
+    err_bell:
+    (void) unlink(server->bell_path);
+    err_fifo:
+    (void) munmap(mapping, shmchan_size());
+    err_map:
+    (void) close(descriptor);
+    (void) unlink(path);
+    err_open:
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unable to make a channel at '%s', with error '%d' and message '%s'\n", failed_path, errno, strerror(errno));
+    ctx->api_stdlib->free(ctx->api_stdlib, server->path);
+    server->path = NULL;
+    return EXIT_FAILURE;
+  }
+
+static void stop_channel(struct top * ctx, struct channel_server * server)
+  {
+    if (server->channel == NULL)
+      return;
+    if (server->work_item.list_item.next != NULL)
+      (void) ctx->api_list->remove_list_item(ctx->api_list, &server->work_item.list_item);
+    shmchan_stop(server->channel);
+    (void) munmap((void *) server->channel, shmchan_size());
+    server->channel = NULL;
+    (void) close(server->descriptor);
+    (void) close(server->bell);
+    (void) close(server->bell_writer);
+    (void) unlink(server->bell_path);
+    (void) unlink(server->path);
+    ctx->api_stdlib->free(ctx->api_stdlib, server->path);
+    server->path = NULL;
+    server->bell_path = NULL;
+  }
+
+static int module_event(enum apivalue_module_event_type type, void * event_data)
+  {
+    struct cmd_shmchan * command;
+    struct top * ctx;
+    int rv;
+    struct channel_server * server;
+    struct usage
+      {
+        struct cmd_shmchan command;
+        struct channel_server server;
+      }
+      * usage;
+
+    switch (type)
+      {
+        case apivalue_module_event_type_loaded:
+        if (live_module != NULL)
+          return EXIT_FAILURE;
+        live_module = event_data;
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_thread_started:
+        ctx = event_data;
+        usage = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *usage);
+        if (usage == NULL)
+          {
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'shmchan' command", NULL, 0);
+            return EXIT_FAILURE;
+          }
+        command = &usage->command;
+        server = &usage->server;
+        live_module->module.v1.module_pointers[0] = command;
+        server->ctx = ctx;
+        server->channel = NULL;
+        server->path = NULL;
+        server->bell_path = NULL;
+        server->input = NULL;
+        server->input_capacity = 0;
+        server->output = NULL;
+        server->output_capacity = 0;
+        command->command = command_shmchan;
+        command->command.live_module = live_module;
+        command->ctx = ctx;
+        command->server = server;
+        (void) ctx->api_list->initialize_list_item(ctx->api_list, &command->command.list_item);
+        rv = ctx->api_command->add(ctx->api_command, &command->command);
+        if (rv != EXIT_SUCCESS)
+          {
+            ctx->log(live_module, apivalue_log_level_error, "Unable to register the 'shmchan' command", NULL, 0);
+            ctx->api_stdlib->free(ctx->api_stdlib, usage);
+            live_module->module.v1.module_pointers[0] = NULL;
+          }
+        return rv;
+
+        case apivalue_module_event_type_thread_stop_requested:
+        case apivalue_module_event_type_thread_stopped:
+        case apivalue_module_event_type_unload_requested:
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_unload:
+        /* Assume success until proven otherwise */
+        rv = EXIT_SUCCESS;
+        command = live_module->module.v1.module_pointers[0];
+        if (command != NULL)
+          {
+            ctx = command->ctx;
+            server = command->server;
+            stop_channel(ctx, server);
+            ctx->api_stdlib->free(ctx->api_stdlib, server->input);
+            ctx->api_stdlib->free(ctx->api_stdlib, server->output);
+            rv = ctx->api_command->remove(ctx->api_command, &command->command);
+            if (rv == EXIT_SUCCESS)
+              ctx->api_stdlib->free(ctx->api_stdlib, command);
+          }
+        live_module = NULL;
+        return rv;
+      }
+    return EXIT_FAILURE;
+  }
+
+#endif /* CMDCTOY_POSIX && defined(__linux__) */
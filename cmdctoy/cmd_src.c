@@ -0,0 +1,463 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+#if CMDCTOY_POSIX
+/* For posix_madvise */
+#define _POSIX_C_SOURCE 200112L
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif /* CMDCTOY_POSIX */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "builtins.h"
+#include "command.h"
+#include "toy.h"
+#include "toydef.h"
+#include "toyio.h"
+#include "toylib.h"
+#include "list.h"
+#include "module.h"
+
+struct cmd_source;
+struct source_run;
+
+enum
+  {
+    /* Lines run before yielding to other work */
+    source_batch_lines = 1024,
+    /* How deeply scripts may source other scripts */
+    source_depth_limit = 16,
+    source_zero = 0
+  };
+
+enum source_option
+  {
+    /* The program's exit status is the script's, and the program ends with the script */
+    source_option_session = 1,
+    /* The commands are given instead of a file name, and can be separated by ';', too */
+    source_option_text = 2,
+    source_options_zero = 0
+  };
+
+struct cmd_source
+  {
+    struct command command;
+    struct top * ctx;
+    /* The innermost script being run, if any */
+    struct source_run * active;
+  };
+
+struct source_run
+  {
+    struct work_item work_item;
+    struct cmd_source * cmd;
+    /* The script that sourced this one, which resumes afterwards */
+    struct source_run * parent;
+    const char * text;
+    size_t size;
+    size_t position;
+    unsigned long int line;
+    unsigned int depth;
+    int status;
+    int options;
+  };
+
+static apifunction_command cmd_source;
+static int finish_run(struct source_run *);
+static int map_file(struct top *, const char *, const char **, size_t *);
+static func_module_event module_event;
+static func_work run_source;
+static int start_run(struct cmd_source *, const char *, int);
+static void unmap_file(struct top *, const char *, size_t);
+
+static struct command command_source;
+static struct live_module * live_module;
+
+#if BUILTIN_CMD_SOURCE
+union module builtin_module_cmd_source =
+#else
+union module module =
+#endif
+  {
+    {
+      {
+        module_signature,
+        "2024120200",
+        apivalue_module_api_version
+      },
+      &module_event,
+      {
+        NULL,
+        NULL,
+        NULL,
+        NULL
+      },
+      "cmd_source"
+    }
+  };
+
+static struct command command_source =
+  {
+    NULL,
+    "source",
+    &cmd_source,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static int cmd_source(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_source * cmd;
+    struct top * ctx;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_source, command, command);
+    ctx = cmd->ctx;
+
+    if (argc != 2)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage: %s FILE\n", argv[0]);
+        return EXIT_FAILURE;
+      }
+    if (cmd->active != NULL && cmd->active->depth >= source_depth_limit)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Scripts are nested more than %d deep, so '%s' has not been run\n", (int) source_depth_limit, argv[1]);
+        return EXIT_FAILURE;
+      }
+    return start_run(cmd, argv[1], 0);
+  }
+
+static int finish_run(struct source_run * run)
+  {
+    struct cmd_source * cmd;
+    struct top * ctx;
+    struct source_run * parent;
+    int status;
+
+    cmd = run->cmd;
+    ctx = cmd->ctx;
+    parent = run->parent;
+    status = run->status;
+    cmd->active = parent;
+    --*(ctx->input_holds);
+    if (!(run->options & source_option_text))
+      unmap_file(ctx, run->text, run->size);
+    if (run->work_item.list_item.next != NULL)
+      (void) ctx->api_list->remove_list_item(ctx->api_list, &run->work_item.list_item);
+    if (parent != NULL)
+      {
+        /* The outer script carries on, now */
+        parent->status = status;
+        (void) ctx->schedule_last(live_module, &parent->work_item, ctx->work_list);
+      }
+      else if (run->options & source_option_session)
+      {
+        *(ctx->exit_status) = status;
+        ctx->request_shutdown(ctx);
+      }
+    ctx->api_stdlib->free(ctx->api_stdlib, run);
+    return status;
+  }
+
+/* The storage is read-only and isn't terminated; release it with unmap_file */
+static int map_file(struct top * ctx, const char * name, const char ** text, size_t * size)
+  {
+#if CMDCTOY_POSIX
+    int fd;
+    void * mapping;
+    int new_errno;
+    int old_errno;
+    struct stat st;
+
+    old_errno = errno;
+    errno = 0;
+    fd = open(name, O_RDONLY);
+    if (fd == -1)
+      goto err_open;
+    if (fstat(fd, &st) != 0)
+      goto err_fstat;
+    if (st.st_size < 0 || (unsigned long int) st.st_size > (size_t) -1)
+      {
+        errno = EFBIG;
+        goto err_fstat;
+      }
+    *size = (size_t) st.st_size;
+    /* Zero-length mappings aren't allowed */
+    if (*size == 0)
+      {
+        (void) close(fd);
+        errno = old_errno;
+        *text = "";
+        return EXIT_SUCCESS;
+      }
+    mapping = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED)
+      goto err_fstat;
+    /* Only a hint, so failure doesn't matter */
+    (void) posix_madvise(mapping, *size, POSIX_MADV_SEQUENTIAL);
+    /* The mapping stays valid without the descriptor */
+    (void) close(fd);
+    errno = old_errno;
+    *text = mapping;
+    return EXIT_SUCCESS;
+
+    err_fstat:
+    new_errno = errno;
+    (void) close(fd);
+    errno = new_errno;
+    err_open:
+
+    new_errno = errno;
+    errno = old_errno;
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unable to map '%s', with POSIX errno '%d' and strerror message '%s'\n", name, new_errno, strerror(new_errno));
+    return EXIT_FAILURE;
+#else
+    char * buffer;
+    size_t capacity;
+    size_t count;
+    char * grown;
+    FILE * stream;
+
+    stream = fopen(name, "rb");
+    if (stream == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unable to open '%s'\n", name);
+        return EXIT_FAILURE;
+      }
+    buffer = NULL;
+    capacity = 0;
+    *size = 0;
+    do
+      {
+        if (*size == capacity)
+          {
+            if (capacity > ((size_t) -1) / 2 - BUFSIZ)
+              goto err_buffer;
+            capacity = capacity * 2 + BUFSIZ;
+            grown = ctx->api_stdlib->realloc(ctx->api_stdlib, buffer, capacity);
+            if (grown == NULL)
+              goto err_buffer;
+            buffer = grown;
+          }
+        count = fread(buffer + *size, 1, capacity - *size, stream);
+        *size += count;
+      }
+    while (count > 0);
+    if (ferror(stream))
+      goto err_buffer;
+    (void) fclose(stream);
+    *text = buffer;
+    return EXIT_SUCCESS;
+
+    err_buffer:
+    ctx->api_stdlib->free(ctx->api_stdlib, buffer);
+    (void) fclose(stream);
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unable to read '%s'\n", name);
+    return EXIT_FAILURE;
+#endif /* CMDCTOY_POSIX */
+  }
+
+static int module_event(enum apivalue_module_event_type type, void * event_data)
+  {
+    struct cmd_source * command;
+    struct top * ctx;
+    struct source_run * parent;
+    int rv;
+
+    switch (type)
+      {
+        case apivalue_module_event_type_loaded:
+        if (live_module != NULL)
+          return EXIT_FAILURE;
+        live_module = event_data;
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_thread_started:
+        ctx = event_data;
+        command = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *command);
+        if (command == NULL)
+          {
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'source' command", NULL, 0);
+            return EXIT_FAILURE;
+          }
+        live_module->module.v1.module_pointers[0] = command;
+        command->command = command_source;
+        command->command.live_module = live_module;
+        command->ctx = ctx;
+        command->active = NULL;
+        (void) ctx->api_list->initialize_list_item(ctx->api_list, &command->command.list_item);
+        rv = ctx->api_command->add(ctx->api_command, &command->command);
+        if (rv != EXIT_SUCCESS)
+          {
+            ctx->log(live_module, apivalue_log_level_error, "Unable to register the 'source' command", NULL, 0);
+            return rv;
+          }
+        /* Commands or a script given at start-up are the whole session */
+        if (ctx->commands != NULL)
+          return start_run(command, ctx->commands, source_option_session | source_option_text);
+        if (ctx->script != NULL)
+          return start_run(command, ctx->script, source_option_session);
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_thread_stop_requested:
+        case apivalue_module_event_type_thread_stopped:
+        case apivalue_module_event_type_unload_requested:
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_unload:
+        /* Assume success until proven otherwise */
+        rv = EXIT_SUCCESS;
+        command = live_module->module.v1.module_pointers[0];
+        if (command != NULL)
+          {
+            ctx = command->ctx;
+            /* Abandon any scripts, innermost first, without resuming the outer ones */
+            while (command->active != NULL)
+              {
+                parent = command->active->parent;
+                command->active->parent = NULL;
+                command->active->options &= ~source_option_session;
+                (void) finish_run(command->active);
+                command->active = parent;
+              }
+            rv = ctx->api_command->remove(ctx->api_command, &command->command);
+            if (rv == EXIT_SUCCESS)
+              ctx->api_stdlib->free(ctx->api_stdlib, command);
+          }
+        live_module = NULL;
+        return rv;
+      }
+    return EXIT_FAILURE;
+  }
+
+static int run_source(struct work_item * work_item)
+  {
+    struct cmd_source * cmd;
+    struct top * ctx;
+    size_t i;
+    const char * end;
+    size_t length;
+    unsigned int lines;
+    struct source_run * run;
+    size_t separator;
+    const char * start;
+
+    run = type_with_member_at_ptr(struct source_run, work_item, work_item);
+    cmd = run->cmd;
+    ctx = cmd->ctx;
+
+    for (lines = 0; lines < source_batch_lines; ++lines)
+      {
+        if (*(ctx->shutdown_requested) || run->position == run->size)
+          return finish_run(run);
+
+        start = run->text + run->position;
+        end = memchr(start, '\n', run->size - run->position);
+        length = end != NULL ? (size_t) (end - start) : run->size - run->position;
+        /* A ';' that isn't quoted nor escaped ends a command, too */
+        if (run->options & source_option_text)
+          {
+            (void) ctx->api_command->scan(ctx->api_command, start, length, ";", &separator);
+            if (separator < length)
+              {
+                end = start + separator;
+                length = separator;
+              }
+          }
+        run->position += length + (end != NULL);
+        ++run->line;
+
+        /* Permit this kind of line-ending */
+        if (length > 0 && start[length - 1] == '\r')
+          --length;
+        /* Skip blank lines and comments */
+        for (i = 0; i < length && (start[i] == ' ' || start[i] == '\t'); ++i)
+          ;
+        if (i == length || start[i] == '#')
+          continue;
+
+        run->status = ctx->api_command->line(ctx->api_command, start, length);
+
+        /* A nested script takes over until it's done, then reschedules this one */
+        if (cmd->active != run)
+          return run->status;
+      }
+
+    /* Yield to other work */
+    (void) ctx->schedule_last(live_module, work_item, ctx->work_list);
+    return EXIT_SUCCESS;
+  }
+
+static int start_run(struct cmd_source * cmd, const char * name, int options)
+  {
+    struct top * ctx;
+    int rv;
+    struct source_run * run;
+
+    ctx = cmd->ctx;
+    run = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *run);
+    if (run == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while starting a script\n");
+        return EXIT_FAILURE;
+      }
+    rv = EXIT_SUCCESS;
+    if (options & source_option_text)
+      {
+        run->text = name;
+        run->size = strlen(name);
+      }
+      else
+      {
+        rv = map_file(ctx, name, &run->text, &run->size);
+      }
+    if (rv != EXIT_SUCCESS)
+      {
+        if (!(options & source_option_session))
+          {
+            ctx->api_stdlib->free(ctx->api_stdlib, run);
+            return rv;
+          }
+        /* Shutdown can't be requested during start-up, so the session ends by way of an empty run */
+        options |= source_option_text;
+        run->text = "";
+        run->size = 0;
+      }
+    run->cmd = cmd;
+    run->parent = cmd->active;
+    run->position = 0;
+    run->line = 0;
+    run->depth = run->parent != NULL ? run->parent->depth + 1 : 0;
+    run->status = rv;
+    run->options = options;
+    (void) ctx->api_list->initialize_list_item(ctx->api_list, &run->work_item.list_item);
+    run->work_item.work = &run_source;
+    cmd->active = run;
+    /* User input waits until the script is done */
+    ++*(ctx->input_holds);
+    (void) ctx->schedule_last(live_module, &run->work_item, ctx->work_list);
+    return EXIT_SUCCESS;
+  }
+
+static void unmap_file(struct top * ctx, const char * text, size_t size)
+  {
+#if CMDCTOY_POSIX
+    (void) ctx;
+    if (size > 0)
+      (void) munmap((void *) text, size);
+#else
+    (void) size;
+    ctx->api_stdlib->free(ctx->api_stdlib, (void *) text);
+#endif /* CMDCTOY_POSIX */
+  }
@@ -0,0 +1,582 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+#if CMDCTOY_POSIX
+/* For clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+#include <sys/resource.h>
+#endif /* CMDCTOY_POSIX */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "arena.h"
+#include "builtins.h"
+#include "command.h"
+#include "toy.h"
+#include "toydef.h"
+#include "toyio.h"
+#include "toylib.h"
+#include "list.h"
+#include "module.h"
+
+struct cmd_stat;
+struct stat_entry;
+struct stat_sample;
+struct stat_table;
+
+struct cmd_stat
+  {
+    struct command command;
+    struct top * ctx;
+    struct stat_table * table;
+  };
+
+/* Totals for every command having a particular name */
+struct stat_entry
+  {
+    char * name;
+    size_t hash;
+    unsigned long int calls;
+    unsigned long int failures;
+    double wall;
+    double cpu;
+    unsigned long int allocations;
+    unsigned long int allocated_bytes;
+    unsigned long int output_bytes;
+  };
+
+struct stat_sample
+  {
+    double wall;
+    double cpu;
+    unsigned long int allocations;
+    unsigned long int allocated_bytes;
+    unsigned long int output_bytes;
+  };
+
+/* Open addressing, keyed by the hash that the command API gave each command */
+struct stat_table
+  {
+    size_t capacity;
+    size_t count;
+    struct stat_entry ** entries;
+    int enabled;
+  };
+
+static apifunction_command cmd_cmdstat;
+static apifunction_command cmd_memprof;
+static apifunction_command cmd_time;
+static int compare_entries(const void *, const void *);
+static int compare_sites(const void *, const void *);
+static void forget_entries(struct top *, struct stat_table *);
+static int measure(struct top *, struct command *, int, char **, struct stat_sample *);
+static func_module_event module_event;
+static apifunction_command profile_command;
+static void read_clocks(double *, double *);
+static int record(struct top *, struct stat_table *, struct command *, int, const struct stat_sample *);
+
+static struct command command_cmdstat;
+static struct command command_memprof;
+static struct command command_time;
+static struct live_module * live_module;
+
+#if BUILTIN_CMD_STAT
+union module builtin_module_cmd_stat =
+#else
+union module module =
+#endif
+  {
+    {
+      {
+        module_signature,
+        "2024120200",
+        apivalue_module_api_version
+      },
+      &module_event,
+      {
+        NULL,
+        NULL,
+        NULL,
+        NULL
+      },
+      "cmd_stat"
+    }
+  };
+
+static struct command command_cmdstat =
+  {
+    NULL,
+    "cmdstat",
+    &cmd_cmdstat,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static struct command command_memprof =
+  {
+    NULL,
+    "memprof",
+    &cmd_memprof,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static struct command command_time =
+  {
+    NULL,
+    "time",
+    &cmd_time,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static int cmd_cmdstat(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_stat * cmd;
+    struct top * ctx;
+    struct stat_entry * entry;
+    size_t i;
+    size_t j;
+    struct stat_entry ** sorted;
+    struct stat_table * table;
+
+    cmd = type_with_member_at_ptr(struct cmd_stat, command, command);
+    ctx = cmd->ctx;
+    table = cmd->table;
+
+    if (argc == 2 && strcmp(argv[1], "on") == 0)
+      {
+        table->enabled = 1;
+        api->profile = &profile_command;
+        return EXIT_SUCCESS;
+      }
+    if (argc == 2 && strcmp(argv[1], "off") == 0)
+      {
+        table->enabled = 0;
+        if (api->profile == &profile_command)
+          api->profile = NULL;
+        return EXIT_SUCCESS;
+      }
+    if (argc == 2 && strcmp(argv[1], "reset") == 0)
+      {
+        forget_entries(ctx, table);
+        return EXIT_SUCCESS;
+      }
+    if (argc != 1)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage: %s [on | off | reset]\n", argv[0]);
+        return EXIT_FAILURE;
+      }
+
+    if (table->count == 0)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "No commands have been measured%s\n", table->enabled ? "" : ".  See 'cmdstat on' and 'time'");
+        return EXIT_SUCCESS;
+      }
+    sorted = ctx->api_stdlib->malloc(ctx->api_stdlib, table->count * sizeof *sorted);
+    if (sorted == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while sorting command statistics\n");
+        return EXIT_FAILURE;
+      }
+    for (i = 0, j = 0; i < table->capacity; ++i)
+      {
+        if (table->entries[i] != NULL)
+          sorted[j++] = table->entries[i];
+      }
+    qsort(sorted, table->count, sizeof *sorted, &compare_entries);
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%-20s %10s %9s %12s %12s %10s %12s %12s\n", "command", "calls", "failures", "wall (s)", "cpu (s)", "allocs", "alloc bytes", "out bytes");
+    for (i = 0; i < table->count; ++i)
+      {
+        entry = sorted[i];
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%-20s %10lu %9lu %12.6f %12.6f %10lu %12lu %12lu\n", entry->name, entry->calls, entry->failures, entry->wall, entry->cpu, entry->allocations, entry->allocated_bytes, entry->output_bytes);
+      }
+    ctx->api_stdlib->free(ctx->api_stdlib, sorted);
+    return EXIT_SUCCESS;
+  }
+
+/*
+ * The large blocks that are mapped, then live memory by where it was
+ * allocated, most first, and how often each place has allocated
+ */
+static int cmd_memprof(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_stat * cmd;
+    size_t count;
+    struct top * ctx;
+    double elapsed;
+    size_t i;
+    size_t j;
+    const struct stdlib_map_counts * map_counts;
+    struct memory_profile * profile;
+    struct memory_site * site;
+    struct memory_site ** sorted;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_stat, command, command);
+    ctx = cmd->ctx;
+    profile = memory_profile();
+
+    if (argc > 2 || (argc == 2 && strcmp(argv[1], "reset") != 0))
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage: %s [reset]\n", argv[0]);
+        return EXIT_FAILURE;
+      }
+    if (argc == 1)
+      {
+        map_counts = stdlib_map_counts();
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "mapped: %lu blocks, %lu bytes (maps: %lu, unmaps: %lu, huge: %lu, advised: %lu)\n", map_counts->mappings, map_counts->mapped_bytes, map_counts->maps, map_counts->unmaps, map_counts->huge_maps, map_counts->advised_maps);
+      }
+    if (profile == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Allocations aren't being profiled.  Start the program with '--memprof'\n");
+        return argc == 1 ? EXIT_SUCCESS : EXIT_FAILURE;
+      }
+    if (argc == 2)
+      {
+        reset_memory_profile();
+        return EXIT_SUCCESS;
+      }
+
+    /* Allocating for the sorting could add a site, which is left out */
+    count = profile->count;
+    if (count == 0)
+      return EXIT_SUCCESS;
+    sorted = ctx->api_stdlib->malloc(ctx->api_stdlib, count * sizeof *sorted);
+    if (sorted == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while sorting the memory profile\n");
+        return EXIT_FAILURE;
+      }
+    for (i = 0, j = 0; i < memory_profile_sites && j < count; ++i)
+      {
+        if (profile->sites[i].name[0] != '\0')
+          sorted[j++] = profile->sites + i;
+      }
+    qsort(sorted, count, sizeof *sorted, &compare_sites);
+    /* Whole seconds, so a phase counts as lasting at least one */
+    elapsed = difftime(time(NULL), profile->since);
+    if (elapsed < 1)
+      elapsed = 1;
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%-20s %-18s %-8s %10s %12s %10s %12s\n", "module", "caller", "path", "objects", "bytes", "allocs", "allocs/s");
+    for (i = 0; i < count; ++i)
+      {
+        site = sorted[i];
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%-20s %-18p %08lx %10lu %12lu %10lu %12.1f\n", site->name, site->caller, site->hash & 0xFFFFFFFFUL, site->objects, site->bytes, site->allocations, (double) site->allocations / elapsed);
+      }
+    ctx->api_stdlib->free(ctx->api_stdlib, sorted);
+    return EXIT_SUCCESS;
+  }
+
+static int cmd_time(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_stat * cmd;
+    struct top * ctx;
+    int rv;
+    struct stat_sample sample;
+    struct command * timed;
+
+    cmd = type_with_member_at_ptr(struct cmd_stat, command, command);
+    ctx = cmd->ctx;
+
+    if (argc < 2)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage: %s COMMAND [ARGUMENT ...]\n", argv[0]);
+        return EXIT_FAILURE;
+      }
+    timed = api->find(api, argv[1]);
+    if (timed == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Awful command or file name\n");
+        return EXIT_FAILURE;
+      }
+    rv = measure(ctx, timed, argc - 1, argv + 1, &sample);
+    if (cmd->table->enabled)
+      (void) record(ctx, cmd->table, timed, rv, &sample);
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "real %.6fs  cpu %.6fs  allocations %lu (%lu bytes)  output %lu bytes\n", sample.wall, sample.cpu, sample.allocations, sample.allocated_bytes, sample.output_bytes);
+    return rv;
+  }
+
+/* Most wall-clock time first */
+static int compare_entries(const void * a, const void * b)
+  {
+    const struct stat_entry * entry_a;
+    const struct stat_entry * entry_b;
+
+    entry_a = *(struct stat_entry * const *) a;
+    entry_b = *(struct stat_entry * const *) b;
+    if (entry_a->wall != entry_b->wall)
+      return entry_a->wall < entry_b->wall ? 1 : -1;
+    return strcmp(entry_a->name, entry_b->name);
+  }
+
+/* Most live bytes first, then most allocations */
+static int compare_sites(const void * a, const void * b)
+  {
+    const struct memory_site * site_a;
+    const struct memory_site * site_b;
+
+    site_a = *(struct memory_site * const *) a;
+    site_b = *(struct memory_site * const *) b;
+    if (site_a->bytes != site_b->bytes)
+      return site_a->bytes < site_b->bytes ? 1 : -1;
+    if (site_a->allocations != site_b->allocations)
+      return site_a->allocations < site_b->allocations ? 1 : -1;
+    return strcmp(site_a->name, site_b->name);
+  }
+
+static void forget_entries(struct top * ctx, struct stat_table * table)
+  {
+    size_t i;
+
+    for (i = 0; i < table->capacity; ++i)
+      ctx->api_stdlib->free(ctx->api_stdlib, table->entries[i]);
+    ctx->api_stdlib->free(ctx->api_stdlib, table->entries);
+    table->entries = NULL;
+    table->capacity = 0;
+    table->count = 0;
+  }
+
+static int measure(struct top * ctx, struct command * command, int argc, char ** argv, struct stat_sample * sample)
+  {
+    unsigned long int allocated_bytes;
+    unsigned long int allocations;
+    double cpu;
+    unsigned long int output_bytes;
+    int rv;
+    struct api_stdlib * stdlib_api;
+    double wall;
+
+    /* Each module's arena allocates from the program's, so the program's counts them all */
+    stdlib_api = ctx->module_api->api_stdlib;
+    allocations = stdlib_api->allocations;
+    allocated_bytes = stdlib_api->allocated_bytes;
+    output_bytes = ctx->api_stdio->output_bytes;
+    read_clocks(&wall, &cpu);
+    rv = command->handler(ctx->api_command, command, argc, argv);
+    read_clocks(&sample->wall, &sample->cpu);
+    sample->wall -= wall;
+    sample->cpu -= cpu;
+    sample->allocations = stdlib_api->allocations - allocations;
+    sample->allocated_bytes = stdlib_api->allocated_bytes - allocated_bytes;
+    sample->output_bytes = ctx->api_stdio->output_bytes - output_bytes;
+    return rv;
+  }
+
+static int module_event(enum apivalue_module_event_type type, void * event_data)
+  {
+    struct cmd_stat (* commands)[3];
+    struct top * ctx;
+    struct log_field field;
+    size_t i;
+    size_t j;
+    int rv;
+    struct stat_table * table;
+    struct usage
+      {
+        struct cmd_stat commands[3];
+        struct stat_table table;
+      }
+      * usage;
+
+    switch (type)
+      {
+        case apivalue_module_event_type_loaded:
+        if (live_module != NULL)
+          return EXIT_FAILURE;
+        live_module = event_data;
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_thread_started:
+        ctx = event_data;
+        usage = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *usage);
+        if (usage == NULL)
+          {
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'cmdstat', 'memprof', 'time' commands", NULL, 0);
+            return EXIT_FAILURE;
+          }
+        commands = &usage->commands;
+        table = &usage->table;
+        live_module->module.v1.module_pointers[0] = commands;
+        table->capacity = 0;
+        table->count = 0;
+        table->entries = NULL;
+        table->enabled = 0;
+        (*commands)[0].command = command_cmdstat;
+        (*commands)[1].command = command_memprof;
+        (*commands)[2].command = command_time;
+        rv = EXIT_SUCCESS;
+        for (i = 0; i < countof(*commands); ++i)
+          {
+            (*commands)[i].ctx = ctx;
+            (*commands)[i].table = table;
+            (*commands)[i].command.live_module = live_module;
+            (void) ctx->api_list->initialize_list_item(ctx->api_list, &(*commands)[i].command.list_item);
+            rv = ctx->api_command->add(ctx->api_command, &(*commands)[i].command);
+            if (rv != EXIT_SUCCESS)
+              {
+                field.key = "command";
+                field.value = (*commands)[i].command.name;
+                ctx->log(live_module, apivalue_log_level_error, "Unable to register a command", &field, 1);
+                for (j = 0; j < i; ++j)
+                  (void) ctx->api_command->remove(ctx->api_command, &(*commands)[j].command);
+                ctx->api_stdlib->free(ctx->api_stdlib, commands);
+                live_module->module.v1.module_pointers[0] = NULL;
+                return rv;
+              }
+          }
+        return rv;
+
+        case apivalue_module_event_type_thread_stop_requested:
+        case apivalue_module_event_type_thread_stopped:
+        case apivalue_module_event_type_unload_requested:
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_unload:
+        /* Assume success until proven otherwise */
+        rv = EXIT_SUCCESS;
+        commands = live_module->module.v1.module_pointers[0];
+        if (commands != NULL)
+          {
+            ctx = (*commands)[0].ctx;
+            if (ctx->api_command->profile == &profile_command)
+              ctx->api_command->profile = NULL;
+            for (i = 0; i < countof(*commands); ++i)
+              {
+                rv = ctx->api_command->remove(ctx->api_command, &(*commands)[i].command);
+                if (rv != EXIT_SUCCESS)
+                  return rv;
+              }
+            forget_entries(ctx, (*commands)[0].table);
+            ctx->api_stdlib->free(ctx->api_stdlib, commands);
+          }
+        live_module = NULL;
+        return rv;
+      }
+    return EXIT_FAILURE;
+  }
+
+static int profile_command(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_stat (* commands)[3];
+    int rv;
+    struct stat_sample sample;
+
+    (void) api;
+
+    commands = live_module->module.v1.module_pointers[0];
+    rv = measure((*commands)[0].ctx, command, argc, argv, &sample);
+    (void) record((*commands)[0].ctx, (*commands)[0].table, command, rv, &sample);
+    return rv;
+  }
+
+/* In seconds */
+static void read_clocks(double * wall, double * cpu)
+  {
+#if CMDCTOY_POSIX
+    struct rusage usage;
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+      *wall = (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+      else
+      *wall = 0;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+      *cpu = (double) usage.ru_utime.tv_sec + (double) usage.ru_utime.tv_usec / 1e6 + (double) usage.ru_stime.tv_sec + (double) usage.ru_stime.tv_usec / 1e6;
+      else
+      *cpu = 0;
+#else
+    /* Only whole seconds, without something better than C89 */
+    *wall = (double) time(NULL);
+    *cpu = (double) clock() / CLOCKS_PER_SEC;
+#endif /* CMDCTOY_POSIX */
+  }
+
+static int record(struct top * ctx, struct stat_table * table, struct command * command, int rv, const struct stat_sample * sample)
+  {
+    size_t capacity;
+    struct stat_entry * entry;
+    struct stat_entry ** entries;
+    size_t i;
+    size_t j;
+    size_t length;
+
+    if (table->count + 1 > table->capacity / 4 * 3)
+      {
+        capacity = table->capacity == 0 ? 64 : table->capacity * 2;
+        if (capacity > (size_t) -1 / sizeof *entries)
+          return EXIT_FAILURE;
+        entries = ctx->api_stdlib->malloc(ctx->api_stdlib, capacity * sizeof *entries);
+        if (entries == NULL)
+          return EXIT_FAILURE;
+        for (i = 0; i < capacity; ++i)
+          entries[i] = NULL;
+        for (i = 0; i < table->capacity; ++i)
+          {
+            entry = table->entries[i];
+            if (entry == NULL)
+              continue;
+            for (j = entry->hash & (capacity - 1); entries[j] != NULL; j = (j + 1) & (capacity - 1))
+              ;
+            entries[j] = entry;
+          }
+        ctx->api_stdlib->free(ctx->api_stdlib, table->entries);
+        table->entries = entries;
+        table->capacity = capacity;
+      }
+
+    for (i = command->hash & (table->capacity - 1); (entry = table->entries[i]) != NULL; i = (i + 1) & (table->capacity - 1))
+      {
+        if (entry->hash == command->hash && strcmp(entry->name, command->name) == 0)
+          break;
+      }
+    if (entry == NULL)
+      {
+        /* The command might go away before its statistics, so its name is copied */
+        length = strlen(command->name);
+        entry = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *entry + length + 1);
+        if (entry == NULL)
+          return EXIT_FAILURE;
+        entry->name = (char *) (entry + 1);
+        memcpy(entry->name, command->name, length + 1);
+        entry->hash = command->hash;
+        entry->calls = 0;
+        entry->failures = 0;
+        entry->wall = 0;
+        entry->cpu = 0;
+        entry->allocations = 0;
+        entry->allocated_bytes = 0;
+        entry->output_bytes = 0;
+        table->entries[i] = entry;
+        ++table->count;
+      }
+    ++entry->calls;
+    if (rv != EXIT_SUCCESS)
+      ++entry->failures;
+    entry->wall += sample->wall;
+    entry->cpu += sample->cpu;
+    entry->allocations += sample->allocations;
+    entry->allocated_bytes += sample->allocated_bytes;
+    entry->output_bytes += sample->output_bytes;
+    return EXIT_SUCCESS;
+  }
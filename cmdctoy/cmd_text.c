@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "builtins.h"
+#include "command.h"
+#include "toy.h"
+#include "toydef.h"
+#include "toyio.h"
+#include "toylib.h"
+#include "list.h"
+#include "module.h"
+
+struct cmd_text;
+
+struct cmd_text
+  {
+    struct command command;
+    struct top * ctx;
+  };
+
+static apifunction_command cmd_count;
+static apifunction_command cmd_grep;
+static int contains(const char *, size_t, const char *, size_t);
+static func_module_event module_event;
+
+static struct command command_count;
+static struct command command_grep;
+static struct live_module * live_module;
+
+#if BUILTIN_CMD_TEXT
+union module builtin_module_cmd_text =
+#else
+union module module =
+#endif
+  {
+    {
+      {
+        module_signature,
+        "2024120200",
+        apivalue_module_api_version
+      },
+      &module_event,
+      {
+        NULL,
+        NULL,
+        NULL,
+        NULL
+      },
+      "cmd_text"
+    }
+  };
+
+static struct command command_count =
+  {
+    NULL,
+    "count",
+    &cmd_count,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static struct command command_grep =
+  {
+    NULL,
+    "grep",
+    &cmd_grep,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static int cmd_count(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_text * cmd;
+    struct top * ctx;
+    struct stdio_cursor cursor;
+    struct stdio_line line;
+    unsigned long int lines;
+    enum apivalue_stdio stdio_rv;
+
+    (void) argv;
+
+    cmd = type_with_member_at_ptr(struct cmd_text, command, command);
+    ctx = cmd->ctx;
+
+    if (argc != 1 || api->input == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage: COMMAND | count\n");
+        return EXIT_FAILURE;
+      }
+    lines = 0;
+    ctx->api_stdio->initialize_cursor(ctx->api_stdio, &cursor, api->input);
+    while ((stdio_rv = ctx->api_stdio->read_line(ctx->api_stdio, &cursor, &line)) == apivalue_stdio_success)
+      ++lines;
+    ctx->api_stdio->release_cursor(ctx->api_stdio, &cursor);
+    if (stdio_rv != apivalue_stdio_end_of_chain)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while counting lines\n");
+        return EXIT_FAILURE;
+      }
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%lu\n", lines);
+    return EXIT_SUCCESS;
+  }
+
+/* Matching lines are passed along without being copied, when they can be */
+static int cmd_grep(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_text * cmd;
+    struct top * ctx;
+    struct stdio_cursor cursor;
+    int invert;
+    struct stdio_line line;
+    int matched;
+    const char * pattern;
+    size_t pattern_length;
+    enum apivalue_stdio stdio_rv;
+
+    cmd = type_with_member_at_ptr(struct cmd_text, command, command);
+    ctx = cmd->ctx;
+
+    invert = argc == 3 && strcmp(argv[1], "-v") == 0;
+    if (argc != 2 + invert || api->input == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Usage: COMMAND | grep [-v] TEXT\n");
+        return EXIT_FAILURE;
+      }
+    pattern = argv[1 + invert];
+    pattern_length = strlen(pattern);
+    matched = 0;
+    ctx->api_stdio->initialize_cursor(ctx->api_stdio, &cursor, api->input);
+    while ((stdio_rv = ctx->api_stdio->read_line(ctx->api_stdio, &cursor, &line)) == apivalue_stdio_success)
+      {
+        if (contains(line.text, line.length, pattern, pattern_length) == invert)
+          continue;
+        matched = 1;
+        if (ctx->api_stdio->share(ctx->api_stdio, line.segment, line.text, line.length, stdout) != line.length)
+          {
+            stdio_rv = apivalue_stdio_error_out_of_memory;
+            break;
+          }
+      }
+    ctx->api_stdio->release_cursor(ctx->api_stdio, &cursor);
+    if (stdio_rv != apivalue_stdio_end_of_chain)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while matching lines\n");
+        return EXIT_FAILURE;
+      }
+    /* Like other greps, nothing matching is a failure */
+    return matched ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+static int contains(const char * text, size_t length, const char * pattern, size_t pattern_length)
+  {
+    const char * end;
+    const char * found;
+
+    if (pattern_length == 0)
+      return 1;
+    if (pattern_length > length)
+      return 0;
+    end = text + length - pattern_length + 1;
+    while ((found = memchr(text, *pattern, (size_t) (end - text))) != NULL)
+      {
+        if (memcmp(found, pattern, pattern_length) == 0)
+          return 1;
+        text = found + 1;
+      }
+    return 0;
+  }
+
+static int module_event(enum apivalue_module_event_type type, void * event_data)
+  {
+    struct cmd_text (* commands)[2];
+    struct top * ctx;
+    struct log_field field;
+    size_t i;
+    size_t j;
+    int rv;
+
+    switch (type)
+      {
+        case apivalue_module_event_type_loaded:
+        if (live_module != NULL)
+          return EXIT_FAILURE;
+        live_module = event_data;
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_thread_started:
+        ctx = event_data;
+        commands = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *commands);
+        if (commands == NULL)
+          {
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'count', 'grep' commands", NULL, 0);
+            return EXIT_FAILURE;
+          }
+        live_module->module.v1.module_pointers[0] = commands;
+        (*commands)[0].command = command_count;
+        (*commands)[1].command = command_grep;
+        rv = EXIT_SUCCESS;
+        for (i = 0; i < countof(*commands); ++i)
+          {
+            (*commands)[i].ctx = ctx;
+            (*commands)[i].command.live_module = live_module;
+            (void) ctx->api_list->initialize_list_item(ctx->api_list, &(*commands)[i].command.list_item);
+            rv = ctx->api_command->add(ctx->api_command, &(*commands)[i].command);
+            if (rv != EXIT_SUCCESS)
+              {
+                field.key = "command";
+                field.value = (*commands)[i].command.name;
+                ctx->log(live_module, apivalue_log_level_error, "Unable to register a command", &field, 1);
+                for (j = 0; j < i; ++j)
+                  (void) ctx->api_command->remove(ctx->api_command, &(*commands)[j].command);
+                ctx->api_stdlib->free(ctx->api_stdlib, commands);
+                live_module->module.v1.module_pointers[0] = NULL;
+                return rv;
+              }
+          }
+        return rv;
+
+        case apivalue_module_event_type_thread_stop_requested:
+        case apivalue_module_event_type_thread_stopped:
+        case apivalue_module_event_type_unload_requested:
+        return EXIT_SUCCESS;
+
+        case apivalue_module_event_type_unload:
+        /* Assume success until proven otherwise */
+        rv = EXIT_SUCCESS;
+        commands = live_module->module.v1.module_pointers[0];
+        if (commands != NULL)
+          {
+            ctx = (*commands)[0].ctx;
+            for (i = 0; i < countof(*commands); ++i)
+              {
+                rv = ctx->api_command->remove(ctx->api_command, &(*commands)[i].command);
+                if (rv != EXIT_SUCCESS)
+                  return rv;
+              }
+            ctx->api_stdlib->free(ctx->api_stdlib, commands);
+          }
+        live_module = NULL;
+        return rv;
+      }
+    return EXIT_FAILURE;
+  }
@@ -16,6 +16,26 @@
 #include "type.h"
 
 struct cmd_type;
+struct view_buffer;
+struct view_field;
+struct view_plan;
+struct view_plan_alignment;
+
+enum view_kind
+  {
+    view_kind_signed,
+    view_kind_unsigned,
+    view_kind_char,
+    view_kind_enum,
+    view_kind_float,
+    view_kind_double,
+    view_kind_long_double,
+    view_kind_pointer,
+    view_kind_array,
+    view_kind_aggregate,
+    view_kind_opaque,
+    view_kinds
+  };
 
 struct cmd_type
   {
@@ -23,11 +43,60 @@ struct cmd_type
     struct top * ctx;
   };
 
+/* Output for a record is collected here, then written all at once */
+struct view_buffer
+  {
+    char * data;
+    size_t capacity;
+    size_t length;
+  };
+
+struct view_field
+  {
+    char * name;
+    size_t name_length;
+    size_t offset;
+    /* Null for a bit-field */
+    struct view_plan * plan;
+  };
+
+/*
+ * How to format an object of a type, worked out once before any memory is
+ * viewed.  Plans for members and elements are shared, by type
+ */
+struct view_plan
+  {
+    struct view_plan * next;
+    struct type * type;
+    enum view_kind kind;
+    size_t size;
+    struct type_enum * type_enum;
+    struct view_plan * element;
+    size_t count;
+    struct view_field * fields;
+  };
+
+/* Not intended for use outside of sizeof and offsetof */
+struct view_plan_alignment
+  {
+    struct view_plan plan;
+    struct view_field fields[1];
+  };
+
+static apifunction_command cmd_enumvalue;
 static apifunction_command cmd_typedump;
+static apifunction_command cmd_view;
 static int dump_type(struct top *, struct type *, size_t);
+static struct type_enum * enum_of_type(struct type *);
+static struct type * find_type(struct top *, char *);
 static func_module_event module_event;
+static int view_format(struct top *, struct view_buffer *, struct view_plan *, const unsigned char *);
+static struct view_plan * view_plan_of_type(struct top *, struct view_plan **, struct type *);
+static int view_reserve(struct top *, struct view_buffer *, size_t);
 
+static struct command command_enumvalue;
 static struct command command_type;
+static struct command command_view;
 static struct live_module * live_module;
 
 #if BUILTIN_CMD_TYPE
@@ -40,7 +109,7 @@ union module module =
       {
         module_signature,
         "2024120200",
-        1
+        apivalue_module_api_version
       },
       &module_event,
       {
@@ -53,6 +122,21 @@ union module module =
     }
   };
 
+static struct command command_enumvalue =
+  {
+    NULL,
+    "enumvalue",
+    &cmd_enumvalue,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    apivalue_command_flag_pure
+  };
+
 static struct command command_type =
   {
     NULL,
@@ -61,19 +145,103 @@ static struct command command_type =
     {
       NULL,
       NULL
-    }
+    },
+    NULL,
+    NULL,
+    0,
+    apivalue_command_flag_pure
   };
 
-static int cmd_typedump(struct api_command * api, struct command * command, int argc, char ** argv)
+static struct command command_view =
+  {
+    NULL,
+    "view",
+    &cmd_view,
+    {
+      NULL,
+      NULL
+    },
+    NULL,
+    NULL,
+    0,
+    0
+  };
+
+static int cmd_enumvalue(struct api_command * api, struct command * command, int argc, char ** argv)
   {
     struct cmd_type * cmd;
     struct top * ctx;
     char * endptr;
-    size_t i;
+    char * name;
     int new_errno;
     int old_errno;
     struct type * type;
     struct api_type * type_api;
+    struct type_enum * type_enum;
+    enum apivalue_type type_rv;
+    static const char usage[] =
+      "Usage:\n"
+      "  enumvalue TYPE NAME    Show the value of enumeration constant NAME\n"
+      "  enumvalue TYPE NUMBER  Show the name of the enumeration constant having NUMBER\n"
+      "Notes:\n"
+      "  TYPE is as for 'typedump' and must be an enumerated type.\n"
+      ;
+    long int value;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_type, command, command);
+    ctx = cmd->ctx;
+    type_api = ctx->api_type;
+
+    if (argc != 3)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "%s", usage);
+        return EXIT_FAILURE;
+      }
+    type = find_type(ctx, argv[1]);
+    if (type == NULL)
+      return EXIT_FAILURE;
+    type_enum = enum_of_type(type);
+    if (type_enum == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Type '%s' is not an enumerated type\n", type->nice_name);
+        return EXIT_FAILURE;
+      }
+    /* Try as a name, first */
+    type_rv = type_api->enum_value_of_name(type_api, type_enum, argv[2], &value);
+    if (type_rv == apivalue_type_success)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%ld\n", value);
+        return EXIT_SUCCESS;
+      }
+    old_errno = errno;
+    errno = 0;
+    value = strtol(argv[2], &endptr, 0);
+    new_errno = errno;
+    errno = old_errno;
+    if (new_errno != 0 || *endptr != '\0' || endptr == argv[2])
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Type '%s' has no enumeration constant named '%s'\n", type->nice_name, argv[2]);
+        return EXIT_FAILURE;
+      }
+    type_rv = type_api->enum_name_of_value(type_api, type_enum, value, &name);
+    if (type_rv != apivalue_type_success)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Type '%s' has no enumeration constant with value %ld\n", type->nice_name, value);
+        return EXIT_FAILURE;
+      }
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "%s\n", name);
+    return EXIT_SUCCESS;
+  }
+
+static int cmd_typedump(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct cmd_type * cmd;
+    struct top * ctx;
+    size_t i;
+    struct type * type;
+    struct api_type * type_api;
     size_t type_count;
     static const char usage[] =
       "Usage:\n"
@@ -82,7 +250,6 @@ static int cmd_typedump(struct api_command * api, struct command * command, int
       "  TYPE can be either a type-name (if the type-name has no spaces)\n"
       "  or an 'unsigned long int' number (without any octothorpe).\n"
       ;
-    unsigned long int which;
 
     (void) api;
     (void) argv;
@@ -103,39 +270,138 @@ static int cmd_typedump(struct api_command * api, struct command * command, int
           }
         return EXIT_FAILURE;
       }
-    /* Otherwise, search for the type */
-    for (i = 0; i < type_count; ++i)
+    type = find_type(ctx, argv[1]);
+    if (type == NULL)
+      return EXIT_FAILURE;
+    return dump_type(ctx, type, 0);
+  }
+
+static int cmd_view(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    struct view_buffer buffer;
+    struct cmd_type * cmd;
+    unsigned long int count;
+    struct top * ctx;
+    char * endptr;
+    unsigned long int i;
+    const unsigned char * memory;
+    int new_errno;
+    struct type_object * object_type;
+    int old_errno;
+    struct view_plan * plan;
+    struct view_plan * plans;
+    void * pointer;
+    int rv;
+    struct type * type;
+    static const char usage[] =
+      "Usage:\n"
+      "  view TYPE POINTER [COUNT]  Show COUNT objects of TYPE at memory-address POINTER\n"
+      "Warnings:\n"
+      "  Pointer %p representations are not portable.  Using a %p sequence that\n"
+      "  hasn't been printed earlier yields an undefined result.\n"
+      "Notes:\n"
+      "  TYPE is as for 'typedump'.  COUNT is an 'unsigned long int' and\n"
+      "  defaults to 1.  Bit-fields are not yet decoded.\n"
+      ;
+
+    (void) api;
+
+    cmd = type_with_member_at_ptr(struct cmd_type, command, command);
+    ctx = cmd->ctx;
+
+    if (argc != 3 && argc != 4)
       {
-        type = type_api->types[i].type;
-        if (strcmp(argv[1], type->nice_name) == 0)
-          break;
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "%s", usage);
+        return EXIT_FAILURE;
+      }
+    type = find_type(ctx, argv[1]);
+    if (type == NULL)
+      return EXIT_FAILURE;
+    object_type = type_with_member_at_ptr(struct type_object, type, type);
+    if (type->partition != apivalue_type_partition_object || object_type->size == 0)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Type '%s' is not a complete object type\n", type->nice_name);
+        return EXIT_FAILURE;
+      }
+
+    old_errno = errno;
+
+    errno = 0;
+    rv = sscanf(argv[2], "%p", &pointer);
+    new_errno = errno;
+    errno = old_errno;
+    if (rv != 1)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unrecognized pointer format\n");
+        if (new_errno != 0)
+          {
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "...and errno was '%d' with message '%s'\n", new_errno, strerror(new_errno));
+            return new_errno;
+          }
+        return EXIT_FAILURE;
       }
-    if (i == type_count)
+
+    count = 1;
+    if (argc == 4)
       {
-        /* Try as a number */
-        old_errno = errno;
         errno = 0;
-        which = strtoul(argv[1], &endptr, 0);
+        count = strtoul(argv[3], &endptr, 0);
         new_errno = errno;
         errno = old_errno;
         if (new_errno != 0)
           {
-            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unrecognized 'unsigned long int' format for TYPE, with error '%d' and message '%s'\n", new_errno, strerror(new_errno));
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unrecognized 'unsigned long int' format for COUNT, with error '%d' and message '%s'\n", new_errno, strerror(new_errno));
             return new_errno;
           }
         if (*endptr != '\0')
           {
-            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unrecognized 'unsigned long int' format for TYPE\n");
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unrecognized 'unsigned long int' format for COUNT\n");
             return EXIT_FAILURE;
           }
-        if (which >= type_count)
-          {
-            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unknown type #%lu\n", which);
-            return EXIT_FAILURE;
-          }
-        type = type_api->types[(size_t) which].type;
       }
-    return dump_type(ctx, type, 0);
+
+    /* Plans aren't kept between views, since a type might belong to a module that is later unloaded */
+    plans = NULL;
+    buffer.data = NULL;
+    buffer.capacity = 0;
+    buffer.length = 0;
+    rv = EXIT_FAILURE;
+    plan = view_plan_of_type(ctx, &plans, type);
+    if (plan == NULL)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while planning the view\n");
+        goto err_plan;
+      }
+
+    memory = pointer;
+    for (i = 0; i < count; ++i)
+      {
+        if (view_reserve(ctx, &buffer, 64) != EXIT_SUCCESS)
+          goto err_record;
+        buffer.length += sprintf(buffer.data + buffer.length, "%p: ", (void *) memory);
+        if (view_format(ctx, &buffer, plan, memory) != EXIT_SUCCESS || view_reserve(ctx, &buffer, 1) != EXIT_SUCCESS)
+          goto err_record;
+        buffer.data[buffer.length++] = '\n';
+        (void) ctx->api_stdio->fwrite(ctx->api_stdio, buffer.data, 1, buffer.length, stdout);
+        buffer.length = 0;
+        memory += plan->size;
+      }
+    rv = EXIT_SUCCESS;
+
+    err_record:
+    if (rv != EXIT_SUCCESS)
+      (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while viewing record #%lu\n", i);
+    ctx->api_stdlib->free(ctx->api_stdlib, buffer.data);
+
+    err_plan:
+    while (plans != NULL)
+      {
+        plan = plans;
+        plans = plan->next;
+        ctx->api_stdlib->free(ctx->api_stdlib, plan);
+      }
+
+    return rv;
   }
 
 static int dump_type(struct top * ctx, struct type * type, size_t indentation)
@@ -144,11 +410,13 @@ static int dump_type(struct top * ctx, struct type * type, size_t indentation)
     struct type * full_type_inner;
     struct type_object * full_type_object;
     size_t i;
-    size_t j;
     struct type_struct_member * member;
     struct type_object * member_object_type;
     size_t member_size;
+    char * name;
     struct api_type * type_api;
+    struct type_enum * type_enum;
+    long int value;
 
     (void) indentation;
 
@@ -170,17 +438,90 @@ static int dump_type(struct top * ctx, struct type * type, size_t indentation)
         member_object_type = member->type;
         member_size = member_object_type->size;
         (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "Type has a property '%s' of type '%s' and value-bytes: L", member->name, member_object_type->type.nice_name);
-        for (j = 0; j < member_size; ++j)
-          (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, " 0x%02X", (((unsigned char *) type) + member->offset)[j]);
-        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, " H\n");
+        (void) ctx->api_stdio->append_hex(ctx->api_stdio, ((unsigned char *) type) + member->offset, member_size, " 0x", stdout);
+        (void) ctx->api_stdio->append_string(ctx->api_stdio, " H", stdout);
+        type_enum = enum_of_type(&member_object_type->type);
+        if (
+            type_enum != NULL &&
+            type_api->read_enum(type_api, type_enum, ((unsigned char *) type) + member->offset, &value) == apivalue_type_success &&
+            type_api->enum_name_of_value(type_api, type_enum, value, &name) == apivalue_type_success
+          )
+          (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, " (%s)", name);
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stdout, "\n");
       }
     return EXIT_SUCCESS;
   }
 
+static struct type_enum * enum_of_type(struct type * type)
+  {
+    struct type_arithmetic * arithmetic_type;
+    struct type_integer * integer_type;
+    struct type_object * object_type;
+
+    if (type->partition != apivalue_type_partition_object)
+      return NULL;
+    object_type = type_with_member_at_ptr(struct type_object, type, type);
+    if (object_type->object_type != apivalue_type_object_arithmetic)
+      return NULL;
+    arithmetic_type = type_with_member_at_ptr(struct type_arithmetic, object, object_type);
+    if (arithmetic_type->arithmetic_type != apivalue_type_arithmetic_integer)
+      return NULL;
+    integer_type = type_with_member_at_ptr(struct type_integer, arithmetic, arithmetic_type);
+    if (integer_type->integer_type != apivalue_type_integer_enum)
+      return NULL;
+    return type_with_member_at_ptr(struct type_enum, integer, integer_type);
+  }
+
+static struct type * find_type(struct top * ctx, char * name)
+  {
+    char * endptr;
+    size_t i;
+    int new_errno;
+    int old_errno;
+    struct type * type;
+    struct api_type * type_api;
+    size_t type_count;
+    unsigned long int which;
+
+    type_api = ctx->api_type;
+    type_count = type_api->type_count;
+    for (i = 0; i < type_count; ++i)
+      {
+        type = type_api->types[i].type;
+        if (strcmp(name, type->nice_name) == 0)
+          return type;
+      }
+    /* Try as a number */
+    old_errno = errno;
+    errno = 0;
+    which = strtoul(name, &endptr, 0);
+    new_errno = errno;
+    errno = old_errno;
+    if (new_errno != 0)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unrecognized 'unsigned long int' format for TYPE, with error '%d' and message '%s'\n", new_errno, strerror(new_errno));
+        return NULL;
+      }
+    if (*endptr != '\0')
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unrecognized 'unsigned long int' format for TYPE\n");
+        return NULL;
+      }
+    if (which >= type_count)
+      {
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Unknown type #%lu\n", which);
+        return NULL;
+      }
+    return type_api->types[(size_t) which].type;
+  }
+
 static int module_event(enum apivalue_module_event_type type, void * event_data)
   {
-    struct cmd_type * command;
+    struct cmd_type (* commands)[3];
     struct top * ctx;
+    struct log_field field;
+    size_t i;
+    size_t j;
     int rv;
 
     switch (type)
@@ -193,20 +534,37 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
 
         case apivalue_module_event_type_thread_started:
         ctx = event_data;
-        command = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *command);
-        if (command == NULL)
+        commands = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *commands);
+        if (commands == NULL)
           {
-            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while registering 'typedump' command\n");
+            ctx->log(live_module, apivalue_log_level_error, "Out of memory while registering 'enumvalue', 'typedump', 'view' commands", NULL, 0);
             return EXIT_FAILURE;
           }
-        live_module->module.v1.module_pointers[0] = command;
-        command->command = command_type;
-        command->command.live_module = live_module;
-        command->ctx = ctx;
-        (void) ctx->api_list->initialize_list_item(ctx->api_list, &command->command.list_item);
-        rv = ctx->api_command->add(ctx->api_command, &command->command);
-        if (rv != EXIT_SUCCESS)
-          (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Error '%d' while attempting to register 'typedump' command\n", rv);
+        live_module->module.v1.module_pointers[0] = commands;
+        (*commands)[0].command = command_enumvalue;
+        (*commands)[0].ctx = ctx;
+        (*commands)[1].command = command_type;
+        (*commands)[1].ctx = ctx;
+        (*commands)[2].command = command_view;
+        (*commands)[2].ctx = ctx;
+        rv = EXIT_SUCCESS;
+        for (i = 0; i < countof(*commands); ++i)
+          {
+            (*commands)[i].command.live_module = live_module;
+            (void) ctx->api_list->initialize_list_item(ctx->api_list, &(*commands)[i].command.list_item);
+            rv = ctx->api_command->add(ctx->api_command, &(*commands)[i].command);
+            if (rv != EXIT_SUCCESS)
+              {
+                field.key = "command";
+                field.value = (*commands)[i].command.name;
+                ctx->log(live_module, apivalue_log_level_error, "Unable to register a command", &field, 1);
+                for (j = 0; j < i; ++j)
+                  (void) ctx->api_command->remove(ctx->api_command, &(*commands)[j].command);
+                ctx->api_stdlib->free(ctx->api_stdlib, commands);
+                live_module->module.v1.module_pointers[0] = NULL;
+                return rv;
+              }
+          }
         return rv;
 
         case apivalue_module_event_type_thread_stop_requested:
@@ -217,16 +575,358 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
         case apivalue_module_event_type_unload:
         /* Assume success until proven otherwise */
         rv = EXIT_SUCCESS;
-        command = live_module->module.v1.module_pointers[0];
-        if (command != NULL)
+        commands = live_module->module.v1.module_pointers[0];
+        if (commands != NULL)
           {
-            ctx = command->ctx;
-            rv = ctx->api_command->remove(ctx->api_command, &command->command);
-            if (rv == EXIT_SUCCESS)
-              ctx->api_stdlib->free(ctx->api_stdlib, command);
+            ctx = (*commands)[0].ctx;
+            for (i = 0; i < countof(*commands); ++i)
+              {
+                rv = ctx->api_command->remove(ctx->api_command, &(*commands)[i].command);
+                if (rv != EXIT_SUCCESS)
+                  return rv;
+              }
+            ctx->api_stdlib->free(ctx->api_stdlib, commands);
           }
         live_module = NULL;
         return rv;
       }
     return EXIT_FAILURE;
   }
+
+static int view_format(struct top * ctx, struct view_buffer * buffer, struct view_plan * plan, const unsigned char * memory)
+  {
+    struct view_field * field;
+    double fd;
+    float ff;
+    long double fld;
+    size_t i;
+    size_t length;
+    char * name;
+    void * pointer;
+    char sc;
+    int si;
+    long int sli;
+    short int ssi;
+    struct api_type * type_api;
+    unsigned int ui;
+    unsigned long int uli;
+    unsigned short int usi;
+    unsigned char uc;
+    long int value;
+
+    /* Enough for any number or pointer */
+    if (view_reserve(ctx, buffer, 64) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    switch (plan->kind)
+      {
+        case view_kind_signed:
+        if (plan->size == sizeof si)
+          {
+            memcpy(&si, memory, sizeof si);
+            sli = si;
+          }
+          else if (plan->size == sizeof sli)
+          {
+            memcpy(&sli, memory, sizeof sli);
+          }
+          else if (plan->size == sizeof ssi)
+          {
+            memcpy(&ssi, memory, sizeof ssi);
+            sli = ssi;
+          }
+          else
+          {
+            sli = (signed char) memory[0];
+          }
+        buffer->length += sprintf(buffer->data + buffer->length, "%ld", sli);
+        return EXIT_SUCCESS;
+
+        case view_kind_unsigned:
+        if (plan->size == sizeof ui)
+          {
+            memcpy(&ui, memory, sizeof ui);
+            uli = ui;
+          }
+          else if (plan->size == sizeof uli)
+          {
+            memcpy(&uli, memory, sizeof uli);
+          }
+          else if (plan->size == sizeof usi)
+          {
+            memcpy(&usi, memory, sizeof usi);
+            uli = usi;
+          }
+          else
+          {
+            uc = memory[0];
+            uli = uc;
+          }
+        buffer->length += sprintf(buffer->data + buffer->length, "%lu", uli);
+        return EXIT_SUCCESS;
+
+        case view_kind_char:
+        memcpy(&sc, memory, sizeof sc);
+        buffer->length += sprintf(buffer->data + buffer->length, "%d", (int) sc);
+        return EXIT_SUCCESS;
+
+        case view_kind_enum:
+        type_api = ctx->api_type;
+        if (type_api->read_enum(type_api, plan->type_enum, memory, &value) != apivalue_type_success)
+          break;
+        if (type_api->enum_name_of_value(type_api, plan->type_enum, value, &name) == apivalue_type_success)
+          {
+            length = strlen(name);
+            if (view_reserve(ctx, buffer, length + 64) != EXIT_SUCCESS)
+              return EXIT_FAILURE;
+            memcpy(buffer->data + buffer->length, name, length);
+            buffer->length += length;
+            buffer->length += sprintf(buffer->data + buffer->length, " (%ld)", value);
+          }
+          else
+          {
+            buffer->length += sprintf(buffer->data + buffer->length, "%ld", value);
+          }
+        return EXIT_SUCCESS;
+
+        case view_kind_float:
+        memcpy(&ff, memory, sizeof ff);
+        buffer->length += sprintf(buffer->data + buffer->length, "%g", ff);
+        return EXIT_SUCCESS;
+
+        case view_kind_double:
+        memcpy(&fd, memory, sizeof fd);
+        buffer->length += sprintf(buffer->data + buffer->length, "%g", fd);
+        return EXIT_SUCCESS;
+
+        case view_kind_long_double:
+        memcpy(&fld, memory, sizeof fld);
+        buffer->length += sprintf(buffer->data + buffer->length, "%Lg", fld);
+        return EXIT_SUCCESS;
+
+        case view_kind_pointer:
+        memcpy(&pointer, memory, sizeof pointer);
+        buffer->length += sprintf(buffer->data + buffer->length, "%p", pointer);
+        return EXIT_SUCCESS;
+
+        case view_kind_array:
+        buffer->data[buffer->length++] = '{';
+        for (i = 0; i < plan->count; ++i)
+          {
+            if (i > 0)
+              {
+                if (view_reserve(ctx, buffer, 2) != EXIT_SUCCESS)
+                  return EXIT_FAILURE;
+                buffer->data[buffer->length++] = ',';
+                buffer->data[buffer->length++] = ' ';
+              }
+            if (view_format(ctx, buffer, plan->element, memory + i * plan->element->size) != EXIT_SUCCESS)
+              return EXIT_FAILURE;
+          }
+        if (view_reserve(ctx, buffer, 1) != EXIT_SUCCESS)
+          return EXIT_FAILURE;
+        buffer->data[buffer->length++] = '}';
+        return EXIT_SUCCESS;
+
+        case view_kind_aggregate:
+        buffer->data[buffer->length++] = '{';
+        for (i = 0; i < plan->count; ++i)
+          {
+            field = plan->fields + i;
+            if (view_reserve(ctx, buffer, field->name_length + 16) != EXIT_SUCCESS)
+              return EXIT_FAILURE;
+            if (i > 0)
+              {
+                buffer->data[buffer->length++] = ',';
+                buffer->data[buffer->length++] = ' ';
+              }
+            memcpy(buffer->data + buffer->length, field->name, field->name_length);
+            buffer->length += field->name_length;
+            memcpy(buffer->data + buffer->length, " = ", 3);
+            buffer->length += 3;
+            if (field->plan == NULL)
+              {
+                memcpy(buffer->data + buffer->length, "<bit-field>", 11);
+                buffer->length += 11;
+                continue;
+              }
+            if (view_format(ctx, buffer, field->plan, memory + field->offset) != EXIT_SUCCESS)
+              return EXIT_FAILURE;
+          }
+        if (view_reserve(ctx, buffer, 1) != EXIT_SUCCESS)
+          return EXIT_FAILURE;
+        buffer->data[buffer->length++] = '}';
+        return EXIT_SUCCESS;
+
+        case view_kind_opaque:
+        case view_kinds:
+        break;
+      }
+    /* Otherwise, show the bytes */
+    if (view_reserve(ctx, buffer, plan->size * 2 + 2) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    buffer->data[buffer->length++] = '0';
+    buffer->data[buffer->length++] = 'x';
+    for (i = 0; i < plan->size; ++i)
+      buffer->length += sprintf(buffer->data + buffer->length, "%02X", memory[i]);
+    return EXIT_SUCCESS;
+  }
+
+static struct view_plan * view_plan_of_type(struct top * ctx, struct view_plan ** plans, struct type * type)
+  {
+    struct type_arithmetic * arithmetic_type;
+    struct type_array * array_type;
+    size_t field_count;
+    struct type_floating * floating_type;
+    size_t i;
+    struct type_integer * integer_type;
+    char * mem;
+    struct type_object * object_type;
+    struct view_plan * plan;
+    struct type_struct * struct_type;
+    struct type_struct_member * struct_member;
+    struct type_union * union_type;
+    struct type_union_member * union_member;
+
+    for (plan = *plans; plan != NULL; plan = plan->next)
+      {
+        if (plan->type == type)
+          return plan;
+      }
+
+    object_type = type_with_member_at_ptr(struct type_object, type, type);
+    struct_type = NULL;
+    union_type = NULL;
+    field_count = 0;
+    if (type->partition == apivalue_type_partition_object)
+      {
+        if (object_type->object_type == apivalue_type_object_struct)
+          {
+            struct_type = type_with_member_at_ptr(struct type_struct, object, object_type);
+            field_count = struct_type->member_count;
+          }
+        if (object_type->object_type == apivalue_type_object_union)
+          {
+            union_type = type_with_member_at_ptr(struct type_union, object, object_type);
+            field_count = union_type->member_count;
+          }
+      }
+
+    mem = ctx->api_stdlib->malloc(ctx->api_stdlib, offsetof(struct view_plan_alignment, fields) + field_count * sizeof *plan->fields);
+    if (mem == NULL)
+      return NULL;
+    plan = (void *) mem;
+    plan->type = type;
+    plan->kind = view_kind_opaque;
+    plan->size = type->partition == apivalue_type_partition_object ? object_type->size : 0;
+    plan->type_enum = NULL;
+    plan->element = NULL;
+    plan->count = field_count;
+    plan->fields = (void *) (mem + offsetof(struct view_plan_alignment, fields));
+    /* Link it now, so it's freed along with the others, if planning fails */
+    plan->next = *plans;
+    *plans = plan;
+    if (type->partition != apivalue_type_partition_object)
+      return plan;
+
+    switch (object_type->object_type)
+      {
+        case apivalue_type_object_arithmetic:
+        arithmetic_type = type_with_member_at_ptr(struct type_arithmetic, object, object_type);
+        if (arithmetic_type->arithmetic_type == apivalue_type_arithmetic_floating)
+          {
+            floating_type = type_with_member_at_ptr(struct type_floating, arithmetic, arithmetic_type);
+            if (floating_type->floating_type == apivalue_type_floating_float && plan->size == sizeof (float))
+              plan->kind = view_kind_float;
+            if (floating_type->floating_type == apivalue_type_floating_double && plan->size == sizeof (double))
+              plan->kind = view_kind_double;
+            if (floating_type->floating_type == apivalue_type_floating_long_double && plan->size == sizeof (long double))
+              plan->kind = view_kind_long_double;
+            break;
+          }
+        integer_type = type_with_member_at_ptr(struct type_integer, arithmetic, arithmetic_type);
+        if (integer_type->integer_type == apivalue_type_integer_enum)
+          {
+            plan->kind = view_kind_enum;
+            plan->type_enum = type_with_member_at_ptr(struct type_enum, integer, integer_type);
+            break;
+          }
+        /* Without 'long long int' in C89, wider integers are shown as bytes */
+        if (plan->size == 0 || plan->size > sizeof (long int))
+          break;
+        if (integer_type->integer_type == apivalue_type_integer_char && integer_type->sign == apivalue_type_sign_implementation_defined)
+          plan->kind = view_kind_char;
+          else if (integer_type->integer_type == apivalue_type_integer_size_t || integer_type->sign == apivalue_type_unsigned)
+          plan->kind = view_kind_unsigned;
+          else
+          plan->kind = view_kind_signed;
+        break;
+
+        case apivalue_type_object_array:
+        array_type = type_with_member_at_ptr(struct type_array, object, object_type);
+        plan->element = view_plan_of_type(ctx, plans, &array_type->element_type->type);
+        if (plan->element == NULL)
+          return NULL;
+        plan->count = array_type->element_count;
+        if (plan->element->size > 0 && plan->count > 0)
+          plan->kind = view_kind_array;
+        break;
+
+        case apivalue_type_object_struct:
+        for (i = 0; i < field_count; ++i)
+          {
+            struct_member = struct_type->members + i;
+            plan->fields[i].name = struct_member->name != NULL ? struct_member->name : "?";
+            plan->fields[i].name_length = strlen(plan->fields[i].name);
+            plan->fields[i].offset = struct_member->offset;
+            plan->fields[i].plan = NULL;
+            if (struct_member->bitfield_width != 0)
+              continue;
+            plan->fields[i].plan = view_plan_of_type(ctx, plans, &struct_member->type->type);
+            if (plan->fields[i].plan == NULL)
+              return NULL;
+          }
+        plan->kind = view_kind_aggregate;
+        break;
+
+        case apivalue_type_object_union:
+        for (i = 0; i < field_count; ++i)
+          {
+            union_member = union_type->members + i;
+            plan->fields[i].name = union_member->name != NULL ? union_member->name : "?";
+            plan->fields[i].name_length = strlen(plan->fields[i].name);
+            plan->fields[i].offset = 0;
+            plan->fields[i].plan = view_plan_of_type(ctx, plans, &union_member->type->type);
+            if (plan->fields[i].plan == NULL)
+              return NULL;
+          }
+        plan->kind = view_kind_aggregate;
+        break;
+
+        case apivalue_type_object_pointer:
+        if (plan->size == sizeof (void *))
+          plan->kind = view_kind_pointer;
+        break;
+
+        case apivalue_type_object_void:
+        case apivalue_type_objects:
+        break;
+      }
+    return plan;
+  }
+
+static int view_reserve(struct top * ctx, struct view_buffer * buffer, size_t size)
+  {
+    size_t new_capacity;
+    char * new_data;
+
+    if (buffer->capacity - buffer->length >= size)
+      return EXIT_SUCCESS;
+    for (new_capacity = buffer->capacity > 0 ? buffer->capacity : 256; new_capacity - buffer->length < size; new_capacity *= 2)
+      continue;
+    new_data = ctx->api_stdlib->realloc(ctx->api_stdlib, buffer->data, new_capacity);
+    if (new_data == NULL)
+      return EXIT_FAILURE;
+    buffer->data = new_data;
+    buffer->capacity = new_capacity;
+    return EXIT_SUCCESS;
+  }
@@ -1,112 +1,1128 @@
 /*
  * Copyright (C) 2024 Shao Miller.  All rights reserved.
  */
+#if CMDCTOY_POSIX
+/* For fsync */
+#define _POSIX_C_SOURCE 200112L
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif /* CMDCTOY_POSIX */
 #include <ctype.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include "arena.h"
 #include "command.h"
 #include "toyio.h"
 #include "toydef.h"
+#include "toylib.h"
 #include "list.h"
+#include "module.h"
+
+/* The key, then the output, follow the entry */
+struct command_cache_entry
+  {
+    size_t hash;
+    unsigned long int versions[apivalue_command_versions];
+    size_t key_length;
+    size_t output_length;
+  };
 
 static struct api_command api_command_defaults;
 
 static apifunction_command_add add_command;
 static apifunction_command_line command_line;
+static apifunction_command_find find_command;
+static apifunction_command_match match_commands;
 static apifunction_command_remove remove_command;
+static apifunction_command_reply reply;
+static apifunction_command_scan scan;
+static apifunction_command_tokenize tokenize;
+static int run_command(struct api_command *, const char *, size_t);
+static int run_handler(struct api_command *, struct command *, int, char **);
+static int run_line(struct api_command *, const char *, size_t);
+static int run_pipeline(struct api_command *, const char *, size_t);
+static int run_pure(struct api_command *, struct command *, int, char **);
+static int run_redirected(struct api_command *, const char *, size_t, size_t);
+static char * cache_text(struct command_cache_entry *);
+static size_t decode_token(const struct command_token *, char *);
+static void find_operators(const char *, size_t, size_t *, size_t *, size_t *);
+static struct command ** find_slot(struct api_command *, const char *, size_t);
+static void flush_cache(struct api_command *);
+static int grow_buckets(struct api_command *);
+static int grow_index(struct api_command *);
+static size_t hash_name(const char *);
+static int is_blank(const char *, size_t);
+static int key_matches(struct command_cache_entry *, const char *, int, char **);
+static size_t lower_bound(struct api_command *, const char *, size_t);
+static void report_ambiguity(struct api_command *, const char *, struct command * const *, size_t);
+static enum apivalue_command scan_text(const char *, size_t, const char *, size_t *, int *);
 
 static struct api_command api_command_defaults =
   {
+    NULL,
     NULL,
     NULL,
     &api_command_initialize,
     &add_command,
+    NULL,
+    &find_command,
     &command_line,
+    &match_commands,
+    NULL,
     &remove_command,
+    &reply,
+    &scan,
+    &tokenize,
     {
       {
         NULL,
         NULL
       }
-    }
+    },
+    0,
+    0,
+    NULL,
+    0,
+    0,
+    NULL,
+    NULL,
+    0,
+    {
+      NULL,
+      NULL,
+      NULL,
+      NULL
+    },
+    NULL
   };
 
+/*
+ * A command with the same name as an existing command shadows it, until it's
+ * removed.  This only fails for lack of memory, which the caller reports
+ */
 static int add_command(struct api_command * api, struct command * command)
   {
+    size_t position;
+    struct command ** slot;
+
+    /* Keep the buckets at least as many as the commands */
+    if (api->command_count >= api->bucket_count && grow_buckets(api) != EXIT_SUCCESS && api->bucket_count == 0)
+      return EXIT_FAILURE;
+    command->hash = hash_name(command->name);
+    slot = find_slot(api, command->name, command->hash);
+    if (*slot == NULL && api->index_count == api->index_capacity && grow_index(api) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    position = lower_bound(api, command->name, strlen(command->name) + 1);
+    command->shadowed = *slot;
+    if (*slot != NULL)
+      {
+        /* Take the shadowed command's place */
+        command->hash_next = (*slot)->hash_next;
+        (*slot)->hash_next = NULL;
+      }
+      else
+      {
+        command->hash_next = NULL;
+        memmove(api->index + position + 1, api->index + position, (api->index_count - position) * sizeof *api->index);
+        ++api->index_count;
+      }
+    api->index[position] = command;
+    *slot = command;
     (void) api->api_list->add_item_to_list_head(api->api_list, &command->list_item, &api->commands);
+    ++api->command_count;
+    /* Kept outputs might be for a command that's now shadowed */
+    flush_cache(api);
     return EXIT_SUCCESS;
   }
 
-static int command_line(struct api_command * api, char * cmd, size_t cmd_len)
+/*
+ * Standard output is gathered for the whole line and written at once, unless
+ * it's already going somewhere else, such as into a chain or another sink
+ */
+static int command_line(struct api_command * api, const char * cmd, size_t cmd_len)
+  {
+    int rv;
+    struct stdio_sink sink;
+    struct api_stdio * stdio_api;
+
+    stdio_api = api->api_stdio;
+    if (stdio_api->output != NULL || stdio_api->sink != NULL)
+      return run_line(api, cmd, cmd_len);
+    stdio_api->initialize_sink(stdio_api, &sink, apivalue_stdio_sink_file, api->api_stdlib);
+    stdio_api->sink = &sink;
+    rv = run_line(api, cmd, cmd_len);
+    stdio_api->sink = NULL;
+    if (stdio_api->release_sink(stdio_api, &sink) != EXIT_SUCCESS && rv == EXIT_SUCCESS)
+      rv = EXIT_FAILURE;
+    return rv;
+  }
+
+static int run_command(struct api_command * api, const char * cmd, size_t cmd_len)
   {
     int argc;
-    char * argv[apivalue_command_max_argc + 1];
+    char ** argv;
     struct command * command;
+    size_t count;
+    enum apivalue_command command_rv;
     size_t i;
-    struct list_item * list_item;
+    size_t match_count;
+    struct command * const * matches;
+    char * mem;
     int rv;
+    size_t size;
+    char * stack_argv[16 + 1];
+    char stack_text[256];
+    struct command_token stack_tokens[16];
+    char * text;
+    struct command_token * tokens;
 
-    if (cmd[cmd_len] != '\0')
+    /* Most lines fit on the stack */
+    tokens = stack_tokens;
+    command_rv = api->tokenize(api, cmd, cmd_len, tokens, countof(stack_tokens), &count);
+    mem = NULL;
+    if (command_rv == apivalue_command_error_buffer_too_small)
       {
-        (void) api->api_stdio->fprintf(api->api_stdio, stderr, "Command not null-terminated, so it has been ignored\n");
-        return EXIT_FAILURE;
+        if (count > ((size_t) -1 - 1) / (sizeof *tokens + sizeof *argv))
+          goto err_memory;
+        mem = api->api_stdlib->malloc(api->api_stdlib, count * sizeof *tokens);
+        if (mem == NULL)
+          goto err_memory;
+        tokens = (void *) mem;
+        command_rv = api->tokenize(api, cmd, cmd_len, tokens, count, &count);
       }
-    argc = 0;
-    for (i = 0; i < cmd_len; ++i)
+    if (command_rv == apivalue_command_error_unterminated_quote)
       {
-        while (isspace(cmd[i]))
-          ++i;
-        if (cmd[i] == '\0')
-          break;
-        if (argc == apivalue_command_max_argc)
+        (void) api->api_stdio->fprintf(api->api_stdio, stderr, "Unterminated quote, so command has been ignored\n");
+        rv = EXIT_FAILURE;
+        goto err_tokenize;
+      }
+    if (command_rv != apivalue_command_success)
+      {
+        rv = EXIT_FAILURE;
+        goto err_tokenize;
+      }
+    if (count == 0)
+      {
+        rv = EXIT_SUCCESS;
+        goto err_tokenize;
+      }
+    if (count > INT_MAX - 1)
+      goto err_memory;
+
+    /* The arguments are copied and terminated, since handlers expect strings */
+    size = 0;
+    for (i = 0; i < count; ++i)
+      size += tokens[i].length + 1;
+    if (count < countof(stack_argv) && size <= sizeof stack_text)
+      {
+        argv = stack_argv;
+        text = stack_text;
+      }
+      else
+      {
+        argv = api->api_stdlib->malloc(api->api_stdlib, (count + 1) * sizeof *argv + size);
+        if (argv == NULL)
+          goto err_memory;
+        text = (char *) (argv + count + 1);
+      }
+    for (i = 0; i < count; ++i)
+      {
+        argv[i] = text;
+        if (tokens[i].decode)
+          text += decode_token(tokens + i, text);
+          else
           {
-            (void) api->api_stdio->fprintf(api->api_stdio, stderr, "More than %d arguments for command, so it has been ignored\n", apivalue_command_max_argc);
-            return EXIT_FAILURE;
+            memcpy(text, tokens[i].text, tokens[i].length);
+            text += tokens[i].length;
           }
-        argv[argc] = cmd + i;
-        ++argc;
-        while (!isspace(cmd[i]) && cmd[i] != '\0')
-          ++i;
-        if (cmd[i] == '\0')
+        *text++ = '\0';
+      }
+    argv[count] = NULL;
+    argc = (int) count;
+
+    command = api->find(api, argv[0]);
+    match_count = 0;
+    matches = NULL;
+    if (command == NULL && *argv[0] != '\0')
+      {
+        /* An unambiguous prefix will do */
+        matches = api->match(api, argv[0], &match_count);
+        if (match_count == 1)
+          command = matches[0];
+      }
+    if (command == NULL && match_count > 1)
+      {
+        report_ambiguity(api, argv[0], matches, match_count);
+        rv = EXIT_FAILURE;
+      }
+      else if (command == NULL)
+      {
+        (void) api->api_stdio->fprintf(api->api_stdio, stderr, "Awful command or file name\n");
+        rv = EXIT_FAILURE;
+      }
+      else if ((command->flags & apivalue_command_flag_pure) && api->input == NULL)
+      {
+        rv = run_pure(api, command, argc, argv);
+      }
+      else
+      {
+        rv = run_handler(api, command, argc, argv);
+      }
+
+    if (argv != stack_argv)
+      api->api_stdlib->free(api->api_stdlib, argv);
+    api->api_stdlib->free(api->api_stdlib, mem);
+    return rv;
+
+    err_memory:
+    (void) api->api_stdio->fprintf(api->api_stdio, stderr, "Out of memory for command arguments, so command has been ignored\n");
+    rv = EXIT_FAILURE;
+
+    err_tokenize:
+    api->api_stdlib->free(api->api_stdlib, mem);
+    return rv;
+  }
+
+static char * cache_text(struct command_cache_entry * entry)
+  {
+    return (char *) (entry + 1);
+  }
+
+/* Returns the length of the decoded text */
+static size_t decode_token(const struct command_token * token, char * buffer)
+  {
+    char c;
+    size_t i;
+    size_t length;
+    char quote;
+
+    length = 0;
+    quote = '\0';
+    for (i = 0; i < token->length; ++i)
+      {
+        c = token->text[i];
+        if (quote == '\'')
+          {
+            if (c == '\'')
+              quote = '\0';
+              else
+              buffer[length++] = c;
+            continue;
+          }
+        if (quote == '"')
+          {
+            if (c == '\\' && i + 1 < token->length && (token->text[i + 1] == '"' || token->text[i + 1] == '\\'))
+              buffer[length++] = token->text[++i];
+              else if (c == '"')
+              quote = '\0';
+              else
+              buffer[length++] = c;
+            continue;
+          }
+        if (c == '\\' && i + 1 < token->length)
+          buffer[length++] = token->text[++i];
+          else if (c == '\'' || c == '"')
+          quote = c;
+          else
+          buffer[length++] = c;
+      }
+    return length;
+  }
+
+static struct command * find_command(struct api_command * api, const char * name)
+  {
+    if (name == NULL || api->bucket_count == 0)
+      return NULL;
+    return *find_slot(api, name, hash_name(name));
+  }
+
+/*
+ * Finds the first '|', the last '&' and the first '>' that aren't quoted nor
+ * escaped.  The length is given for any that isn't found
+ */
+static void find_operators(const char * line, size_t length, size_t * bar, size_t * ampersand, size_t * angle)
+  {
+    size_t i;
+    size_t position;
+
+    *bar = length;
+    *ampersand = length;
+    *angle = length;
+    for (i = 0; i < length; ++i)
+      {
+        /* Each operator is outside of quotes, so scanning can start again after it */
+        (void) scan_text(line + i, length - i, "|&>", &position, NULL);
+        i += position;
+        if (i == length)
           break;
-        cmd[i] = '\0';
+        if (line[i] == '|' && *bar == length)
+          *bar = i;
+          else if (line[i] == '&')
+          *ampersand = i;
+          else if (line[i] == '>' && *angle == length)
+          *angle = i;
       }
-    if (argc == 0)
-      return EXIT_SUCCESS;
-    argv[argc] = NULL;
+  }
+
+/* Returns where the named command is linked, or else where it would be linked */
+static struct command ** find_slot(struct api_command * api, const char * name, size_t hash)
+  {
+    struct command ** slot;
 
-    for (list_item = api->commands.head.next; list_item != &api->commands.head; list_item = list_item->next)
+    for (slot = api->buckets + (hash & (api->bucket_count - 1)); *slot != NULL; slot = &(*slot)->hash_next)
       {
-        command = type_with_member_at_ptr(struct command, list_item, list_item);
-        if (strcmp(argv[0], command->name) != 0)
-          continue;
-        /* A match */
-        rv = command->handler(api, command, argc, argv);
-        return rv;
+        if ((*slot)->hash == hash && strcmp((*slot)->name, name) == 0)
+          break;
+      }
+    return slot;
+  }
+
+static void flush_cache(struct api_command * api)
+  {
+    size_t i;
+
+    if (api->cache == NULL)
+      return;
+    for (i = 0; i < apivalue_command_cache_slots; ++i)
+      {
+        api->api_stdlib->free(api->api_stdlib, api->cache[i]);
+        api->cache[i] = NULL;
+      }
+  }
+
+static int grow_buckets(struct api_command * api)
+  {
+    struct command * command;
+    size_t i;
+    struct command ** new_buckets;
+    size_t new_count;
+    struct command * next;
+    struct command ** slot;
+
+    new_count = api->bucket_count > 0 ? api->bucket_count * 2 : 16;
+    if (new_count > (size_t) -1 / sizeof *new_buckets)
+      return EXIT_FAILURE;
+    new_buckets = api->api_stdlib->malloc(api->api_stdlib, new_count * sizeof *new_buckets);
+    if (new_buckets == NULL)
+      return EXIT_FAILURE;
+    for (i = 0; i < new_count; ++i)
+      new_buckets[i] = NULL;
+    for (i = 0; i < api->bucket_count; ++i)
+      {
+        for (command = api->buckets[i]; command != NULL; command = next)
+          {
+            next = command->hash_next;
+            slot = new_buckets + (command->hash & (new_count - 1));
+            command->hash_next = *slot;
+            *slot = command;
+          }
+      }
+    api->api_stdlib->free(api->api_stdlib, api->buckets);
+    api->buckets = new_buckets;
+    api->bucket_count = new_count;
+    return EXIT_SUCCESS;
+  }
+
+static int grow_index(struct api_command * api)
+  {
+    struct command ** new_index;
+    size_t new_capacity;
+
+    new_capacity = api->index_capacity > 0 ? api->index_capacity * 2 : 16;
+    if (new_capacity > (size_t) -1 / sizeof *new_index)
+      return EXIT_FAILURE;
+    new_index = api->api_stdlib->realloc(api->api_stdlib, api->index, new_capacity * sizeof *new_index);
+    if (new_index == NULL)
+      return EXIT_FAILURE;
+    api->index = new_index;
+    api->index_capacity = new_capacity;
+    return EXIT_SUCCESS;
+  }
+
+static size_t hash_name(const char * name)
+  {
+    size_t hash;
+
+    hash = 2166136261UL;
+    for (; *name != '\0'; ++name)
+      {
+        hash ^= (unsigned char) *name;
+        hash *= 16777619UL;
+      }
+    return hash;
+  }
+
+static int is_blank(const char * text, size_t length)
+  {
+    size_t i;
+
+    for (i = 0; i < length; ++i)
+      {
+        if (text[i] != '\0' && !isspace((unsigned char) text[i]))
+          return 0;
+      }
+    return 1;
+  }
+
+static int key_matches(struct command_cache_entry * entry, const char * name, int argc, char ** argv)
+  {
+    int i;
+    const char * key;
+    size_t length;
+
+    key = cache_text(entry);
+    length = strlen(name) + 1;
+    if (length > entry->key_length || memcmp(key, name, length) != 0)
+      return 0;
+    for (i = 1; i < argc; ++i)
+      {
+        key += length;
+        length = strlen(argv[i]) + 1;
+        if (length > entry->key_length - (size_t) (key - cache_text(entry)) || memcmp(key, argv[i], length) != 0)
+          return 0;
       }
-    (void) api->api_stdio->fprintf(api->api_stdio, stderr, "Awful command or file name\n");
-    return EXIT_FAILURE;
+    return key + length == cache_text(entry) + entry->key_length;
+  }
+
+/* Returns the first position in the index whose name isn't less than the first 'length' characters of 'name' */
+static size_t lower_bound(struct api_command * api, const char * name, size_t length)
+  {
+    size_t high;
+    size_t low;
+    size_t middle;
+
+    low = 0;
+    high = api->index_count;
+    while (low < high)
+      {
+        middle = low + (high - low) / 2;
+        if (strncmp(api->index[middle]->name, name, length) < 0)
+          low = middle + 1;
+          else
+          high = middle;
+      }
+    return low;
+  }
+
+/* Commands sharing a prefix are next to each other in the index */
+static struct command * const * match_commands(struct api_command * api, const char * prefix, size_t * count)
+  {
+    size_t end;
+    size_t length;
+    size_t start;
+
+    length = strlen(prefix);
+    start = lower_bound(api, prefix, length);
+    for (end = start; end < api->index_count && strncmp(api->index[end]->name, prefix, length) == 0; ++end)
+      ;
+    *count = end - start;
+    return api->index + start;
   }
 
 enum apivalue_command api_command_initialize(struct api_command * api)
   {
     struct api_list * list_api;
     struct api_stdio * stdio_api;
+    struct api_stdlib * stdlib_api;
 
     list_api = api->api_list;
     stdio_api = api->api_stdio;
-    if (list_api == NULL || stdio_api == NULL)
+    stdlib_api = api->api_stdlib;
+    if (list_api == NULL || stdio_api == NULL || stdlib_api == NULL)
       return apivalue_command_error_null_argument;
     *api = api_command_defaults;
     api->api_list = list_api;
     api->api_stdio = stdio_api;
+    api->api_stdlib = stdlib_api;
     list_api->initialize_list(list_api, &api->commands);
     return apivalue_command_success;
   }
 
 static int remove_command(struct api_command * api, struct command * command)
   {
+    size_t position;
+    struct command ** shadowed;
+    struct command ** slot;
+
+    if (api->bucket_count > 0)
+      {
+        slot = find_slot(api, command->name, hash_name(command->name));
+        if (*slot == command)
+          {
+            position = lower_bound(api, command->name, strlen(command->name) + 1);
+            /* Restore whatever it shadowed */
+            if (command->shadowed != NULL)
+              {
+                command->shadowed->hash_next = command->hash_next;
+                *slot = command->shadowed;
+                api->index[position] = command->shadowed;
+              }
+              else
+              {
+                *slot = command->hash_next;
+                --api->index_count;
+                memmove(api->index + position, api->index + position + 1, (api->index_count - position) * sizeof *api->index);
+              }
+          }
+          else if (*slot != NULL)
+          {
+            /* It's shadowed, itself */
+            for (shadowed = &(*slot)->shadowed; *shadowed != NULL; shadowed = &(*shadowed)->shadowed)
+              {
+                if (*shadowed == command)
+                  {
+                    *shadowed = command->shadowed;
+                    break;
+                  }
+              }
+          }
+      }
+    command->hash_next = NULL;
+    command->shadowed = NULL;
     (void) api->api_list->remove_list_item(api->api_list, &command->list_item);
+    flush_cache(api);
+    if (api->command_count > 0 && --api->command_count == 0)
+      {
+        api->api_stdlib->free(api->api_stdlib, api->buckets);
+        api->buckets = NULL;
+        api->bucket_count = 0;
+        api->api_stdlib->free(api->api_stdlib, api->cache);
+        api->cache = NULL;
+        api->api_stdlib->free(api->api_stdlib, api->index);
+        api->index = NULL;
+        api->index_capacity = 0;
+        api->index_count = 0;
+      }
     return EXIT_SUCCESS;
   }
+
+static int reply(struct api_command * api, const char * line, size_t length, struct api_stdlib * stdlib_api, char ** buffer, size_t * capacity, size_t * end)
+  {
+    struct stdio_chain chains[2];
+    struct stdio_cursor cursor;
+    char header[64];
+    size_t header_length;
+    size_t i;
+    struct stdio_chain * old_error_output;
+    struct stdio_chain * old_output;
+    struct stdio_line output_line;
+    int rv;
+    size_t size;
+    struct api_stdio * stdio_api;
+    enum apivalue_stdio stdio_rv;
+
+    stdio_api = api->api_stdio;
+    old_output = stdio_api->output;
+    old_error_output = stdio_api->error_output;
+    stdio_api->initialize_chain(stdio_api, chains + 0, api->api_stdlib);
+    stdio_api->initialize_chain(stdio_api, chains + 1, api->api_stdlib);
+    stdio_api->output = chains + 0;
+    stdio_api->error_output = chains + 1;
+    rv = api->line(api, line, length);
+    stdio_api->output = old_output;
+    stdio_api->error_output = old_error_output;
+
+    sprintf(header, "%d %lu %lu\n", rv, (unsigned long int) chains[0].length, (unsigned long int) chains[1].length);
+    header_length = strlen(header);
+    size = header_length + chains[0].length;
+    stdio_rv = apivalue_stdio_error_out_of_memory;
+    if (size < header_length || size + chains[1].length < size || *end + size + chains[1].length < size)
+      goto err_size;
+    if (stdio_api->grow_buffer(stdio_api, stdlib_api, buffer, capacity, *end + size + chains[1].length) != EXIT_SUCCESS)
+      goto err_size;
+    memcpy(*buffer + *end, header, header_length);
+    *end += header_length;
+    for (i = 0; i < countof(chains); ++i)
+      {
+        stdio_api->initialize_cursor(stdio_api, &cursor, chains + i);
+        while ((stdio_rv = stdio_api->read_line(stdio_api, &cursor, &output_line)) == apivalue_stdio_success)
+          {
+            memcpy(*buffer + *end, output_line.text, output_line.length);
+            *end += output_line.length;
+          }
+        stdio_api->release_cursor(stdio_api, &cursor);
+        if (stdio_rv != apivalue_stdio_end_of_chain)
+          break;
+      }
+
+    err_size:
+    stdio_api->release_chain(stdio_api, chains + 0);
+    stdio_api->release_chain(stdio_api, chains + 1);
+    return stdio_rv == apivalue_stdio_end_of_chain ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+static void report_ambiguity(struct api_command * api, const char * prefix, struct command * const * matches, size_t count)
+  {
+    size_t i;
+
+    (void) api->api_stdio->fprintf(api->api_stdio, stderr, "Ambiguous command '%s', which could be:\n", prefix);
+    for (i = 0; i < count; ++i)
+      (void) api->api_stdio->fprintf(api->api_stdio, stderr, "  '%s'\n", matches[i]->name);
+  }
+
+/* What the handler allocates through the APIs is profiled under its module */
+static int run_handler(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    const char * old_worker;
+    int rv;
+
+    old_worker = set_memory_profile_worker(command->live_module->module.v1.nice_name);
+    if (api->profile != NULL)
+      rv = api->profile(api, command, argc, argv);
+      else
+      rv = command->handler(api, command, argc, argv);
+    (void) set_memory_profile_worker(old_worker);
+    return rv;
+  }
+
+/*
+ * Outside of quotes, '|' separates the commands of a pipeline, '>' or '>>'
+ * sends the standard output to a file and a final '&' runs the line as a job
+ */
+static int run_line(struct api_command * api, const char * cmd, size_t cmd_len)
+  {
+    size_t ampersand;
+    size_t angle;
+    size_t bar;
+    int rv;
+
+    find_operators(cmd, cmd_len, &bar, &ampersand, &angle);
+
+    /* The rest of the line is run as a job */
+    if (ampersand < cmd_len && is_blank(cmd + ampersand + 1, cmd_len - ampersand - 1))
+      {
+        if (is_blank(cmd, ampersand))
+          {
+            (void) api->api_stdio->fprintf(api->api_stdio, stderr, "No command before '&', so command has been ignored\n");
+            rv = EXIT_FAILURE;
+          }
+          else if (api->background == NULL)
+          {
+            (void) api->api_stdio->fprintf(api->api_stdio, stderr, "Background commands aren't available, so command has been ignored\n");
+            rv = EXIT_FAILURE;
+          }
+          else
+          {
+            rv = api->background(api, cmd, ampersand);
+          }
+        return rv;
+      }
+
+    if (angle < cmd_len)
+      return run_redirected(api, cmd, cmd_len, angle);
+    if (bar < cmd_len)
+      return run_pipeline(api, cmd, cmd_len);
+    return run_command(api, cmd, cmd_len);
+  }
+
+/*
+ * Each command's standard output is kept in memory for the next command to
+ * read as its input.  The last command's output goes wherever it would have
+ */
+static int run_pipeline(struct api_command * api, const char * cmd, size_t cmd_len)
+  {
+    size_t ampersand;
+    size_t angle;
+    size_t bar;
+    struct stdio_chain chains[2];
+    struct stdio_chain * input;
+    struct stdio_chain * old_input;
+    struct stdio_chain * old_output;
+    struct stdio_chain * output;
+    int rv;
+    size_t stage;
+    size_t start;
+
+    for (start = 0; start <= cmd_len; start += bar + 1)
+      {
+        find_operators(cmd + start, cmd_len - start, &bar, &ampersand, &angle);
+        if (is_blank(cmd + start, bar))
+          {
+            (void) api->api_stdio->fprintf(api->api_stdio, stderr, "Empty command in pipeline, so command has been ignored\n");
+            return EXIT_FAILURE;
+          }
+      }
+
+    old_input = api->input;
+    old_output = api->api_stdio->output;
+    api->api_stdio->initialize_chain(api->api_stdio, chains + 0, api->api_stdlib);
+    api->api_stdio->initialize_chain(api->api_stdio, chains + 1, api->api_stdlib);
+    input = old_input;
+    rv = EXIT_SUCCESS;
+    for (stage = 0, start = 0; start <= cmd_len; ++stage, start += bar + 1)
+      {
+        find_operators(cmd + start, cmd_len - start, &bar, &ampersand, &angle);
+        output = start + bar < cmd_len ? chains + stage % 2 : old_output;
+        api->input = input;
+        api->api_stdio->output = output;
+        rv = run_command(api, cmd + start, bar);
+        if (input != old_input)
+          api->api_stdio->release_chain(api->api_stdio, input);
+        input = output;
+      }
+    api->input = old_input;
+    api->api_stdio->output = old_output;
+    return rv;
+  }
+
+/*
+ * A pure command's standard output is kept, and replayed with a single write
+ * when the command is run again with the same arguments and none of the
+ * versioned state has changed.  Only successful runs are kept, and what goes
+ * to standard error isn't
+ */
+static int run_pure(struct api_command * api, struct command * command, int argc, char ** argv)
+  {
+    unsigned long int bytes;
+    struct stdio_chain chain;
+    struct stdio_cursor cursor;
+    struct command_cache_entry * entry;
+    size_t hash;
+    int i;
+    size_t j;
+    size_t key_length;
+    struct stdio_line line;
+    char * mem;
+    const char * name;
+    struct stdio_chain * old_output;
+    int rv;
+    struct command_cache_entry ** slot;
+    struct api_stdio * stdio_api;
+    enum apivalue_stdio stdio_rv;
+    struct api_stdlib * stdlib_api;
+    unsigned long int versions[apivalue_command_versions];
+
+    stdio_api = api->api_stdio;
+    stdlib_api = api->api_stdlib;
+    if (api->cache == NULL)
+      {
+        api->cache = stdlib_api->malloc(stdlib_api, apivalue_command_cache_slots * sizeof *api->cache);
+        if (api->cache == NULL)
+          return run_handler(api, command, argc, argv);
+        for (j = 0; j < apivalue_command_cache_slots; ++j)
+          api->cache[j] = NULL;
+      }
+
+    /* The key is the name and the arguments, each with its terminator */
+    hash = 2166136261UL;
+    key_length = 0;
+    for (i = 0; i < argc; ++i)
+      {
+        for (name = i == 0 ? command->name : argv[i]; ; ++name)
+          {
+            hash ^= (unsigned char) *name;
+            hash *= 16777619UL;
+            ++key_length;
+            if (*name == '\0')
+              break;
+          }
+      }
+    for (j = 0; j < apivalue_command_versions; ++j)
+      versions[j] = api->versions[j] != NULL ? *api->versions[j] : 0;
+
+    slot = api->cache + (hash & (apivalue_command_cache_slots - 1));
+    entry = *slot;
+    if (entry != NULL && entry->hash == hash && memcmp(entry->versions, versions, sizeof versions) == 0 && key_matches(entry, command->name, argc, argv))
+      {
+        if (entry->output_length > 0 && stdio_api->fwrite(stdio_api, cache_text(entry) + entry->key_length, 1, entry->output_length, stdout) != entry->output_length)
+          return EXIT_FAILURE;
+        return EXIT_SUCCESS;
+      }
+
+    old_output = stdio_api->output;
+    stdio_api->initialize_chain(stdio_api, &chain, stdlib_api);
+    stdio_api->output = &chain;
+    rv = run_handler(api, command, argc, argv);
+    stdio_api->output = old_output;
+
+    /* The output was already counted, while it was being kept */
+    bytes = stdio_api->output_bytes;
+    entry = NULL;
+    if (rv == EXIT_SUCCESS && chain.length <= apivalue_command_cache_output_limit)
+      entry = stdlib_api->malloc(stdlib_api, sizeof *entry + key_length + chain.length);
+    stdio_api->initialize_cursor(stdio_api, &cursor, &chain);
+    if (entry != NULL)
+      {
+        entry->hash = hash;
+        memcpy(entry->versions, versions, sizeof versions);
+        entry->key_length = key_length;
+        entry->output_length = chain.length;
+        mem = cache_text(entry);
+        for (i = 0; i < argc; ++i)
+          {
+            name = i == 0 ? command->name : argv[i];
+            j = strlen(name) + 1;
+            memcpy(mem, name, j);
+            mem += j;
+          }
+        while ((stdio_rv = stdio_api->read_line(stdio_api, &cursor, &line)) == apivalue_stdio_success)
+          {
+            memcpy(mem, line.text, line.length);
+            mem += line.length;
+          }
+        if (stdio_rv == apivalue_stdio_end_of_chain)
+          {
+            if (entry->output_length > 0 && stdio_api->fwrite(stdio_api, cache_text(entry) + key_length, 1, entry->output_length, stdout) != entry->output_length)
+              rv = EXIT_FAILURE;
+            stdlib_api->free(stdlib_api, *slot);
+            *slot = entry;
+          }
+          else
+          {
+            stdlib_api->free(stdlib_api, entry);
+            entry = NULL;
+            stdio_api->initialize_cursor(stdio_api, &cursor, &chain);
+          }
+      }
+    if (entry == NULL)
+      {
+        while ((stdio_rv = stdio_api->read_line(stdio_api, &cursor, &line)) == apivalue_stdio_success)
+          {
+            if (stdio_api->share(stdio_api, line.segment, line.text, line.length, stdout) != line.length)
+              rv = EXIT_FAILURE;
+          }
+        if (stdio_rv != apivalue_stdio_end_of_chain)
+          {
+            (void) stdio_api->fprintf(stdio_api, stderr, "Out of memory while writing output of '%s'\n", command->name);
+            rv = EXIT_FAILURE;
+          }
+      }
+    stdio_api->release_cursor(stdio_api, &cursor);
+    stdio_api->release_chain(stdio_api, &chain);
+    stdio_api->output_bytes = bytes;
+    return rv;
+  }
+
+/*
+ * Standard output of the line before '>' goes to the file named after it,
+ * which is replaced, or after '>>', which is appended to.  It's gathered in
+ * a sink and written in large pieces, straight to the file's descriptor
+ */
+static int run_redirected(struct api_command * api, const char * cmd, size_t cmd_len, size_t angle)
+  {
+    int append;
+    enum apivalue_command command_rv;
+    size_t count;
+#if CMDCTOY_POSIX
+    int descriptor;
+#else
+    FILE * file;
+#endif /* CMDCTOY_POSIX */
+    struct stdio_chain * old_output;
+    struct stdio_sink * old_sink;
+    char * path;
+    int rv;
+    struct stdio_sink sink;
+    size_t start;
+    struct api_stdio * stdio_api;
+    struct command_token token;
+    int write_rv;
+
+    stdio_api = api->api_stdio;
+    start = angle + 1;
+    append = start < cmd_len && cmd[start] == '>';
+    if (append)
+      ++start;
+    command_rv = api->tokenize(api, cmd + start, cmd_len - start, &token, 1, &count);
+    if (command_rv == apivalue_command_error_unterminated_quote)
+      {
+        (void) stdio_api->fprintf(stdio_api, stderr, "Unterminated quote, so command has been ignored\n");
+        return EXIT_FAILURE;
+      }
+    if (command_rv != apivalue_command_success || count != 1 || is_blank(cmd, angle))
+      {
+        (void) stdio_api->fprintf(stdio_api, stderr, "Redirection needs a command before it and one file name after it, so command has been ignored\n");
+        return EXIT_FAILURE;
+      }
+    path = api->api_stdlib->malloc(api->api_stdlib, token.length + 1);
+    if (path == NULL)
+      {
+        (void) stdio_api->fprintf(stdio_api, stderr, "Out of memory for file name, so command has been ignored\n");
+        return EXIT_FAILURE;
+      }
+    if (token.decode)
+      path[decode_token(&token, path)] = '\0';
+      else
+      {
+        memcpy(path, token.text, token.length);
+        path[token.length] = '\0';
+      }
+
+#if CMDCTOY_POSIX
+    descriptor = open(path, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0666);
+    if (descriptor == -1)
+      {
+        (void) stdio_api->fprintf(stdio_api, stderr, "Unable to open '%s', with POSIX errno '%d' and strerror message '%s'\n", path, errno, strerror(errno));
+        rv = EXIT_FAILURE;
+        goto err_open;
+      }
+    stdio_api->initialize_sink(stdio_api, &sink, apivalue_stdio_sink_descriptor, api->api_stdlib);
+    sink.descriptor = descriptor;
+#else
+    file = fopen(path, append ? "ab" : "wb");
+    if (file == NULL)
+      {
+        (void) stdio_api->fprintf(stdio_api, stderr, "Unable to open '%s'\n", path);
+        rv = EXIT_FAILURE;
+        goto err_open;
+      }
+    stdio_api->initialize_sink(stdio_api, &sink, apivalue_stdio_sink_file, api->api_stdlib);
+    sink.file = file;
+#endif /* CMDCTOY_POSIX */
+
+    /* Even within a pipeline or a job, this line's output goes to the file */
+    old_output = stdio_api->output;
+    old_sink = stdio_api->sink;
+    stdio_api->output = NULL;
+    stdio_api->sink = &sink;
+    rv = run_line(api, cmd, angle);
+    stdio_api->output = old_output;
+    stdio_api->sink = old_sink;
+
+    write_rv = stdio_api->release_sink(stdio_api, &sink);
+#if CMDCTOY_POSIX
+    if (api->sync_redirections && fsync(descriptor) != 0)
+      write_rv = EXIT_FAILURE;
+    if (close(descriptor) != 0)
+      write_rv = EXIT_FAILURE;
+#else
+    if (fclose(file) != 0)
+      write_rv = EXIT_FAILURE;
+#endif /* CMDCTOY_POSIX */
+    if (write_rv != EXIT_SUCCESS)
+      {
+        (void) stdio_api->fprintf(stdio_api, stderr, "Unable to write all output to '%s'\n", path);
+        rv = EXIT_FAILURE;
+      }
+
+    err_open:
+    api->api_stdlib->free(api->api_stdlib, path);
+    return rv;
+  }
+
+/*
+ * Within quotes, nothing is found.  The position is the length if nothing
+ * is found, and also if the text ends within quotes, which is reported
+ */
+static enum apivalue_command scan(struct api_command * api, const char * line, size_t length, const char * stops, size_t * position)
+  {
+    (void) api;
+
+    if (line == NULL || stops == NULL || position == NULL)
+      return apivalue_command_error_null_argument;
+    return scan_text(line, length, stops, position, NULL);
+  }
+
+/*
+ * The one place that knows the quoting rules.  Quoted text is skipped in a
+ * loop of its own.  'decode' is set if a quote or backslash is passed
+ */
+static enum apivalue_command scan_text(const char * line, size_t length, const char * stops, size_t * position, int * decode)
+  {
+    int blanks;
+    char c;
+    size_t i;
+    int passed;
+
+    blanks = strchr(stops, ' ') != NULL;
+    passed = 0;
+    for (i = 0; i < length; ++i)
+      {
+        c = line[i];
+        /* Most characters are letters and digits, which are never stops */
+        if (isalnum((unsigned char) c))
+          continue;
+        if (blanks && (c == '\0' || isspace((unsigned char) c)))
+          break;
+        if (c == '\\')
+          {
+            passed = 1;
+            if (i + 1 < length)
+              ++i;
+          }
+          else if (c == '\'')
+          {
+            passed = 1;
+            for (++i; i < length && line[i] != '\''; ++i)
+              ;
+            if (i == length)
+              goto err_unterminated;
+          }
+          else if (c == '"')
+          {
+            passed = 1;
+            for (++i; i < length && line[i] != '"'; ++i)
+              {
+                if (line[i] == '\\' && i + 1 < length && (line[i + 1] == '"' || line[i + 1] == '\\'))
+                  ++i;
+              }
+            if (i == length)
+              goto err_unterminated;
+          }
+          else if (c != '\0' && strchr(stops, c) != NULL)
+          {
+            break;
+          }
+      }
+    *position = i;
+    if (decode != NULL)
+      *decode = passed;
+    return apivalue_command_success;
+
+    err_unterminated:
+    *position = length;
+    if (decode != NULL)
+      *decode = passed;
+    return apivalue_command_error_unterminated_quote;
+  }
+
+/*
+ * Arguments are separated by white-space.  Within an argument, a backslash
+ * escapes the next character, single quotes keep everything literally and
+ * double quotes keep everything but a backslash before a double quote or a
+ * backslash.  The caller's buffer is never modified and needn't be null-
+ * terminated.  Fills up to 'capacity' tokens, but always counts them all
+ */
+static enum apivalue_command tokenize(struct api_command * api, const char * line, size_t length, struct command_token * tokens, size_t capacity, size_t * count)
+  {
+    enum apivalue_command command_rv;
+    int decode;
+    size_t end;
+    size_t i;
+    size_t start;
+    size_t total;
+
+    (void) api;
+
+    if (line == NULL || count == NULL || (tokens == NULL && capacity > 0))
+      return apivalue_command_error_null_argument;
+    total = 0;
+    i = 0;
+    while (1)
+      {
+        while (i < length && (line[i] == '\0' || isspace((unsigned char) line[i])))
+          ++i;
+        if (i == length)
+          break;
+        start = i;
+        command_rv = scan_text(line + start, length - start, " ", &end, &decode);
+        if (command_rv != apivalue_command_success)
+          {
+            *count = total;
+            return command_rv;
+          }
+        i = start + end;
+        if (total < capacity)
+          {
+            tokens[total].text = line + start;
+            tokens[total].length = end;
+            tokens[total].decode = decode;
+          }
+        ++total;
+      }
+    *count = total;
+    return total > capacity ? apivalue_command_error_buffer_too_small : apivalue_command_success;
+  }
@@ -10,19 +10,37 @@
 enum apivalue_command
   {
     apivalue_command_success,
+    apivalue_command_error_buffer_too_small,
     apivalue_command_error_null_argument,
-    apivalue_command_max_argc = 11,
-    apivalue_command_zero = 0
+    apivalue_command_error_unterminated_quote,
+    apivalue_command_zero = 0,
+    /* For a command's flags: the output only depends on the arguments and the versioned state */
+    apivalue_command_flag_pure = 1,
+    /* How many pure commands' outputs are kept at once */
+    apivalue_command_cache_slots = 64,
+    /* Larger outputs aren't kept */
+    apivalue_command_cache_output_limit = 65536,
+    apivalue_command_versions = 4
   };
 
 struct command;
+struct command_cache_entry;
+struct command_token;
 struct api_command;
+struct api_stdlib;
+struct stdio_chain;
 
 typedef int apifunction_command(struct api_command *, struct command *, int, char **);
 typedef int apifunction_command_add(struct api_command *, struct command *);
 typedef enum apivalue_command apifunction_command_api_initialize(struct api_command *);
-typedef int apifunction_command_line(struct api_command *, char *, size_t);
+typedef int apifunction_command_background(struct api_command *, const char *, size_t);
+typedef struct command * apifunction_command_find(struct api_command *, const char *);
+typedef int apifunction_command_line(struct api_command *, const char *, size_t);
+typedef struct command * const * apifunction_command_match(struct api_command *, const char *, size_t *);
 typedef int apifunction_command_remove(struct api_command *, struct command *);
+typedef int apifunction_command_reply(struct api_command *, const char *, size_t, struct api_stdlib *, char **, size_t *, size_t *);
+typedef enum apivalue_command apifunction_command_scan(struct api_command *, const char *, size_t, const char *, size_t *);
+typedef enum apivalue_command apifunction_command_tokenize(struct api_command *, const char *, size_t, struct command_token *, size_t, size_t *);
 
 extern apifunction_command_api_initialize api_command_initialize;
 
@@ -32,17 +50,74 @@ struct command
     const char * name;
     apifunction_command * handler;
     struct list_item list_item;
+    /* Next in the same hash bucket */
+    struct command * hash_next;
+    /* An earlier command of the same name, restored when this one is removed */
+    struct command * shadowed;
+    size_t hash;
+    unsigned int flags;
   };
 
 struct api_command
   {
     struct api_list * api_list;
     struct api_stdio * api_stdio;
+    struct api_stdlib * api_stdlib;
     apifunction_command_api_initialize * api_initialize;
     apifunction_command_add * add;
+    /* Runs a command-line that ended with '&', when set by a module */
+    apifunction_command_background * background;
+    apifunction_command_find * find;
     apifunction_command_line * line;
+    /* Finds the commands whose names start with a prefix, as a run of the index */
+    apifunction_command_match * match;
+    /* When set by a module, handlers are called through this, so that they can be measured */
+    apifunction_command * profile;
     apifunction_command_remove * remove;
+    /*
+     * Runs a command-line for a client and appends the reply to a buffer,
+     * which grows through the given 'api_stdlib': a line with the status and
+     * the lengths of the standard output and standard error, then both
+     */
+    apifunction_command_reply * reply;
+    /*
+     * Finds the first of some characters that isn't quoted nor escaped, by
+     * the same rules as 'tokenize'.  A space stands for any white-space
+     */
+    apifunction_command_scan * scan;
+    apifunction_command_tokenize * tokenize;
+    /* Every command, including shadowed ones, most recently added first */
     struct list commands;
+    /* Only the commands that would be dispatched to are in the buckets */
+    size_t bucket_count;
+    size_t command_count;
+    struct command ** buckets;
+    /* The same commands as in the buckets, sorted by name */
+    size_t index_capacity;
+    size_t index_count;
+    struct command ** index;
+    /* The output of the previous command in a pipeline, for a handler to read */
+    struct stdio_chain * input;
+    /* When non-zero, a file that output is redirected to is synchronized to storage before it's closed */
+    int sync_redirections;
+    /*
+     * Counters bumped by whatever owns some state, whenever it changes.
+     * A pure command's kept output is only replayed while none has changed
+     */
+    const unsigned long int * versions[apivalue_command_versions];
+    /* Kept outputs of pure commands, by hash of their name and arguments */
+    struct command_cache_entry ** cache;
+  };
+
+/*
+ * A view of an argument within a command-line.  Quotes and backslashes
+ * are still in the text, if 'decode' is set
+ */
+struct command_token
+  {
+    const char * text;
+    size_t length;
+    int decode;
   };
 
 #endif /* INC_COMMAND */
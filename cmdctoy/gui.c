@@ -1,20 +1,46 @@
 /*
  * Copyright (C) 2024 Shao Miller.  All rights reserved.
  */
+#if CMDCTOY_POSIX
+/* For fileno and read */
+#define _POSIX_C_SOURCE 200112L
+#endif /* CMDCTOY_POSIX */
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if CMDCTOY_POSIX
+#include <unistd.h>
+#endif /* CMDCTOY_POSIX */
 #include "builtins.h"
 #include "command.h"
 #include "toy.h"
+#include "toydef.h"
 #include "toyio.h"
 #include "toylib.h"
 #include "gui.h"
 #include "module.h"
 
+struct user_input;
+
+/* What's been read, but not yet run, is from 'start' to 'end' */
+struct user_input
+  {
+    struct work_item work_item;
+    char * buffer;
+    size_t capacity;
+    size_t start;
+    size_t end;
+    /* The last line ended with a '\r', so a '\n' might follow */
+    int after_return;
+    int at_end;
+    /* Standard input was waited for, so a read won't hold up other work */
+    int waited;
+  };
+
+static int fill_buffer(struct user_input *, FILE *);
 static func_work get_user_input;
-static int get_user_input_from_stream(struct work_item *, FILE *);
+static int get_user_input_from_stream(struct user_input *, FILE *);
 static func_module_event module_event;
 
 static struct top * ctx;
@@ -30,7 +56,7 @@ union module module =
       {
         module_signature,
         "2024120200",
-        1
+        apivalue_module_api_version
       },
       &module_event,
       {
@@ -43,6 +69,88 @@ union module module =
     }
   };
 
+static int fill_buffer(struct user_input * input, FILE * stream)
+  {
+    size_t capacity;
+    char * grown;
+    int new_errno;
+    int old_errno;
+#if CMDCTOY_POSIX
+    ssize_t count;
+#else
+    int fgetc_rv;
+    unsigned char uc;
+#endif /* CMDCTOY_POSIX */
+
+    /* Keep the unconsumed part of a line at the front */
+    if (input->start > 0)
+      {
+        memmove(input->buffer, input->buffer + input->start, input->end - input->start);
+        input->end -= input->start;
+        input->start = 0;
+      }
+    if (input->end == input->capacity)
+      {
+        capacity = input->capacity > 0 ? input->capacity * 2 : get_user_input_buffer_size;
+        if (capacity < input->capacity)
+          grown = NULL;
+          else
+          grown = ctx->api_stdlib->realloc(ctx->api_stdlib, input->buffer, capacity);
+        if (grown == NULL)
+          {
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory for a command longer than %lu characters, so input has been stopped\n", (unsigned long int) input->capacity);
+            return EXIT_FAILURE;
+          }
+        input->buffer = grown;
+        input->capacity = capacity;
+      }
+
+    /* POSIX wants read and fgetc to set errno upon error */
+    old_errno = errno;
+    errno = 0;
+#if CMDCTOY_POSIX
+    /* As much as is available, without stdio's buffering in between */
+    do
+      count = read(fileno(stream), input->buffer + input->end, input->capacity - input->end);
+    while (count < 0 && errno == EINTR);
+    new_errno = errno;
+    errno = old_errno;
+    if (count < 0)
+      goto err_read;
+    if (count == 0)
+      input->at_end = 1;
+    input->end += (size_t) count;
+#else
+    /* Without read, stop at a line's end, so as not to wait for more than a line */
+    while (input->end < input->capacity)
+      {
+        fgetc_rv = ctx->api_stdio->fgetc(ctx->api_stdio, stream);
+        if (fgetc_rv == EOF)
+          {
+            new_errno = errno;
+            errno = old_errno;
+            if (ctx->api_stdio->f_error(ctx->api_stdio, stream))
+              goto err_read;
+            input->at_end = 1;
+            break;
+          }
+        /* Deal with fgetc's unsigned char versus strings' unknown-signed char */
+        uc = (unsigned char) fgetc_rv;
+        input->buffer[input->end++] = *(char *) &uc;
+        if (fgetc_rv == '\n' || fgetc_rv == '\r')
+          break;
+      }
+    errno = old_errno;
+#endif /* CMDCTOY_POSIX */
+    return EXIT_SUCCESS;
+
+    err_read:
+    (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Error reading input stream, so input has been stopped\n");
+    if (new_errno != 0)
+      (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Possible POSIX errno '%d' with strerror message '%s'\n", new_errno, strerror(new_errno));
+    return EXIT_FAILURE;
+  }
+
 static int get_user_input(struct work_item * work_item)
   {
     if (*(ctx->shutdown_requested))
@@ -51,103 +159,89 @@ static int get_user_input(struct work_item * work_item)
     /* Otherwise, re-schedule to acquire the command after this one */
     (void) ctx->schedule_last(live_module, work_item, ctx->work_list);
 
-    return get_user_input_from_stream(work_item, stdin);
+    /* A script is running, so wait for it */
+    if (*(ctx->input_holds) > 0)
+      return EXIT_SUCCESS;
+
+    return get_user_input_from_stream(type_with_member_at_ptr(struct user_input, work_item, work_item), stdin);
   }
 
-static int get_user_input_from_stream(struct work_item * work_item, FILE * stream)
+/* Each call runs one command, which is passed along from where it was read into */
+static int get_user_input_from_stream(struct user_input * input, FILE * stream)
   {
-    char c;
-    char cmd_buf[BUFSIZ];
-    size_t cmd_len;
-    int fgetc_rv;
-    int new_errno;
-    int old_errno;
-    int rv;
-    unsigned char uc;
-
-    /* POSIX wants fgetc to set errno upon error */
-    old_errno = errno;
+    char * end;
+    size_t length;
+    char * line;
+    char * return_end;
 
-    for (cmd_len = 0; cmd_len < sizeof cmd_buf - 1; ++cmd_len)
+    while (1)
       {
-        /* For POSIX */
-        errno = 0;
-
-        fgetc_rv = ctx->api_stdio->fgetc(ctx->api_stdio, stream);
-
-        /* For POSIX */
-        new_errno = errno;
-        errno = old_errno;
-
-        if (fgetc_rv == EOF)
+        /* A '\n' right after a '\r' belongs to the line that the '\r' ended */
+        if (input->after_return && input->start < input->end)
           {
-            /* That's the end of looping, so de-schedule */
-            (void) ctx->api_list->remove_list_item(ctx->api_list, &work_item->list_item);
-            if (ctx->api_stdio->f_error(ctx->api_stdio, stream))
-              {
-                (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Error reading input stream, so command has been ignored\n");
-                if (new_errno != 0)
-                  (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Possible POSIX errno '%d' with strerror message '%s'\n", new_errno, strerror(new_errno));
-                return EXIT_FAILURE;
-              }
-            if (ctx->api_stdio->f_eof(ctx->api_stdio, stream))
+            if (input->buffer[input->start] == '\n')
+              ++input->start;
+            input->after_return = 0;
+          }
+        line = input->buffer + input->start;
+        length = input->end - input->start;
+        if (length > 0)
+          {
+            end = memchr(line, '\n', length);
+            /* Permit this kind of line-ending, too */
+            return_end = memchr(line, '\r', end != NULL ? (size_t) (end - line) : length);
+            if (return_end != NULL)
               {
-                if (cmd_len == 0)
-                  return EXIT_SUCCESS;
-                (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Command not terminated, so has been ignored\n");
-                return EXIT_FAILURE;
+                end = return_end;
+                input->after_return = 1;
               }
+            if (end != NULL)
+              break;
           }
-
-        /* Deal with fgetc's unsigned char versus strings' unknown-signed char */
-        uc = (unsigned char) fgetc_rv;
-        c = *(char *) &uc;
-
-        if (c == '\0')
+        if (input->at_end)
           {
-            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Null character found in input stream, so command has been ignored\n");
+            /* That's the end of looping, so de-schedule */
+            (void) ctx->api_list->remove_list_item(ctx->api_list, &input->work_item.list_item);
+            if (length == 0)
+              return EXIT_SUCCESS;
+            (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Command not terminated, so has been ignored\n");
             return EXIT_FAILURE;
           }
-
-        /* Permit and convert this kind of line-ending */
-        if (c == '\r')
+#if CMDCTOY_POSIX
+        if (!input->waited)
           {
-            c = '\n';
-            /* Optimization for a common follow-up */
-            fgetc_rv = ctx->api_stdio->fgetc(ctx->api_stdio, stream);
-            if (fgetc_rv != '\n')
-              (void) ctx->api_stdio->ungetc(ctx->api_stdio, fgetc_rv, stream);
+            (void) ctx->api_list->remove_list_item(ctx->api_list, &input->work_item.list_item);
+            (void) ctx->schedule_ready(live_module, &input->work_item, fileno(stream), apivalue_work_ready_readable);
+            input->waited = 1;
+            return EXIT_SUCCESS;
           }
-
-        cmd_buf[cmd_len] = c;
-
-        if (c == '\n')
+        input->waited = 0;
+#endif /* CMDCTOY_POSIX */
+        if (fill_buffer(input, stream) != EXIT_SUCCESS)
           {
-            /* Command termination */
-            ++cmd_len;
-            cmd_buf[cmd_len] = '\0';
-            break;
+            (void) ctx->api_list->remove_list_item(ctx->api_list, &input->work_item.list_item);
+            return EXIT_FAILURE;
           }
       }
+    length = (size_t) (end - line);
+    input->start += length + 1;
 
     /* Empty command? */
-    if (cmd_len == 1)
+    if (length == 0)
       return EXIT_SUCCESS;
 
-    /* Check for truncation */
-    if (cmd_len == sizeof cmd_buf - 1 && cmd_buf[cmd_len - 1] != '\n')
+    if (memchr(line, '\0', length) != NULL)
       {
-        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Command was truncated at %d characters, so has been ignored\n", (int) cmd_len);
+        (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Null character found in input stream, so command has been ignored\n");
         return EXIT_FAILURE;
       }
 
-    rv = ctx->api_command->line(ctx->api_command, cmd_buf, cmd_len);
-    return rv;
+    return ctx->api_command->line(ctx->api_command, line, length);
   }
 
 static int module_event(enum apivalue_module_event_type type, void * event_data)
   {
-    struct work_item * work_item;
+    struct user_input * input;
 
     switch (type)
       {
@@ -159,16 +253,26 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
 
         case apivalue_module_event_type_thread_started:
         ctx = event_data;
-        work_item = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *work_item);
-        if (work_item == NULL)
+        input = ctx->api_stdlib->malloc(ctx->api_stdlib, sizeof *input);
+        if (input == NULL)
           {
             (void) ctx->api_stdio->fprintf(ctx->api_stdio, stderr, "Out of memory while acquiring user-input work-item\n");
             return EXIT_FAILURE;
           }
-        live_module->module.v1.module_pointers[0] = work_item;
-        (void) ctx->api_list->initialize_list_item(ctx->api_list, &work_item->list_item);
-        work_item->work = &get_user_input;
-        (void) ctx->schedule_last(live_module, work_item, ctx->work_list);
+        live_module->module.v1.module_pointers[0] = input;
+        (void) ctx->api_list->initialize_list_item(ctx->api_list, &input->work_item.list_item);
+        input->work_item.work = &get_user_input;
+        /* The buffer is made upon the first read */
+        input->buffer = NULL;
+        input->capacity = 0;
+        input->start = 0;
+        input->end = 0;
+        input->after_return = 0;
+        input->at_end = 0;
+        input->waited = 0;
+        /* Without an interactive session, nothing reads standard input */
+        if (ctx->interactive)
+          (void) ctx->schedule_last(live_module, &input->work_item, ctx->work_list);
         return EXIT_SUCCESS;
 
         case apivalue_module_event_type_thread_stop_requested:
@@ -177,13 +281,14 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
         return EXIT_SUCCESS;
 
         case apivalue_module_event_type_unload:
-        work_item = live_module->module.v1.module_pointers[0];
-        if (work_item != NULL)
+        input = live_module->module.v1.module_pointers[0];
+        if (input != NULL)
           {
             /* Remove from schedule, if scheduled */
-            if (work_item->list_item.next != NULL)
-              (void) ctx->api_list->remove_list_item(ctx->api_list, &work_item->list_item);
-            ctx->api_stdlib->free(ctx->api_stdlib, work_item);
+            if (input->work_item.list_item.next != NULL)
+              (void) ctx->api_list->remove_list_item(ctx->api_list, &input->work_item.list_item);
+            ctx->api_stdlib->free(ctx->api_stdlib, input->buffer);
+            ctx->api_stdlib->free(ctx->api_stdlib, input);
           }
         live_module = NULL;
         return EXIT_SUCCESS;
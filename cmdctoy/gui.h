@@ -6,7 +6,9 @@
 
 enum
   {
-    get_user_input_zero = 0
+    get_user_input_zero = 0,
+    /* Input is read in chunks of this size, at least, and a longer line grows the buffer */
+    get_user_input_buffer_size = 65536
   };
 
 #endif /* INC_GET_USER_INPUT */
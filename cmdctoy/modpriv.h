@@ -4,6 +4,7 @@
 #ifndef INC_MODPRIV
 #define INC_MODPRIV
 
+#include "arena.h"
 #include "depend.h"
 #include "list.h"
 #include "module.h"
@@ -16,6 +17,8 @@ struct module_private
     struct dependency_want dependency_want;
     struct dependency_observe dependency_observe;
     unsigned long int order;
+    /* The module's allocations, as ctx.api_stdlib */
+    struct stdlib_arena arena;
     struct live_module live_module;
   };
 
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "arena.h"
 #include "depend.h"
 #include "toy.h"
 #include "toyio.h"
@@ -16,6 +17,8 @@
 
 static apifunction_dependency_observe_call live_module_cleanup;
 static func_module_live_module_from_module live_module_from_module;
+static void log_module(struct top *, const char *, union module *);
+static void log_status(struct top *, struct live_module *, const char *, int);
 static func_module_load module_load;
 static func_module_request_shutdown module_request_shutdown;
 static func_module_start_thread start_thread;
@@ -76,11 +79,14 @@ void initialize_module_system(struct top * top)
 
 static void live_module_cleanup(struct api_dependency * api, struct dependency * dependency, struct dependency_observe * dependency_observe, enum apivalue_dependency type, void * pointer)
   {
+    char bytes[32];
+    struct log_field fields[2];
     struct api_list * list_api;
     struct module_private * module_private;
     int module_rv;
+    char objects[32];
     struct live_module * old_module;
-    struct api_stdio * stdio_api;
+    const char * old_worker;
     struct api_stdlib * stdlib_api;
 
     (void) api;
@@ -95,25 +101,59 @@ static void live_module_cleanup(struct api_dependency * api, struct dependency *
     /* Otherwise, we have departed, so it's time to free the live_module */
     module_private = type_with_member_at_ptr(struct module_private, dependency_observe, dependency_observe);
     list_api = module_private->ctx.api_list;
-    stdio_api = module_private->ctx.api_stdio;
-    stdlib_api = module_private->ctx.api_stdlib;
+    stdlib_api = module_private->arena.parent;
     old_module = module_private->ctx.work_module;
     module_private->ctx.work_module = &module_private->live_module;
+    old_worker = set_memory_profile_worker(module_private->live_module.module.v1.nice_name);
     module_rv = module_private->live_module.module.v1.event_func(apivalue_module_event_type_unload, NULL);
+    (void) set_memory_profile_worker(old_worker);
     module_private->ctx.work_module = old_module;
     if (module_rv != EXIT_SUCCESS)
       {
-        (void) stdio_api->fprintf(stdio_api, stderr, "Module having nice-name '%s' failed to unload with return-value '%d'\n", module_private->live_module.module.v1.nice_name, module_rv);
+        log_status(&module_private->ctx, &module_private->live_module, "Module failed to unload", module_rv);
         /* Too bad.  It'll be unlinked, anyway */
       }
       else
       {
-        (void) stdio_api->fprintf(stdio_api, stderr, "Module having nice-name '%s' was unloaded\n", module_private->live_module.module.v1.nice_name);
+        module_private->ctx.log(&module_private->live_module, apivalue_log_level_notice, "Module was unloaded", NULL, 0);
+      }
+    /* Whatever the module didn't free is reported, then freed */
+    if (module_private->arena.objects > 0)
+      {
+        sprintf(objects, "%lu", module_private->arena.objects);
+        sprintf(bytes, "%lu", module_private->arena.bytes);
+        fields[0].key = "objects";
+        fields[0].value = objects;
+        fields[1].key = "bytes";
+        fields[1].value = bytes;
+        module_private->ctx.log(&module_private->live_module, apivalue_log_level_warning, "Module leaked memory", fields, countof(fields));
       }
+    release_arena(&module_private->arena);
     (void) list_api->remove_list_item(list_api, &module_private->list_item);
     stdlib_api->free(stdlib_api, module_private);
   }
 
+/* About a module that isn't live, on behalf of whichever module is working */
+static void log_module(struct top * top, const char * message, union module * module)
+  {
+    struct log_field field;
+
+    field.key = "module";
+    field.value = module->v1.nice_name;
+    top->log(top->work_module, apivalue_log_level_error, message, &field, 1);
+  }
+
+static void log_status(struct top * top, struct live_module * live_module, const char * message, int status)
+  {
+    struct log_field field;
+    char value[32];
+
+    sprintf(value, "%d", status);
+    field.key = "status";
+    field.value = value;
+    top->log(live_module, apivalue_log_level_error, message, &field, 1);
+  }
+
 static int live_module_from_module(struct top * top, union module * module, struct dependency_want * dependency_want, struct live_module ** live_module)
   {
     struct api_dependency * dependency_api;
@@ -123,7 +163,6 @@ static int live_module_from_module(struct top * top, union module * module, stru
     struct module_api * module_api;
     struct module_private * module_private;
     int need_free;
-    struct api_stdio * stdio_api;
     struct api_stdlib * stdlib_api;
 
     need_free = 0;
@@ -133,16 +172,16 @@ static int live_module_from_module(struct top * top, union module * module, stru
     module_api = top->module_api;
     dependency_api = module_api->api_dependency;
     list_api = module_api->api_list;
-    stdio_api = module_api->api_stdio;
     stdlib_api = module_api->api_stdlib;
     if (strncmp(module->v1.required.signature, module_signature, apivalue_module_signature_length) != 0)
       {
-        (void) stdio_api->fprintf(stdio_api, stderr, "Invalid signature for a module\n");
+        top->log(top->work_module, apivalue_log_level_error, "Invalid signature for a module", NULL, 0);
         return EXIT_FAILURE;
       }
-    if (module->v1.required.api_version < 1)
+    /* Older modules were built against structures that have since changed */
+    if (module->v1.required.api_version != apivalue_module_api_version)
       {
-        (void) stdio_api->fprintf(stdio_api, stderr, "Unsupported API version for a module\n");
+        log_module(top, "Unsupported API version for a module", module);
         return EXIT_FAILURE;
       }
     /* TODO: Locking */
@@ -156,7 +195,7 @@ static int live_module_from_module(struct top * top, union module * module, stru
             dependency_rv = dependency_api->want(dependency_api, &module_private->live_module.dependency, dependency_want);
             if (dependency_rv != apivalue_dependency_success)
               {
-                (void) stdio_api->fprintf(stdio_api, stderr, "Dependency API 'want' unexpectedly failed for existing module having nice-name '%s'\n", module->v1.nice_name);
+                log_module(top, "Dependency API 'want' unexpectedly failed for existing module", module);
                 return EXIT_FAILURE;
               }
             if (live_module != NULL)
@@ -167,14 +206,14 @@ static int live_module_from_module(struct top * top, union module * module, stru
     /* Check for wrap-around */
     if (order + 1 == 0)
       {
-        (void) stdio_api->fprintf(stdio_api, stderr, "Far too many live modules have been created, so could not create one for module having nice-name '%s'\n", module->v1.nice_name);
+        log_module(top, "Far too many live modules have been created, so could not create one", module);
         return EXIT_FAILURE;
       }
     /* Create one, to be freed after its user-count goes to 0 */
     module_private = stdlib_api->malloc(stdlib_api, sizeof *module_private);
     if (module_private == NULL)
       {
-        (void) stdio_api->fprintf(stdio_api, stderr, "Out of memory while loading module '%s'\n", module->v1.nice_name);
+        log_module(top, "Out of memory while loading module", module);
         goto err_module_private;
       }
     need_free = 1;
@@ -189,6 +228,9 @@ static int live_module_from_module(struct top * top, union module * module, stru
     module_private->live_module.origin = module;
     /* Copy the context */
     module_private->ctx = *top;
+    /* The module allocates from its own arena, within the program's */
+    initialize_arena(&module_private->arena, module->v1.nice_name, stdlib_api, list_api);
+    module_private->ctx.api_stdlib = &module_private->arena.api;
     /* Adjust the context to point to this newly-created module */
     module_private->ctx.work_module = &module_private->live_module;
     module_private->live_module.ctx = &module_private->ctx;
@@ -197,14 +239,14 @@ static int live_module_from_module(struct top * top, union module * module, stru
     dependency_rv = dependency_api->want(dependency_api, &module_private->live_module.dependency, dependency_want);
     if (dependency_rv != apivalue_dependency_success)
       {
-        (void) stdio_api->fprintf(stdio_api, stderr, "Dependency API 'want' unexpectedly failed for module having nice-name '%s'\n", module->v1.nice_name);
+        log_module(top, "Dependency API 'want' unexpectedly failed for module", module);
         goto err_want;
       }
     dependency_api->initialize_observe(dependency_api, &module_private->dependency_observe, &live_module_cleanup);
     dependency_rv = dependency_api->observe(dependency_api, &module_private->live_module.dependency, &module_private->dependency_observe);
     if (dependency_rv != apivalue_dependency_success)
       {
-        (void) stdio_api->fprintf(stdio_api, stderr, "Dependency API 'observe' unexpectedly failed for module having nice-name '%s'\n", module->v1.nice_name);
+        log_module(top, "Dependency API 'observe' unexpectedly failed for module", module);
         goto err_observe;
       }
     /* The clean-up observer will free, after this point */
@@ -233,26 +275,27 @@ static int module_load(struct top * top, struct live_module * live_module)
   {
     struct module_api * module_api;
     struct live_module * old_module;
+    const char * old_worker;
     int rv;
-    struct api_stdio * stdio_api;
 
     module_api = top->module_api;
-    stdio_api = module_api->api_stdio;
     if (live_module->loaded != 0)
       {
-        (void) stdio_api->fprintf(stdio_api, stderr, "Module already loaded\n");
+        top->log(live_module, apivalue_log_level_error, "Module already loaded", NULL, 0);
         return EXIT_FAILURE;
       }
     /* Push the current module context */
     old_module = top->work_module;
     /* Send the load-event to the module */
     top->work_module = live_module;
+    old_worker = set_memory_profile_worker(live_module->module.v1.nice_name);
     rv = live_module->module.v1.event_func(apivalue_module_event_type_loaded, live_module);
+    (void) set_memory_profile_worker(old_worker);
     /* Pop the module context */
     top->work_module = old_module;
     if (rv != EXIT_SUCCESS)
       {
-        (void) stdio_api->fprintf(stdio_api, stderr, "Module having nice-name '%s' loaded with return-value '%d'\n", live_module->module.v1.nice_name, rv);
+        log_status(top, live_module, "Module failed to load", rv);
         goto event_loaded_failed;
       }
     live_module->loaded = 1;
@@ -272,34 +315,34 @@ static void module_request_shutdown(struct top * top)
     struct module_private * module_private;
     int module_rv;
     struct live_module * old_module;
-    struct api_stdio * stdio_api;
+    const char * old_worker;
 
     module_api = top->module_api;
     list_api = module_api->api_list;
-    stdio_api = module_api->api_stdio;
     while ((list_item = list_api->remove_item_from_list_tail(list_api, &module_list)) != NULL)
       {
         module_private = type_with_member_at_ptr(struct module_private, list_item, list_item);
         old_module = top->work_module;
         top->work_module = &module_private->live_module;
+        old_worker = set_memory_profile_worker(module_private->live_module.module.v1.nice_name);
         module_rv = module_private->live_module.module.v1.event_func(apivalue_module_event_type_unload_requested, NULL);
+        (void) set_memory_profile_worker(old_worker);
         top->work_module = old_module;
         if (module_rv != EXIT_SUCCESS)
-          (void) stdio_api->fprintf(stdio_api, stderr, "Module having nice-name '%s' failed to respond to unload-request with return-value '%d'\n", module_private->live_module.module.v1.nice_name, module_rv);
+          log_status(top, &module_private->live_module, "Module failed to respond to unload-request", module_rv);
       }
   }
 
 static int module_thread_started(struct top * top, struct live_module * live_module)
   {
-    struct module_api * module_api;
     int module_rv;
-    struct api_stdio * stdio_api;
+    const char * old_worker;
 
-    module_api = top->module_api;
-    stdio_api = module_api->api_stdio;
+    old_worker = set_memory_profile_worker(live_module->module.v1.nice_name);
     module_rv = live_module->module.v1.event_func(apivalue_module_event_type_thread_started, live_module->ctx);
+    (void) set_memory_profile_worker(old_worker);
     if (module_rv != EXIT_SUCCESS)
-      (void) stdio_api->fprintf(stdio_api, stderr, "Module having nice-name '%s' failed thread-start with return-value '%d'\n", live_module->module.v1.nice_name, module_rv);
+      log_status(top, live_module, "Module failed thread-start", module_rv);
     return module_rv;
   }
 
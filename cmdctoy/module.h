@@ -24,6 +24,11 @@ enum apivalue_module_event_type
 
 enum apivalue_module
   {
+    /*
+     * Bumped whenever a structure that modules are built against changes,
+     * since a module built against another layout would misuse it
+     */
+    apivalue_module_api_version = 2,
     apivalue_module_pointer_count = 4,
     apivalue_module_serial_length = 10,
     apivalue_module_signature_length = sizeof module_signature - 1,
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+/* TODO: Support more than Linux */
+#if CMDCTOY_POSIX && defined(__linux__)
+/* For clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "shmchan.h"
+
+/*
+ * A client of a shared-memory channel that measures round trips: it sends
+ * a command-line, waits for the reply, and shows the percentiles of how long
+ * that took.  Build it with shmchan.c, then run 'shmchan start PATH' in the
+ * program and 'shmbench PATH [ROUNDS [COMMAND]]' beside it
+ */
+
+enum
+  {
+    bench_default_rounds = 100000,
+    /* Round trips before the measured ones, so that both sides are warm */
+    bench_warm_up = 1000,
+    bench_reply_size = 65536
+  };
+
+static int compare_times(const void *, const void *);
+static double now(void);
+static int round_trip(struct shmchan_client *, const char *, size_t, char *);
+
+static int compare_times(const void * left, const void * right)
+  {
+    double left_time;
+    double right_time;
+
+    left_time = *(const double *) left;
+    right_time = *(const double *) right;
+    return left_time < right_time ? -1 : left_time > right_time;
+  }
+
+int main(int argc, char ** argv)
+  {
+    struct shmchan_client client;
+    const char * command;
+    char * endptr;
+    size_t i;
+    size_t length;
+    char * reply;
+    unsigned long int rounds;
+    double start;
+    double * times;
+    double total;
+
+    if (argc < 2 || argc > 4)
+      {
+        fprintf(stderr, "Usage: %s PATH [ROUNDS [COMMAND]]\n", argv[0]);
+        return EXIT_FAILURE;
+      }
+    rounds = bench_default_rounds;
+    if (argc >= 3)
+      {
+        rounds = strtoul(argv[2], &endptr, 0);
+        if (*argv[2] == '\0' || *endptr != '\0' || rounds == 0 || rounds > (size_t) -1 / sizeof *times)
+          {
+            fprintf(stderr, "Specified rounds does not appear to be a positive 'unsigned long int'\n");
+            return EXIT_FAILURE;
+          }
+      }
+    /* An empty command-line measures the channel itself */
+    command = argc == 4 ? argv[3] : "";
+    length = strlen(command);
+    if (memchr(command, '\n', length) != NULL)
+      {
+        fprintf(stderr, "The command-line can't have a new-line in it\n");
+        return EXIT_FAILURE;
+      }
+
+    times = malloc(rounds * sizeof *times);
+    reply = malloc(bench_reply_size);
+    if (times == NULL || reply == NULL)
+      {
+        fprintf(stderr, "Out of memory for the measurements\n");
+        goto err_memory;
+      }
+    if (shmchan_open(&client, argv[1]) != EXIT_SUCCESS)
+      {
+        fprintf(stderr, "Unable to attach to a channel at '%s'\n", argv[1]);
+        goto err_memory;
+      }
+
+    for (i = 0; i < bench_warm_up; ++i)
+      {
+        if (round_trip(&client, command, length, reply) != EXIT_SUCCESS)
+          goto err_round_trip;
+      }
+    total = 0;
+    for (i = 0; i < rounds; ++i)
+      {
+        start = now();
+        if (round_trip(&client, command, length, reply) != EXIT_SUCCESS)
+          goto err_round_trip;
+        times[i] = now() - start;
+        total += times[i];
+      }
+    shmchan_close(&client);
+
+    qsort(times, rounds, sizeof *times, &compare_times);
+    printf("shmbench: %lu round trips in %.3f s, %.0f per second\n", rounds, total, total > 0 ? rounds / total : 0.0);
+    printf("shmbench: min %.1f us, p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n", times[0] * 1e6, times[(size_t) ((rounds - 1) * 0.5)] * 1e6, times[(size_t) ((rounds - 1) * 0.99)] * 1e6, times[(size_t) ((rounds - 1) * 0.999)] * 1e6, times[rounds - 1] * 1e6);
+    free(reply);
+    free(times);
+    return EXIT_SUCCESS;
+
+    err_round_trip:
+    fprintf(stderr, "The channel's reply couldn't be understood\n");
+    shmchan_close(&client);
+    err_memory:
+    free(reply);
+    free(times);
+    return EXIT_FAILURE;
+  }
+
+/* In seconds, from some fixed point */
+static double now(void)
+  {
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+      return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+    return (double) clock() / CLOCKS_PER_SEC;
+  }
+
+static int round_trip(struct shmchan_client * client, const char * command, size_t length, char * reply)
+  {
+    size_t error_length;
+    size_t output_length;
+    int status;
+
+    if (shmchan_send(client, command, length) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    return shmchan_receive(client, &status, reply, bench_reply_size, &output_length, &error_length);
+  }
+
+#endif /* CMDCTOY_POSIX && defined(__linux__) */
@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+/* TODO: Support more than Linux */
+#if CMDCTOY_POSIX && defined(__linux__)
+/* For flock, kill and syscall */
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "shmchan.h"
+
+static int await_change(struct shmchan *, volatile unsigned int *, unsigned int, volatile unsigned int *);
+static void barrier(void);
+static size_t read_reply(struct shmchan_client *, void *, size_t);
+static int ring_bell(struct shmchan_client *);
+static int server_gone(struct shmchan *, int);
+
+/* Spins for a while, then sleeps until woken by the other side.  Fails if the server's gone */
+static int await_change(struct shmchan * channel, volatile unsigned int * word, unsigned int seen, volatile unsigned int * waiting)
+  {
+    int rv;
+    int slept;
+    unsigned int spins;
+
+    for (spins = shmchan_should_spin() ? 0 : shmchan_spins; spins < shmchan_spins; ++spins)
+      {
+        barrier();
+        if (*word != seen)
+          return EXIT_SUCCESS;
+      }
+    rv = EXIT_SUCCESS;
+    slept = 0;
+    while (1)
+      {
+        *waiting = 1;
+        barrier();
+        if (*word != seen)
+          break;
+        if (server_gone(channel, slept))
+          {
+            rv = EXIT_FAILURE;
+            break;
+          }
+        shmchan_wait(word, seen);
+        slept = 1;
+      }
+    *waiting = 0;
+    barrier();
+    return rv;
+  }
+
+static void barrier(void)
+  {
+    __sync_synchronize();
+  }
+
+/* Rings the bell if the server is waiting for room to reply */
+static size_t read_reply(struct shmchan_client * client, void * buffer, size_t size)
+  {
+    size_t count;
+    struct shmchan_ring * ring;
+
+    ring = &client->channel->replies;
+    count = shmchan_read(client->channel, ring, buffer, size);
+    if (count > 0 && ring->producer_waiting)
+      (void) ring_bell(client);
+    return count;
+  }
+
+/* The bell can be full, but then the server is due to wake anyway */
+static int ring_bell(struct shmchan_client * client)
+  {
+    if (write(client->bell, "", 1) < 0 && errno != EAGAIN)
+      return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+  }
+
+/*
+ * A server that stops says so, but one that's crashed or been killed can't,
+ * so its process is checked, too, though only when asked to, since that's a
+ * system call
+ */
+static int server_gone(struct shmchan * channel, int check_process)
+  {
+    barrier();
+    if (channel->closed)
+      return 1;
+    return check_process && kill((pid_t) channel->server_process, 0) != 0 && errno == ESRCH;
+  }
+
+/*
+ * For the server: if a client has attached since last time, this empties
+ * the rings, lets the client go ahead and returns non-zero, so the server
+ * can drop what it's kept from before
+ */
+int shmchan_accept(struct shmchan * channel)
+  {
+    struct shmchan_ring * rings[2];
+    size_t i;
+
+    if (channel->attached == channel->attaches)
+      return 0;
+    rings[0] = &channel->requests;
+    rings[1] = &channel->replies;
+    for (i = 0; i < 2; ++i)
+      {
+        rings[i]->head = 0;
+        rings[i]->tail = 0;
+        rings[i]->consumer_waiting = 0;
+        rings[i]->producer_waiting = 0;
+      }
+    barrier();
+    channel->attached = channel->attaches;
+    barrier();
+    shmchan_wake(&channel->attached);
+    return 1;
+  }
+
+size_t shmchan_read(struct shmchan * channel, struct shmchan_ring * ring, void * buffer, size_t size)
+  {
+    char * data;
+    size_t first;
+    size_t offset;
+    size_t used;
+
+    used = shmchan_ring_used(channel, ring);
+    if (size > used)
+      size = used;
+    if (size == 0)
+      return 0;
+    data = shmchan_ring_data(channel, ring);
+    offset = ring->tail & (channel->ring_size - 1);
+    first = channel->ring_size - offset;
+    if (first > size)
+      first = size;
+    memcpy(buffer, data + offset, first);
+    memcpy((char *) buffer + first, data, size - first);
+    /* The bytes are copied before the space is given back */
+    barrier();
+    ring->tail += (unsigned int) size;
+    barrier();
+    /* Only a client sleeps on a futex.  The server sleeps on the bell, which the client rings */
+    if (ring == &channel->requests && ring->producer_waiting)
+      shmchan_wake(&ring->tail);
+    return size;
+  }
+
+/* Returns non-zero if the consumer should sleep, since there's still nothing to read */
+int shmchan_ready_to_sleep(struct shmchan * channel, struct shmchan_ring * ring)
+  {
+    ring->consumer_waiting = 1;
+    barrier();
+    if (shmchan_ring_used(channel, ring) == 0)
+      return 1;
+    ring->consumer_waiting = 0;
+    return 0;
+  }
+
+/* Returns non-zero if the producer should sleep, since there's still no room to write */
+int shmchan_ready_to_sleep_for_room(struct shmchan * channel, struct shmchan_ring * ring)
+  {
+    ring->producer_waiting = 1;
+    barrier();
+    if (shmchan_ring_used(channel, ring) == channel->ring_size)
+      return 1;
+    ring->producer_waiting = 0;
+    return 0;
+  }
+
+/*
+ * Spinning only helps while the other side runs on another processor.
+ * With just one, it keeps the other side from running
+ */
+int shmchan_should_spin(void)
+  {
+    static int should_spin = -1;
+
+    if (should_spin < 0)
+      should_spin = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+    return should_spin;
+  }
+
+char * shmchan_ring_data(struct shmchan * channel, struct shmchan_ring * ring)
+  {
+    char * data;
+
+    data = (char *) (channel + 1);
+    if (ring == &channel->replies)
+      data += channel->ring_size;
+    return data;
+  }
+
+size_t shmchan_ring_used(struct shmchan * channel, struct shmchan_ring * ring)
+  {
+    size_t used;
+
+    (void) channel;
+
+    used = ring->head - ring->tail;
+    barrier();
+    return used;
+  }
+
+size_t shmchan_size(void)
+  {
+    return sizeof (struct shmchan) + 2 * (size_t) shmchan_ring_size;
+  }
+
+/* For the server: lets a waiting client know that the channel is closed */
+void shmchan_stop(struct shmchan * channel)
+  {
+    channel->closed = 1;
+    barrier();
+    shmchan_wake(&channel->attached);
+    shmchan_wake(&channel->requests.tail);
+    shmchan_wake(&channel->replies.head);
+  }
+
+/* Gives up after a while, so that the caller can check on the server */
+void shmchan_wait(volatile unsigned int * word, unsigned int value)
+  {
+    struct timespec timeout;
+
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = shmchan_check_interval * 1000000L;
+    /* Shared between processes, so not FUTEX_PRIVATE_FLAG */
+    (void) syscall(SYS_futex, (void *) word, FUTEX_WAIT, value, &timeout, NULL, 0);
+  }
+
+void shmchan_wake(volatile unsigned int * word)
+  {
+    (void) syscall(SYS_futex, (void *) word, FUTEX_WAKE, 1, NULL, NULL, 0);
+  }
+
+size_t shmchan_write(struct shmchan * channel, struct shmchan_ring * ring, const void * buffer, size_t size)
+  {
+    char * data;
+    size_t first;
+    size_t free_space;
+    size_t offset;
+
+    free_space = channel->ring_size - shmchan_ring_used(channel, ring);
+    if (size > free_space)
+      size = free_space;
+    if (size == 0)
+      return 0;
+    data = shmchan_ring_data(channel, ring);
+    offset = ring->head & (channel->ring_size - 1);
+    first = channel->ring_size - offset;
+    if (first > size)
+      first = size;
+    memcpy(data + offset, buffer, first);
+    memcpy(data, (const char *) buffer + first, size - first);
+    /* The bytes are in place before they're announced */
+    barrier();
+    ring->head += (unsigned int) size;
+    barrier();
+    /* As for reading, the server's own waiting is left to the bell */
+    if (ring == &channel->replies && ring->consumer_waiting)
+      shmchan_wake(&ring->head);
+    return size;
+  }
+
+/* Client */
+
+void shmchan_close(struct shmchan_client * client)
+  {
+    (void) munmap((void *) client->channel, client->size);
+    (void) close(client->bell);
+    (void) close(client->descriptor);
+  }
+
+/* Fails if the server isn't serving at 'path', or if another client is attached */
+int shmchan_open(struct shmchan_client * client, const char * path)
+  {
+    unsigned int attaches;
+    char * bell_path;
+    int descriptor;
+    void * mapping;
+    unsigned int seen;
+    struct stat status;
+
+    descriptor = open(path, O_RDWR);
+    if (descriptor < 0)
+      return EXIT_FAILURE;
+    /* Released by the system, too, if the client exits without closing */
+    if (flock(descriptor, LOCK_EX | LOCK_NB) != 0)
+      goto err_lock;
+    if (fstat(descriptor, &status) != 0 || (size_t) status.st_size < shmchan_size())
+      goto err_lock;
+    mapping = mmap(NULL, shmchan_size(), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    if (mapping == MAP_FAILED)
+      goto err_lock;
+    client->channel = mapping;
+    client->size = shmchan_size();
+    client->descriptor = descriptor;
+    if (client->channel->signature != shmchan_signature || client->channel->ring_size != shmchan_ring_size)
+      goto err_bell;
+
+    bell_path = malloc(strlen(path) + sizeof ".bell");
+    if (bell_path == NULL)
+      goto err_bell;
+    strcpy(bell_path, path);
+    strcat(bell_path, ".bell");
+    /* Without a reader, this fails */
+    client->bell = open(bell_path, O_WRONLY | O_NONBLOCK);
+    free(bell_path);
+    if (client->bell < 0)
+      goto err_bell;
+
+    /* Wait for the server to empty the rings */
+    attaches = client->channel->attaches + 1;
+    client->channel->attaches = attaches;
+    barrier();
+    if (ring_bell(client) != EXIT_SUCCESS)
+      goto err_attach;
+    while ((seen = client->channel->attached) != attaches)
+      {
+        if (server_gone(client->channel, 1))
+          goto err_attach;
+        shmchan_wait(&client->channel->attached, seen);
+      }
+    return EXIT_SUCCESS;
+
+    err_attach:
+    (void) close(client->bell);
+    err_bell:
+    (void) munmap(mapping, client->size);
+    err_lock:
+    (void) close(descriptor);
+    return EXIT_FAILURE;
+  }
+
+/*
+ * Waits for a reply.  Up to 'capacity' bytes of the standard output, then
+ * the standard error, are kept, and both of their full lengths are given.
+ * Fails if the server's gone before all of the reply is there
+ */
+int shmchan_receive(struct shmchan_client * client, int * status, char * buffer, size_t capacity, size_t * length, size_t * error_length)
+  {
+    struct shmchan * channel;
+    char discard[256];
+    char * endptr;
+    char header[64];
+    size_t i;
+    size_t count;
+    unsigned long int error_size;
+    unsigned long int output_size;
+    struct shmchan_ring * ring;
+    unsigned long int total;
+
+    channel = client->channel;
+    ring = &channel->replies;
+    for (i = 0; i < sizeof header - 1; ++i)
+      {
+        while (read_reply(client, header + i, 1) == 0)
+          {
+            if (await_change(channel, &ring->head, ring->tail, &ring->consumer_waiting) != EXIT_SUCCESS)
+              return EXIT_FAILURE;
+          }
+        if (header[i] == '\n')
+          break;
+      }
+    header[i] = '\0';
+    *status = (int) strtol(header, &endptr, 10);
+    output_size = strtoul(endptr, &endptr, 10);
+    error_size = strtoul(endptr, &endptr, 10);
+    total = output_size + error_size;
+    if (i == sizeof header - 1 || *endptr != '\0' || total < output_size)
+      return EXIT_FAILURE;
+
+    *length = output_size;
+    *error_length = error_size;
+    for (i = 0; i < total; i += count)
+      {
+        if (i < capacity)
+          count = read_reply(client, buffer + i, capacity - i < total - i ? capacity - i : total - i);
+          else
+          count = read_reply(client, discard, sizeof discard < total - i ? sizeof discard : total - i);
+        if (count == 0 && await_change(channel, &ring->head, ring->tail, &ring->consumer_waiting) != EXIT_SUCCESS)
+          return EXIT_FAILURE;
+      }
+    return EXIT_SUCCESS;
+  }
+
+/* Sends a command-line, which mustn't have a '\n' in it.  Fails if the server's gone */
+int shmchan_send(struct shmchan_client * client, const char * line, size_t length)
+  {
+    struct shmchan * channel;
+    size_t count;
+    size_t i;
+    struct shmchan_ring * ring;
+
+    channel = client->channel;
+    ring = &channel->requests;
+    if (server_gone(channel, 0))
+      return EXIT_FAILURE;
+    for (i = 0; i <= length; i += count)
+      {
+        count = shmchan_write(channel, ring, i < length ? line + i : "\n", i < length ? length - i : 1);
+        /* When full, the consumer is a whole ring behind */
+        if (count == 0 && await_change(channel, &ring->tail, ring->head - channel->ring_size, &ring->producer_waiting) != EXIT_SUCCESS)
+          return EXIT_FAILURE;
+      }
+    /* Wake the server, if it's sleeping */
+    barrier();
+    if (ring->consumer_waiting && ring_bell(client) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+  }
+
+#endif /* CMDCTOY_POSIX && defined(__linux__) */
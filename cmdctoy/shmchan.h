@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+#ifndef INC_SHMCHAN
+#define INC_SHMCHAN
+
+#include <stddef.h>
+
+/*
+ * A shared-memory channel is a file that a server and one client both map.
+ * It holds two single-producer, single-consumer rings of bytes: command-lines
+ * from the client and replies from the server.  A reply is a line with the
+ * command's status and the lengths of its standard output and standard
+ * error, then both, just as for the 'server' command.
+ *
+ * Neither side makes a system call while the other keeps up.  A side that
+ * runs out of things to do, or of room, marks itself as waiting, then
+ * sleeps: a client on a futex and the server in the scheduler, on a FIFO at
+ * the channel's path with ".bell" appended.  The other side only wakes it
+ * when it's marked, with the futex or the bell, whichever the sleeper is
+ * waiting on.
+ *
+ * A client locks the file while it's attached, so that a second one can't
+ * be, and so that the server can tell when it's gone and drop what was
+ * meant for it.  Upon attaching, it waits for the server to empty both
+ * rings, so that nothing meant for a client before it is left over.
+ *
+ * A client that's waiting gives up once the server stops or its process
+ * has ended, and so does anything it tries afterwards
+ */
+
+enum
+  {
+    shmchan_signature = 0x53484D33,
+    /* Of each ring, which must be a power of 2 */
+    shmchan_ring_size = 65536,
+    /* How many times to check before sleeping */
+    shmchan_spins = 4096,
+    /* How long a client sleeps before checking that the server's still there, in milliseconds */
+    shmchan_check_interval = 100,
+    shmchan_zero = 0
+  };
+
+struct shmchan;
+struct shmchan_client;
+struct shmchan_ring;
+
+/* The counts wrap around, and the ring's size divides their range */
+struct shmchan_ring
+  {
+    /* Bytes ever written, advanced by the producer */
+    volatile unsigned int head;
+    /* Bytes ever read, advanced by the consumer */
+    volatile unsigned int tail;
+    /* Set by the consumer before it sleeps on 'head' */
+    volatile unsigned int consumer_waiting;
+    /* Set by the producer before it sleeps on 'tail' */
+    volatile unsigned int producer_waiting;
+  };
+
+/* The requests' bytes, then the replies' bytes, follow */
+struct shmchan
+  {
+    unsigned int signature;
+    unsigned int ring_size;
+    /* Advanced by each client that attaches */
+    volatile unsigned int attaches;
+    /* Set to 'attaches' by the server, once the rings are empty for that client */
+    volatile unsigned int attached;
+    /* Set by the server when it stops serving */
+    volatile unsigned int closed;
+    /* The server's process ID, for when it's ended without stopping */
+    long int server_process;
+    struct shmchan_ring requests;
+    struct shmchan_ring replies;
+  };
+
+struct shmchan_client
+  {
+    struct shmchan * channel;
+    size_t size;
+    int bell;
+    /* The channel's file, which is locked until it's closed */
+    int descriptor;
+  };
+
+extern int shmchan_accept(struct shmchan *);
+extern size_t shmchan_read(struct shmchan *, struct shmchan_ring *, void *, size_t);
+extern int shmchan_ready_to_sleep(struct shmchan *, struct shmchan_ring *);
+extern int shmchan_ready_to_sleep_for_room(struct shmchan *, struct shmchan_ring *);
+extern int shmchan_should_spin(void);
+extern char * shmchan_ring_data(struct shmchan *, struct shmchan_ring *);
+extern size_t shmchan_ring_used(struct shmchan *, struct shmchan_ring *);
+extern size_t shmchan_size(void);
+extern void shmchan_stop(struct shmchan *);
+extern void shmchan_wait(volatile unsigned int *, unsigned int);
+extern void shmchan_wake(volatile unsigned int *);
+extern size_t shmchan_write(struct shmchan *, struct shmchan_ring *, const void *, size_t);
+
+/* For clients */
+extern void shmchan_close(struct shmchan_client *);
+extern int shmchan_open(struct shmchan_client *, const char *);
+extern int shmchan_receive(struct shmchan_client *, int *, char *, size_t, size_t *, size_t *);
+extern int shmchan_send(struct shmchan_client *, const char *, size_t);
+
+#endif /* INC_SHMCHAN */
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2024 Shao Miller.  All rights reserved.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "toylib.h"
+
+/*
+ * Small allocations are carved out of big slabs, one size-class per slab,
+ * and freed blocks are kept on their class's free-list to be handed out
+ * again, most recently freed first.  Each block has a header saying which
+ * class it's from, since 'free' isn't told the size.  Larger allocations
+ * go to the default api_stdlib, with the same header, so the largest of
+ * them are mapped.  Slabs are never given back
+ */
+
+enum slab_value
+  {
+    slab_size = 65536,
+    /* Marks a block that came from the default api_stdlib */
+    slab_class_none = 16,
+    slab_zero = 0
+  };
+
+union slab_header;
+
+/* Sized and aligned for anything that follows it */
+union slab_header
+  {
+    size_t size_class;
+    union slab_header * next_free;
+    long int align_long;
+    long double align_long_double;
+    void * align_pointer;
+  };
+
+static void * carve_block(size_t);
+static size_t class_for_size(size_t);
+static apifunction_stdlib_free slab_free;
+static apifunction_stdlib_malloc slab_malloc;
+static apifunction_stdlib_realloc slab_realloc;
+
+static struct api_stdlib api_stdlib_slabs_defaults =
+  {
+    &api_stdlib_initialize_slabs,
+    &slab_free,
+    &slab_malloc,
+    &slab_realloc,
+    0,
+    0
+  };
+
+/* Each class's size, counting the header */
+static const size_t class_sizes[slab_class_none] =
+  {
+    32, 48, 64, 80, 96, 112, 128, 160, 192, 256, 320, 384, 512, 768, 1024, 2048
+  };
+
+/* Of each class, the space left in its current slab, and the freed blocks */
+static char * carve_next[slab_class_none];
+static size_t carve_left[slab_class_none];
+static union slab_header * free_lists[slab_class_none];
+/* For the larger allocations */
+static struct api_stdlib large_api;
+
+enum apivalue_stdlib api_stdlib_initialize_slabs(struct api_stdlib * api)
+  {
+    *api = api_stdlib_slabs_defaults;
+    return api_stdlib_initialize(&large_api);
+  }
+
+/* Takes the next block from the class's slab, starting a new slab when that's used up */
+static void * carve_block(size_t size_class)
+  {
+    char * block;
+
+    if (carve_left[size_class] < class_sizes[size_class])
+      {
+        carve_next[size_class] = malloc(slab_size);
+        if (carve_next[size_class] == NULL)
+          {
+            carve_left[size_class] = 0;
+            return NULL;
+          }
+        carve_left[size_class] = slab_size;
+      }
+    block = carve_next[size_class];
+    carve_next[size_class] += class_sizes[size_class];
+    carve_left[size_class] -= class_sizes[size_class];
+    return block;
+  }
+
+/* Returns slab_class_none if it's too big for any class */
+static size_t class_for_size(size_t size)
+  {
+    size_t i;
+
+    if (size > class_sizes[slab_class_none - 1] - sizeof (union slab_header))
+      return slab_class_none;
+    i = 0;
+    while (class_sizes[i] - sizeof (union slab_header) < size)
+      ++i;
+    return i;
+  }
+
+static void slab_free(struct api_stdlib * api, void * ptr)
+  {
+    union slab_header * header;
+    size_t size_class;
+
+    (void) api;
+
+    if (ptr == NULL)
+      return;
+    header = (union slab_header *) ptr - 1;
+    size_class = header->size_class;
+    if (size_class == slab_class_none)
+      {
+        large_api.free(&large_api, header);
+        return;
+      }
+    header->next_free = free_lists[size_class];
+    free_lists[size_class] = header;
+  }
+
+static void * slab_malloc(struct api_stdlib * api, size_t size)
+  {
+    union slab_header * header;
+    size_t size_class;
+
+    size_class = class_for_size(size);
+    if (size_class == slab_class_none)
+      {
+        if (size > (size_t) -1 - sizeof *header)
+          return NULL;
+        header = large_api.malloc(&large_api, sizeof *header + size);
+      }
+      else if (free_lists[size_class] != NULL)
+      {
+        header = free_lists[size_class];
+        free_lists[size_class] = header->next_free;
+      }
+      else
+      {
+        header = carve_block(size_class);
+      }
+    if (header == NULL)
+      return NULL;
+    header->size_class = size_class;
+    ++api->allocations;
+    api->allocated_bytes += size;
+    return header + 1;
+  }
+
+/* A block is kept if it's from a class that still fits, and big blocks are resized in place, if possible */
+static void * slab_realloc(struct api_stdlib * api, void * ptr, size_t size)
+  {
+    union slab_header * header;
+    void * new_ptr;
+    size_t old_size;
+    size_t size_class;
+
+    if (ptr == NULL)
+      return slab_malloc(api, size);
+    header = (union slab_header *) ptr - 1;
+    size_class = header->size_class;
+    if (size_class == slab_class_none && class_for_size(size) == slab_class_none)
+      {
+        if (size > (size_t) -1 - sizeof *header)
+          return NULL;
+        header = large_api.realloc(&large_api, header, sizeof *header + size);
+        if (header == NULL)
+          return NULL;
+        ++api->allocations;
+        api->allocated_bytes += size;
+        return header + 1;
+      }
+    if (size_class != slab_class_none && class_for_size(size) <= size_class)
+      {
+        ++api->allocations;
+        api->allocated_bytes += size;
+        return ptr;
+      }
+
+    /* Moving between classes, or between a class and the default api_stdlib */
+    new_ptr = slab_malloc(api, size);
+    if (new_ptr == NULL)
+      return NULL;
+    /* A big block's old size isn't known, but it was bigger than any class */
+    old_size = size_class == slab_class_none ? size : class_sizes[size_class] - sizeof *header;
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    slab_free(api, ptr);
+    return new_ptr;
+  }
@@ -1,7 +1,18 @@
 /*
  * Copyright (C) 2024 Shao Miller.  All rights reserved.
  */
+#if CMDCTOY_POSIX
+/* For poll */
+#define _POSIX_C_SOURCE 200112L
+#endif /* CMDCTOY_POSIX */
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if CMDCTOY_POSIX
+#include <poll.h>
+#endif /* CMDCTOY_POSIX */
+#include "arena.h"
 #include "builtins.h"
 #include "command.h"
 #include "depend.h"
@@ -16,15 +27,48 @@
 #include "process.h"
 #include "type.h"
 
+static void add_to_record(char *, size_t *, const char *);
+static func_work drain_log;
+static void flush_log(void);
+static size_t format_record(char *, const char *, enum apivalue_log_level, const char *, const struct log_field *, size_t);
+static func_log log_diagnostic;
 static func_module_event module_event;
+static int parse_options(struct top *);
 static func_schedule_last schedule_last;
 static func_schedule_next schedule_next;
+static func_schedule_ready schedule_ready;
 static func_request_shutdown request_shutdown;
 static func_work shutdown_checker;
 static func_work startup;
+static void wake_watchers(int);
 
 static struct top * ctx;
+/*
+ * Records waiting to be written are from 'log_tail' to 'log_head', which
+ * only grow, and the ring's size divides their range.  Until the loop is
+ * running, and after it's done, records are written straight away
+ */
+static unsigned long int log_dropped;
+static size_t log_head;
+static int log_later;
+static char log_ring[apivalue_log_ring_size];
+static time_t log_second;
+static unsigned long int log_second_count;
+static size_t log_tail;
+static struct work_item log_work;
 static struct live_module module;
+/* From the '--memprof' option */
+static int memprof;
+/* From the '--slabs' option */
+static int slabs;
+/* From the '--sync' option, for the command API */
+static int sync_redirections;
+/* Work waiting for file descriptors to be ready */
+static struct work_list * watch_list;
+#if CMDCTOY_POSIX
+static size_t pollfd_capacity;
+static struct pollfd * pollfds;
+#endif /* CMDCTOY_POSIX */
 
 static struct live_module module =
   {
@@ -33,7 +77,7 @@ static struct live_module module =
         {
           module_signature,
           "2024120200",
-          1
+          apivalue_module_api_version
         },
         &module_event,
         {
@@ -85,16 +129,20 @@ static struct live_module module =
 
 int toy_loop(struct process * process)
   {
+    struct stdlib_arena arena;
     struct api_btree btree_api;
     enum apivalue_btree btree_rv;
     struct api_command command_api;
     struct api_dependency dependency_api;
     enum apivalue_dependency dependency_rv;
+    int exit_status;
+    int input_holds;
     struct api_list list_api;
     struct list_item * list_item;
     enum apivalue_list list_rv;
     struct module_api module_api;
     int return_value;
+    unsigned int since_poll;
     struct work_item startup_work;
     int shutdown_requested;
     struct work_item shutdown_work;
@@ -107,14 +155,18 @@ int toy_loop(struct process * process)
     enum apivalue_toy_scope toy_scope_rv;
     struct api_type type_api;
     enum apivalue_type type_rv;
+    struct work_list watches;
     struct work_item * work_item;
     struct work_list work_list;
 
     ctx = &top_struct;
+    watch_list = &watches;
 
     module.ctx = ctx;
 
     shutdown_requested = 0;
+    input_holds = 0;
+    exit_status = EXIT_SUCCESS;
 
     top_struct.main_stack = process->main_stack;
     top_struct.api_dependency = &dependency_api;
@@ -123,24 +175,35 @@ int toy_loop(struct process * process)
     top_struct.api_command = &command_api;
     top_struct.work_module = &module;
     top_struct.request_shutdown = &request_shutdown;
+    top_struct.log = &log_diagnostic;
     top_struct.shutdown_requested = &shutdown_requested;
     top_struct.api_stdio = &stdio_api;
-    top_struct.api_stdlib = &stdlib_api;
+    top_struct.api_stdlib = &arena.api;
     top_struct.api_toy_scope = &toy_scope_api;
     top_struct.api_type = &type_api;
     top_struct.work_list = &work_list;
     top_struct.schedule_last = &schedule_last;
     top_struct.schedule_next = &schedule_next;
+    top_struct.schedule_ready = &schedule_ready;
+    top_struct.script = NULL;
+    top_struct.commands = NULL;
+    top_struct.exit_status = &exit_status;
+    top_struct.interactive = 1;
+    top_struct.input_holds = &input_holds;
 
     stdio_rv = api_stdio_initialize(&stdio_api);
     if (stdio_rv != apivalue_stdio_success)
       return EXIT_FAILURE;
 
+    if (parse_options(ctx) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+
     list_rv = api_list_initialize(&list_api);
     if (list_rv != apivalue_list_success)
       return EXIT_FAILURE;
     ctx->api_list = &list_api;
     ctx->api_list->initialize_list(ctx->api_list, &work_list.list);
+    ctx->api_list->initialize_list(ctx->api_list, &watches.list);
 
     btree_rv = api_btree_initialize(&btree_api);
     if (btree_rv != apivalue_btree_success)
@@ -151,16 +214,25 @@ int toy_loop(struct process * process)
     if (dependency_rv != apivalue_dependency_success)
       return EXIT_FAILURE;
 
-    stdlib_rv = api_stdlib_initialize(&stdlib_api);
+    if (slabs)
+      stdlib_rv = api_stdlib_initialize_slabs(&stdlib_api);
+      else
+      stdlib_rv = api_stdlib_initialize(&stdlib_api);
     if (stdlib_rv != apivalue_stdlib_success)
       return EXIT_FAILURE;
+    /* Modules' arenas allocate from this one, so what it counts is for the whole program */
+    initialize_arena(&arena, module.module.v1.nice_name, &stdlib_api, &list_api);
+    arena.shared = 1;
+    if (memprof && start_memory_profile(&stdlib_api) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
 
+    type_api.api_stdlib = &arena.api;
     type_rv = api_type_initialize(&type_api);
     if (type_rv != apivalue_type_success)
       return EXIT_FAILURE;
 
     toy_scope_api.api_btree = &btree_api;
-    toy_scope_api.api_stdlib = &stdlib_api;
+    toy_scope_api.api_stdlib = &arena.api;
     toy_scope_rv = api_toy_scope_initialize(&toy_scope_api);
     if (toy_scope_rv != apivalue_toy_scope_success)
       return EXIT_FAILURE;
@@ -173,18 +245,177 @@ int toy_loop(struct process * process)
     shutdown_work.work = &shutdown_checker;
     (void) ctx->schedule_last(&module, &shutdown_work, &work_list);
 
-    while ((list_item = ctx->api_list->remove_item_from_list_head(ctx->api_list, &ctx->work_list->list)) != NULL)
+    (void) ctx->api_list->initialize_list_item(ctx->api_list, &log_work.list_item);
+    log_work.work = &drain_log;
+    log_later = 1;
+
+    since_poll = 0;
+    while (1)
       {
+        /*
+         * Check on waiting work now and then.  When only the shutdown-checker
+         * is left, there's nothing else to do but wait
+         */
+        if (!ctx->api_list->list_is_empty(ctx->api_list, &watches.list))
+          {
+            if (work_list.list.head.next == &shutdown_work.list_item && shutdown_work.list_item.next == &work_list.list.head)
+              {
+                wake_watchers(1);
+                since_poll = 0;
+              }
+              else if (++since_poll == 64)
+              {
+                wake_watchers(0);
+                since_poll = 0;
+              }
+          }
+        list_item = ctx->api_list->remove_item_from_list_head(ctx->api_list, &ctx->work_list->list);
+        if (list_item == NULL)
+          break;
         work_item = type_with_member_at_ptr(struct work_item, list_item, list_item);
         ctx = work_item->ctx;
         /* Do the work */
+        (void) set_memory_profile_worker(work_item->live_module->module.v1.nice_name);
         return_value = work_item->work(work_item);
+        (void) set_memory_profile_worker(NULL);
         ctx = &top_struct;
       }
 
+    log_later = 0;
+    flush_log();
+    wake_watchers(-1);
+    type_api.forget_caches(&type_api);
+    type_api.release_types(&type_api);
+    if (!top_struct.interactive)
+      return exit_status;
     return return_value;
   }
 
+/* Leaves room for the newline */
+static void add_to_record(char * record, size_t * length, const char * text)
+  {
+    while (*text != '\0' && *length < apivalue_log_record_size - 1)
+      record[(*length)++] = *text++;
+  }
+
+static int drain_log(struct work_item * work_item)
+  {
+    (void) work_item;
+
+    flush_log();
+    return EXIT_SUCCESS;
+  }
+
+/* Writes the waiting records, then how many were dropped, if any */
+static void flush_log(void)
+  {
+    size_t first;
+    size_t length;
+    struct log_field field;
+    size_t offset;
+    char record[apivalue_log_record_size];
+    struct api_stdio * stdio_api;
+    size_t used;
+    char value[32];
+
+    stdio_api = ctx->api_stdio;
+    used = log_head - log_tail;
+    offset = log_tail & (apivalue_log_ring_size - 1);
+    first = apivalue_log_ring_size - offset;
+    if (first > used)
+      first = used;
+    if (first > 0)
+      (void) stdio_api->fwrite(stdio_api, log_ring + offset, 1, first, stderr);
+    if (used > first)
+      (void) stdio_api->fwrite(stdio_api, log_ring, 1, used - first, stderr);
+    log_tail = log_head;
+    if (log_dropped > 0)
+      {
+        sprintf(value, "%lu", log_dropped);
+        field.key = "count";
+        field.value = value;
+        length = format_record(record, module.module.v1.nice_name, apivalue_log_level_warning, "Diagnostics were dropped", &field, 1);
+        (void) stdio_api->fwrite(stdio_api, record, 1, length, stderr);
+        log_dropped = 0;
+      }
+  }
+
+/* Like "[error] cmd_load: Message key=value key=value", and a newline, which always fits */
+static size_t format_record(char * record, const char * nice_name, enum apivalue_log_level level, const char * message, const struct log_field * fields, size_t field_count)
+  {
+    size_t i;
+    size_t length;
+    static const char * const level_names[] = {"error", "warning", "notice", "debug"};
+
+    length = 0;
+    add_to_record(record, &length, "[");
+    add_to_record(record, &length, (size_t) level < countof(level_names) ? level_names[level] : "debug");
+    add_to_record(record, &length, "] ");
+    add_to_record(record, &length, nice_name);
+    add_to_record(record, &length, ": ");
+    add_to_record(record, &length, message);
+    for (i = 0; i < field_count; ++i)
+      {
+        add_to_record(record, &length, " ");
+        add_to_record(record, &length, fields[i].key);
+        add_to_record(record, &length, "=");
+        add_to_record(record, &length, fields[i].value);
+      }
+    record[length++] = '\n';
+    return length;
+  }
+
+static void log_diagnostic(struct live_module * live_module, enum apivalue_log_level level, const char * message, const struct log_field * fields, size_t field_count)
+  {
+    size_t first;
+    size_t length;
+    time_t now;
+    size_t offset;
+    char record[apivalue_log_record_size];
+
+    /* A burst beyond the limit is only counted */
+    now = time(NULL);
+    if (now != log_second)
+      {
+        log_second = now;
+        log_second_count = 0;
+      }
+    if (log_second_count == apivalue_log_rate_limit)
+      {
+        ++log_dropped;
+        return;
+      }
+    ++log_second_count;
+
+    length = format_record(record, live_module != NULL ? live_module->module.v1.nice_name : module.module.v1.nice_name, level, message, fields, field_count);
+    /* A session's standard error goes back with its reply, so it can't wait */
+    if (ctx->api_stdio->error_output != NULL)
+      {
+        (void) ctx->api_stdio->fwrite(ctx->api_stdio, record, 1, length, stderr);
+        return;
+      }
+    if (!log_later)
+      {
+        flush_log();
+        (void) ctx->api_stdio->fwrite(ctx->api_stdio, record, 1, length, stderr);
+        return;
+      }
+    if (apivalue_log_ring_size - (log_head - log_tail) < length)
+      {
+        ++log_dropped;
+        return;
+      }
+    offset = log_head & (apivalue_log_ring_size - 1);
+    first = apivalue_log_ring_size - offset;
+    if (first > length)
+      first = length;
+    memcpy(log_ring + offset, record, first);
+    memcpy(log_ring, record + first, length - first);
+    log_head += length;
+    if (log_work.list_item.next == NULL)
+      (void) ctx->schedule_last(&module, &log_work, ctx->work_list);
+  }
+
 static int module_event(enum apivalue_module_event_type type, void * event_data)
   {
     (void) type;
@@ -192,12 +423,61 @@ static int module_event(enum apivalue_module_event_type type, void * event_data)
     return EXIT_FAILURE;
   }
 
+static int parse_options(struct top * top)
+  {
+    int argc;
+    char ** argv;
+    int i;
+
+    argc = *(top->main_stack->standard.p_argc);
+    argv = *(top->main_stack->standard.p_argv);
+    for (i = 1; i < argc; ++i)
+      {
+        if (strcmp(argv[i], "--memprof") == 0)
+          {
+            memprof = 1;
+            continue;
+          }
+        if (strcmp(argv[i], "--slabs") == 0)
+          {
+            slabs = 1;
+            continue;
+          }
+        if (strcmp(argv[i], "--sync") == 0)
+          {
+            sync_redirections = 1;
+            continue;
+          }
+        /* At most one of these */
+        if (i + 1 < argc && top->interactive)
+          {
+            if (strcmp(argv[i], "-c") == 0)
+              {
+                top->commands = argv[++i];
+                top->interactive = 0;
+                continue;
+              }
+            if (strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--script") == 0)
+              {
+                top->script = argv[++i];
+                top->interactive = 0;
+                continue;
+              }
+          }
+        (void) top->api_stdio->fprintf(top->api_stdio, stderr, "Unrecognized option '%s'\nUsage: cmdctoy [--memprof] [--slabs] [--sync] [-c \"COMMAND; ...\" | -f FILE | --script FILE]\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+    return EXIT_SUCCESS;
+  }
+
 static void request_shutdown(struct top * top)
   {
     if (*(top->shutdown_requested))
       return;
     *(top->shutdown_requested) = 1;
-    (void) top->api_stdio->fprintf(top->api_stdio, stderr, "Shutdown requested\n");
+    top->log(top->work_module, apivalue_log_level_notice, "Shutdown requested", NULL, 0);
+    /* Waiting work is scheduled, so that it can notice */
+    wake_watchers(2);
     /* Modules might schedule shutdown-related work */
     top->module_api->request_shutdown(top);
   }
@@ -218,9 +498,28 @@ static int schedule_next(struct live_module * work_module, struct work_item * wo
     return EXIT_SUCCESS;
   }
 
+static int schedule_ready(struct live_module * work_module, struct work_item * work_item, int descriptor, int events)
+  {
+#if CMDCTOY_POSIX
+    if (!*(ctx->shutdown_requested))
+      {
+        work_item->ctx = work_module->ctx;
+        work_item->live_module = work_module;
+        work_item->descriptor = descriptor;
+        work_item->ready_events = events;
+        (void) ctx->api_list->add_item_to_list_tail(ctx->api_list, &work_item->list_item, &watch_list->list);
+        return EXIT_SUCCESS;
+      }
+#else
+    (void) descriptor;
+    (void) events;
+#endif /* CMDCTOY_POSIX */
+    return schedule_last(work_module, work_item, ctx->work_list);
+  }
+
 static int shutdown_checker(struct work_item * work_item)
   {
-    if (ctx->api_list->list_is_empty(ctx->api_list, &ctx->work_list->list))
+    if (ctx->api_list->list_is_empty(ctx->api_list, &ctx->work_list->list) && ctx->api_list->list_is_empty(ctx->api_list, &watch_list->list))
       {
         ctx->module_api->unload_all(ctx);
         return EXIT_SUCCESS;
@@ -241,9 +540,14 @@ static int startup(struct work_item * work_item)
 
     ctx->api_command->api_list = ctx->api_list;
     ctx->api_command->api_stdio = ctx->api_stdio;
+    ctx->api_command->api_stdlib = ctx->api_stdlib;
     command_rv = api_command_initialize(ctx->api_command);
     if (command_rv != apivalue_command_success)
       return EXIT_FAILURE;
+    /* Pure commands read identifiers and types */
+    ctx->api_command->versions[0] = &ctx->api_toy_scope->version;
+    ctx->api_command->versions[1] = &ctx->api_type->version;
+    ctx->api_command->sync_redirections = sync_redirections;
 
     rv = builtin_startup(ctx);
     if (rv != EXIT_SUCCESS)
@@ -253,3 +557,75 @@ static int startup(struct work_item * work_item)
       return rv;
     return EXIT_SUCCESS;
   }
+
+/*
+ * Schedules waiting work that's ready.  'how' is 0 to check without waiting,
+ * 1 to wait until something is ready, 2 to schedule all of it regardless and
+ * -1 to release the memory used for checking
+ */
+static void wake_watchers(int how)
+  {
+    struct list_item * list_item;
+    struct list_item * next;
+#if CMDCTOY_POSIX
+    size_t count;
+    struct pollfd * grown;
+    size_t i;
+    struct work_item * work_item;
+
+    if (how < 0)
+      {
+        ctx->api_stdlib->free(ctx->api_stdlib, pollfds);
+        pollfds = NULL;
+        pollfd_capacity = 0;
+        return;
+      }
+    if (how < 2)
+      {
+        count = 0;
+        for (list_item = watch_list->list.head.next; list_item != &watch_list->list.head; list_item = list_item->next)
+          ++count;
+        if (count > pollfd_capacity)
+          {
+            if (count > (size_t) -1 / 2 / sizeof *pollfds)
+              return;
+            grown = ctx->api_stdlib->realloc(ctx->api_stdlib, pollfds, count * 2 * sizeof *pollfds);
+            if (grown == NULL)
+              return;
+            pollfds = grown;
+            pollfd_capacity = count * 2;
+          }
+        i = 0;
+        for (list_item = watch_list->list.head.next; list_item != &watch_list->list.head; list_item = list_item->next)
+          {
+            work_item = type_with_member_at_ptr(struct work_item, list_item, list_item);
+            pollfds[i].fd = work_item->descriptor;
+            pollfds[i].events = 0;
+            if (work_item->ready_events & apivalue_work_ready_readable)
+              pollfds[i].events |= POLLIN;
+            if (work_item->ready_events & apivalue_work_ready_writable)
+              pollfds[i].events |= POLLOUT;
+            pollfds[i].revents = 0;
+            ++i;
+          }
+        /* An interruption is the same as nothing being ready */
+        if (poll(pollfds, (unsigned long int) count, how == 1 ? -1 : 0) <= 0)
+          return;
+      }
+    i = 0;
+#else
+    if (how < 0)
+      return;
+#endif /* CMDCTOY_POSIX */
+    for (list_item = watch_list->list.head.next; list_item != &watch_list->list.head; list_item = next)
+      {
+        next = list_item->next;
+#if CMDCTOY_POSIX
+        /* Errors and hang-ups count as ready, so that the work finds out about them */
+        if (how < 2 && pollfds[i++].revents == 0)
+          continue;
+#endif /* CMDCTOY_POSIX */
+        (void) ctx->api_list->remove_list_item(ctx->api_list, list_item);
+        (void) ctx->api_list->add_item_to_list_tail(ctx->api_list, list_item, &ctx->work_list->list);
+      }
+  }
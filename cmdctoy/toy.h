@@ -4,6 +4,27 @@
 #ifndef INC_CMDCTOY
 #define INC_CMDCTOY
 
+enum apivalue_log_level
+  {
+    apivalue_log_level_error,
+    apivalue_log_level_warning,
+    apivalue_log_level_notice,
+    apivalue_log_level_debug,
+    /* More records than this in a second are dropped and counted */
+    apivalue_log_rate_limit = 200,
+    /* Of the records waiting to be written */
+    apivalue_log_ring_size = 65536,
+    /* A longer record is cut short */
+    apivalue_log_record_size = 512
+  };
+
+enum apivalue_work_ready
+  {
+    apivalue_work_ready_readable = 1,
+    apivalue_work_ready_writable = 2
+  };
+
+struct log_field;
 struct top;
 struct work_item;
 struct work_list;
@@ -14,10 +35,12 @@ struct work_list;
 #include "module.h"
 #include "process.h"
 
+typedef void func_log(struct live_module *, enum apivalue_log_level, const char *, const struct log_field *, size_t);
 typedef int func_toy_loop(struct process *);
 typedef void func_request_shutdown(struct top *);
 typedef int func_schedule_last(struct live_module *, struct work_item *, struct work_list *);
 typedef int func_schedule_next(struct live_module *, struct work_item *, struct work_list *);
+typedef int func_schedule_ready(struct live_module *, struct work_item *, int, int);
 typedef int func_work(struct work_item *);
 
 extern func_toy_loop toy_loop;
@@ -38,8 +61,36 @@ struct top
     struct work_list * work_list;
     func_schedule_last * schedule_last;
     func_schedule_next * schedule_next;
+    /*
+     * Schedules work for when a file descriptor is ready, for reading and/or
+     * writing, or else when shutdown is requested.  Without POSIX, this is
+     * the same as schedule_last
+     */
+    func_schedule_ready * schedule_ready;
     func_request_shutdown * request_shutdown;
+    /*
+     * Records a diagnostic for standard error, with the module's nice-name
+     * and some keys with values.  It's written later on, by work that runs
+     * between other work, so that a burst of them doesn't hold anything up
+     */
+    func_log * log;
     int * shutdown_requested;
+    /* From the command-line; NULL when there's no start-up script */
+    const char * script;
+    /* From the command-line; NULL when there are no start-up commands */
+    const char * commands;
+    /* What the program exits with, when not interactive */
+    int * exit_status;
+    /* Whether commands are read from standard input */
+    int interactive;
+    /* While non-zero, standard input isn't read, so that a running script finishes first */
+    int * input_holds;
+  };
+
+struct log_field
+  {
+    const char * key;
+    const char * value;
   };
 
 struct work_item
@@ -48,6 +99,9 @@ struct work_item
     struct list_item list_item;
     struct top * ctx;
     struct live_module * live_module;
+    /* For schedule_ready */
+    int descriptor;
+    int ready_events;
   };
 
 struct work_list
@@ -1,24 +1,87 @@
 /*
  * Copyright (C) 2024 Shao Miller.  All rights reserved.
  */
+#if CMDCTOY_POSIX
+/* For vsnprintf, fileno and writev */
+#define _POSIX_C_SOURCE 200112L
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif /* CMDCTOY_POSIX */
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "toyio.h"
+#include "toylib.h"
 
+static int append_to_chain(struct stdio_chain *, const void *, size_t);
+static char * begin_append(struct api_stdio *, FILE *, size_t, char *);
+static int drain_sink(struct stdio_sink *, const void *, size_t);
+static size_t end_append(struct api_stdio *, FILE *, const char *, size_t, const char *);
+static char * reserve_in_sink(struct stdio_sink *, size_t);
+static char * segment_text(struct stdio_segment *);
+static apifunction_stdio_append_hex stdio_append_hex;
+static apifunction_stdio_append_pointer stdio_append_pointer;
+static apifunction_stdio_append_string stdio_append_string;
+static apifunction_stdio_append_unsigned stdio_append_unsigned;
 static apifunction_stdio_feof stdio_feof;
 static apifunction_stdio_ferror stdio_ferror;
 static apifunction_stdio_fgetc stdio_fgetc;
+static apifunction_stdio_flush_sink stdio_flush_sink;
 static apifunction_stdio_fprintf stdio_fprintf;
+static apifunction_stdio_fwrite stdio_fwrite;
+static apifunction_stdio_grow_buffer stdio_grow_buffer;
+static apifunction_stdio_initialize_chain stdio_initialize_chain;
+static apifunction_stdio_initialize_cursor stdio_initialize_cursor;
+static apifunction_stdio_initialize_sink stdio_initialize_sink;
+static apifunction_stdio_read_line stdio_read_line;
+static apifunction_stdio_release_chain stdio_release_chain;
+static apifunction_stdio_release_cursor stdio_release_cursor;
+static apifunction_stdio_release_sink stdio_release_sink;
+static apifunction_stdio_share stdio_share;
 static apifunction_stdio_ungetc stdio_ungetc;
+static int write_to_sink(struct stdio_sink *, const void *, size_t);
+#if CMDCTOY_POSIX
+static int write_pieces(int, const void *, size_t, const void *, size_t);
+#endif /* CMDCTOY_POSIX */
+
+/* "00" to "99", for two decimal digits at a time */
+static const char digit_pairs[] =
+  "00010203040506070809101112131415161718192021222324"
+  "25262728293031323334353637383940414243444546474849"
+  "50515253545556575859606162636465666768697071727374"
+  "75767778798081828384858687888990919293949596979899";
+static const char hex_digits[] = "0123456789ABCDEF";
 
 static struct api_stdio api_stdio_defaults =
   {
     &api_stdio_initialize,
+    &stdio_append_hex,
+    &stdio_append_pointer,
+    &stdio_append_string,
+    &stdio_append_unsigned,
     &stdio_feof,
     &stdio_ferror,
     &stdio_fgetc,
+    &stdio_flush_sink,
     &stdio_fprintf,
-    &stdio_ungetc
+    &stdio_fwrite,
+    &stdio_grow_buffer,
+    &stdio_initialize_chain,
+    &stdio_initialize_cursor,
+    &stdio_initialize_sink,
+    &stdio_read_line,
+    &stdio_release_chain,
+    &stdio_release_cursor,
+    &stdio_release_sink,
+    &stdio_share,
+    &stdio_ungetc,
+    NULL,
+    NULL,
+    NULL,
+    0
   };
 
 enum apivalue_stdio api_stdio_initialize(struct api_stdio * api)
@@ -27,6 +90,256 @@ enum apivalue_stdio api_stdio_initialize(struct api_stdio * api)
     return apivalue_stdio_success;
   }
 
+/* Copies into the last segment, if there's room and nothing else refers to it */
+static int append_to_chain(struct stdio_chain * chain, const void * buffer, size_t size)
+  {
+    size_t capacity;
+    struct stdio_segment * segment;
+    struct stdio_span * span;
+
+    if (size == 0)
+      return EXIT_SUCCESS;
+    span = chain->tail;
+    if (span != NULL)
+      {
+        segment = span->segment;
+        if (segment->references == 1 && span->offset + span->length == segment->used && segment->capacity - segment->used >= size)
+          {
+            memcpy(segment_text(segment) + segment->used, buffer, size);
+            segment->used += size;
+            span->length += size;
+            chain->length += size;
+            return EXIT_SUCCESS;
+          }
+      }
+
+    /* A single write isn't split, so that short lines stay in one piece */
+    capacity = size > apivalue_stdio_segment_size ? size : apivalue_stdio_segment_size;
+    if (capacity > (size_t) -1 - sizeof *segment)
+      return EXIT_FAILURE;
+    span = chain->api_stdlib->malloc(chain->api_stdlib, sizeof *span);
+    if (span == NULL)
+      return EXIT_FAILURE;
+    segment = chain->api_stdlib->malloc(chain->api_stdlib, sizeof *segment + capacity);
+    if (segment == NULL)
+      {
+        chain->api_stdlib->free(chain->api_stdlib, span);
+        return EXIT_FAILURE;
+      }
+    segment->references = 1;
+    segment->capacity = capacity;
+    segment->used = size;
+    memcpy(segment_text(segment), buffer, size);
+    span->next = NULL;
+    span->segment = segment;
+    span->offset = 0;
+    span->length = size;
+    if (chain->tail != NULL)
+      chain->tail->next = span;
+      else
+      chain->head = span;
+    chain->tail = span;
+    chain->length += size;
+    return EXIT_SUCCESS;
+  }
+
+/* Where to format text: straight into the sink, if that's where it's going, or else into 'scratch' */
+static char * begin_append(struct api_stdio * api, FILE * stream, size_t size, char * scratch)
+  {
+    if (stream == stdout && api->output == NULL && api->sink != NULL)
+      return reserve_in_sink(api->sink, size);
+    return scratch;
+  }
+
+/*
+ * Writes what the sink has gathered, then 'extra', which is usually empty.
+ * What's gathered is dropped, even if it can't be written
+ */
+static int drain_sink(struct stdio_sink * sink, const void * extra, size_t extra_size)
+  {
+    int rv;
+
+    rv = EXIT_FAILURE;
+    switch (sink->kind)
+      {
+        case apivalue_stdio_sink_file:
+#if CMDCTOY_POSIX
+        /* Whatever the stream holds goes first */
+        if (fflush(sink->file) == 0)
+          rv = write_pieces(fileno(sink->file), sink->buffer, sink->used, extra, extra_size);
+#else
+        if (fwrite(sink->buffer, 1, sink->used, sink->file) == sink->used && fwrite(extra, 1, extra_size, sink->file) == extra_size)
+          rv = EXIT_SUCCESS;
+#endif /* CMDCTOY_POSIX */
+        break;
+
+#if CMDCTOY_POSIX
+        case apivalue_stdio_sink_descriptor:
+        rv = write_pieces(sink->descriptor, sink->buffer, sink->used, extra, extra_size);
+        break;
+#endif /* CMDCTOY_POSIX */
+
+        case apivalue_stdio_sink_memory:
+        if (append_to_chain(sink->chain, sink->buffer, sink->used) == EXIT_SUCCESS && append_to_chain(sink->chain, extra, extra_size) == EXIT_SUCCESS)
+          rv = EXIT_SUCCESS;
+        break;
+
+        default:
+        break;
+      }
+    sink->used = 0;
+    return rv;
+  }
+
+static size_t end_append(struct api_stdio * api, FILE * stream, const char * text, size_t length, const char * scratch)
+  {
+    if (text == scratch)
+      return api->fwrite(api, text, 1, length, stream);
+    api->sink->used += length;
+    api->output_bytes += (unsigned long int) length;
+    return length;
+  }
+
+/* Makes room for 'size' more bytes, writing what's gathered if that would pass the threshold */
+static char * reserve_in_sink(struct stdio_sink * sink, size_t size)
+  {
+    size_t capacity;
+    char * grown;
+
+    if (sink->capacity - sink->used >= size)
+      return sink->buffer + sink->used;
+    if (sink->used > 0 && sink->used + size > apivalue_stdio_sink_threshold)
+      {
+        if (drain_sink(sink, NULL, 0) != EXIT_SUCCESS)
+          return NULL;
+        if (sink->capacity >= size)
+          return sink->buffer;
+      }
+    capacity = sink->capacity > 0 ? sink->capacity : apivalue_stdio_segment_size;
+    while (capacity - sink->used < size)
+      {
+        if (capacity > (size_t) -1 / 2)
+          return NULL;
+        capacity *= 2;
+      }
+    grown = sink->api_stdlib->realloc(sink->api_stdlib, sink->buffer, capacity);
+    if (grown == NULL)
+      return NULL;
+    sink->buffer = grown;
+    sink->capacity = capacity;
+    return sink->buffer + sink->used;
+  }
+
+static char * segment_text(struct stdio_segment * segment)
+  {
+    return (char *) (segment + 1);
+  }
+
+/* Two upper-case hex digits for each byte, each after the prefix, which is short, such as " 0x" */
+static size_t stdio_append_hex(struct api_stdio * api, const void * bytes, size_t count, const char * prefix, FILE * stream)
+  {
+    const unsigned char * byte;
+    size_t chunk;
+    size_t i;
+    size_t length;
+    size_t per_chunk;
+    size_t prefix_length;
+    char scratch[256];
+    char * text;
+    size_t total;
+    size_t written;
+
+    byte = bytes;
+    prefix_length = strlen(prefix);
+    per_chunk = sizeof scratch / (prefix_length + 2);
+    total = 0;
+    while (count > 0 && per_chunk > 0)
+      {
+        chunk = count < per_chunk ? count : per_chunk;
+        text = begin_append(api, stream, chunk * (prefix_length + 2), scratch);
+        if (text == NULL)
+          break;
+        length = 0;
+        for (i = 0; i < chunk; ++i)
+          {
+            memcpy(text + length, prefix, prefix_length);
+            length += prefix_length;
+            text[length++] = hex_digits[*byte >> 4];
+            text[length++] = hex_digits[*byte & 0xF];
+            ++byte;
+          }
+        written = end_append(api, stream, text, length, scratch);
+        total += written;
+        if (written != length)
+          break;
+        count -= chunk;
+      }
+    return total;
+  }
+
+static size_t stdio_append_pointer(struct api_stdio * api, const void * pointer, FILE * stream)
+  {
+    int rv;
+#if CMDCTOY_POSIX
+    char digits[2 + sizeof (unsigned long int) * 2];
+    static const char lower_hex_digits[] = "0123456789abcdef";
+    char * text;
+    unsigned long int value;
+
+    /* The same as the C libraries' %p, so that 'sscanf' reads it back */
+    if (sizeof pointer <= sizeof value)
+      {
+        value = (unsigned long int) pointer;
+        text = digits + sizeof digits;
+        do
+          {
+            *--text = lower_hex_digits[value & 0xF];
+            value >>= 4;
+          }
+          while (value != 0);
+        *--text = 'x';
+        *--text = '0';
+        return api->fwrite(api, text, 1, (size_t) (digits + sizeof digits - text), stream);
+      }
+#endif /* CMDCTOY_POSIX */
+
+    /* Pointers don't have a portable representation, so ask the library */
+    rv = api->fprintf(api, stream, "%p", pointer);
+    return rv > 0 ? (size_t) rv : 0;
+  }
+
+static size_t stdio_append_string(struct api_stdio * api, const char * string, FILE * stream)
+  {
+    return api->fwrite(api, string, 1, strlen(string), stream);
+  }
+
+static size_t stdio_append_unsigned(struct api_stdio * api, unsigned long int value, FILE * stream)
+  {
+    char digits[sizeof value * CHAR_BIT / 3 + 1];
+    size_t pair;
+    char * text;
+
+    text = digits + sizeof digits;
+    while (value >= 100)
+      {
+        pair = (size_t) (value % 100) * 2;
+        value /= 100;
+        *--text = digit_pairs[pair + 1];
+        *--text = digit_pairs[pair];
+      }
+    if (value >= 10)
+      {
+        pair = (size_t) value * 2;
+        *--text = digit_pairs[pair + 1];
+        *--text = digit_pairs[pair];
+      }
+      else
+      {
+        *--text = (char) ('0' + value);
+      }
+    return api->fwrite(api, text, 1, (size_t) (digits + sizeof digits - text), stream);
+  }
+
 static int stdio_feof(struct api_stdio * api, FILE * stream)
   {
     (void) api;
@@ -48,22 +361,436 @@ static int stdio_fgetc(struct api_stdio * api, FILE * stream)
     return fgetc(stream);
   }
 
+static int stdio_flush_sink(struct api_stdio * api, struct stdio_sink * sink)
+  {
+    (void) api;
+
+    if (sink->used == 0)
+      return EXIT_SUCCESS;
+    return drain_sink(sink, NULL, 0);
+  }
+
 static int stdio_fprintf(struct api_stdio * api, FILE * stream, const char * format, ...)
   {
     va_list ap;
+    struct stdio_chain * chain;
     int rv;
+    struct stdio_sink * sink;
+    FILE * target;
 
-    (void) api;
+    chain = stream == stdout ? api->output : stream == stderr ? api->error_output : NULL;
+    sink = stream == stdout && chain == NULL ? api->sink : NULL;
+    target = stream;
+    /* What's been gathered for standard output goes before anything else, so that they stay in order */
+    if (stream != stdout && chain == NULL && api->sink != NULL && api->sink->used > 0)
+      (void) drain_sink(api->sink, NULL, 0);
+
+#if CMDCTOY_POSIX
+    if (sink != NULL)
+      {
+        char * text;
+
+        /* Format straight into the sink, and again if it didn't fit */
+        text = reserve_in_sink(sink, 256);
+        if (text == NULL)
+          return -1;
+        va_start(ap, format);
+        rv = vsnprintf(text, sink->capacity - sink->used, format, ap);
+        va_end(ap);
+        if (rv >= 0 && (size_t) rv >= sink->capacity - sink->used)
+          {
+            text = reserve_in_sink(sink, (size_t) rv + 1);
+            if (text == NULL)
+              return -1;
+            va_start(ap, format);
+            rv = vsnprintf(text, (size_t) rv + 1, format, ap);
+            va_end(ap);
+          }
+        if (rv > 0)
+          {
+            sink->used += (size_t) rv;
+            api->output_bytes += (unsigned long int) rv;
+          }
+        return rv;
+      }
+#else
+    if (sink != NULL)
+      {
+        /* Without a bounded way to format into memory, what's been gathered goes first */
+        if (drain_sink(sink, NULL, 0) != EXIT_SUCCESS)
+          return -1;
+        if (sink->kind == apivalue_stdio_sink_memory)
+          chain = sink->chain;
+          else if (sink->kind == apivalue_stdio_sink_file)
+          target = sink->file;
+          else
+          return -1;
+      }
+#endif /* CMDCTOY_POSIX */
+
+    if (chain != NULL)
+      {
+#if CMDCTOY_POSIX
+        char * buffer;
+        char stack_buffer[256];
+
+        va_start(ap, format);
+        rv = vsnprintf(stack_buffer, sizeof stack_buffer, format, ap);
+        va_end(ap);
+        if (rv < 0)
+          return rv;
+        buffer = stack_buffer;
+        if ((size_t) rv >= sizeof stack_buffer)
+          {
+            buffer = chain->api_stdlib->malloc(chain->api_stdlib, (size_t) rv + 1);
+            if (buffer == NULL)
+              return -1;
+            va_start(ap, format);
+            rv = vsnprintf(buffer, (size_t) rv + 1, format, ap);
+            va_end(ap);
+          }
+        if (rv >= 0 && append_to_chain(chain, buffer, (size_t) rv) != EXIT_SUCCESS)
+          rv = -1;
+        if (stream == stdout && rv > 0)
+          api->output_bytes += (unsigned long int) rv;
+        if (buffer != stack_buffer)
+          chain->api_stdlib->free(chain->api_stdlib, buffer);
+        return rv;
+#else
+        char buffer[BUFSIZ];
+        size_t count;
+
+        /* Without a bounded way to format into memory, format into a file and read it back */
+        stream = tmpfile();
+        if (stream == NULL)
+          return -1;
+        va_start(ap, format);
+        rv = vfprintf(stream, format, ap);
+        va_end(ap);
+        rewind(stream);
+        while (rv >= 0 && (count = fread(buffer, 1, sizeof buffer, stream)) > 0)
+          {
+            if (append_to_chain(chain, buffer, count) != EXIT_SUCCESS)
+              rv = -1;
+          }
+        (void) fclose(stream);
+        /* 'stream' is the temporary file, now, but 'target' is still what was asked for */
+        if (target == stdout && rv > 0)
+          api->output_bytes += (unsigned long int) rv;
+        return rv;
+#endif /* CMDCTOY_POSIX */
+      }
 
     va_start(ap, format);
-    rv = vfprintf(stream, format, ap);
+    rv = vfprintf(target, format, ap);
     va_end(ap);
+    if (stream == stdout && rv > 0)
+      api->output_bytes += (unsigned long int) rv;
     return rv;
   }
 
+static size_t stdio_fwrite(struct api_stdio * api, const void * buffer, size_t size, size_t count, FILE * stream)
+  {
+    int rv;
+
+    if (stream == stdout && (api->output != NULL || api->sink != NULL))
+      {
+        if (size == 0 || count > (size_t) -1 / size)
+          return 0;
+        if (api->output != NULL)
+          rv = append_to_chain(api->output, buffer, size * count);
+          else
+          rv = write_to_sink(api->sink, buffer, size * count);
+        if (rv != EXIT_SUCCESS)
+          return 0;
+        api->output_bytes += (unsigned long int) (size * count);
+        return count;
+      }
+    if (stream == stderr && api->error_output != NULL)
+      {
+        if (size == 0 || count > (size_t) -1 / size)
+          return 0;
+        return append_to_chain(api->error_output, buffer, size * count) == EXIT_SUCCESS ? count : 0;
+      }
+    if (stream != stdout)
+      {
+        if (api->sink != NULL && api->sink->used > 0)
+          (void) drain_sink(api->sink, NULL, 0);
+        return fwrite(buffer, size, count, stream);
+      }
+    count = fwrite(buffer, size, count, stream);
+    api->output_bytes += (unsigned long int) (size * count);
+    return count;
+  }
+
+static int stdio_grow_buffer(struct api_stdio * api, struct api_stdlib * stdlib_api, char ** buffer, size_t * capacity, size_t needed)
+  {
+    char * grown;
+    size_t new_capacity;
+
+    (void) api;
+
+    if (needed <= *capacity)
+      return EXIT_SUCCESS;
+    new_capacity = *capacity > 0 ? *capacity : apivalue_stdio_segment_size;
+    while (new_capacity < needed)
+      {
+        if (new_capacity > (size_t) -1 / 2)
+          return EXIT_FAILURE;
+        new_capacity *= 2;
+      }
+    grown = stdlib_api->realloc(stdlib_api, *buffer, new_capacity);
+    if (grown == NULL)
+      return EXIT_FAILURE;
+    *buffer = grown;
+    *capacity = new_capacity;
+    return EXIT_SUCCESS;
+  }
+
+static void stdio_initialize_chain(struct api_stdio * api, struct stdio_chain * chain, struct api_stdlib * stdlib_api)
+  {
+    (void) api;
+
+    chain->api_stdlib = stdlib_api;
+    chain->head = NULL;
+    chain->tail = NULL;
+    chain->length = 0;
+  }
+
+static void stdio_initialize_cursor(struct api_stdio * api, struct stdio_cursor * cursor, struct stdio_chain * chain)
+  {
+    (void) api;
+
+    cursor->chain = chain;
+    cursor->span = chain->head;
+    cursor->position = 0;
+    cursor->scratch = NULL;
+    cursor->scratch_capacity = 0;
+  }
+
+/* The sink is for standard output, unless the caller sets 'file', 'descriptor' or 'chain' for its kind */
+static void stdio_initialize_sink(struct api_stdio * api, struct stdio_sink * sink, enum apivalue_stdio kind, struct api_stdlib * stdlib_api)
+  {
+    (void) api;
+
+    sink->api_stdlib = stdlib_api;
+    sink->kind = kind;
+    sink->file = stdout;
+    sink->descriptor = -1;
+    sink->chain = NULL;
+    sink->buffer = NULL;
+    sink->capacity = 0;
+    sink->used = 0;
+  }
+
+/* Lines within a span are pointed to where they are, and only lines crossing spans are copied */
+static enum apivalue_stdio stdio_read_line(struct api_stdio * api, struct stdio_cursor * cursor, struct stdio_line * line)
+  {
+    size_t available;
+    char * grown;
+    size_t length;
+    const char * newline;
+    struct api_stdlib * stdlib_api;
+    const char * text;
+
+    (void) api;
+
+    while (cursor->span != NULL && cursor->position == cursor->span->length)
+      {
+        cursor->span = cursor->span->next;
+        cursor->position = 0;
+      }
+    if (cursor->span == NULL)
+      return apivalue_stdio_end_of_chain;
+
+    text = segment_text(cursor->span->segment) + cursor->span->offset + cursor->position;
+    available = cursor->span->length - cursor->position;
+    newline = memchr(text, '\n', available);
+    if (newline != NULL || cursor->span->next == NULL)
+      {
+        line->text = text;
+        line->length = newline != NULL ? (size_t) (newline - text) + 1 : available;
+        line->segment = cursor->span->segment;
+        cursor->position += line->length;
+        return apivalue_stdio_success;
+      }
+
+    /* Gather the pieces */
+    stdlib_api = cursor->chain->api_stdlib;
+    length = 0;
+    while (cursor->span != NULL)
+      {
+        text = segment_text(cursor->span->segment) + cursor->span->offset + cursor->position;
+        available = cursor->span->length - cursor->position;
+        newline = memchr(text, '\n', available);
+        if (newline != NULL)
+          available = (size_t) (newline - text) + 1;
+        if (cursor->scratch_capacity - length < available)
+          {
+            if (length + available > ((size_t) -1) / 2)
+              return apivalue_stdio_error_out_of_memory;
+            grown = stdlib_api->realloc(stdlib_api, cursor->scratch, (length + available) * 2);
+            if (grown == NULL)
+              return apivalue_stdio_error_out_of_memory;
+            cursor->scratch = grown;
+            cursor->scratch_capacity = (length + available) * 2;
+          }
+        memcpy(cursor->scratch + length, text, available);
+        length += available;
+        cursor->position += available;
+        if (newline != NULL)
+          break;
+        cursor->span = cursor->span->next;
+        cursor->position = 0;
+      }
+    line->text = cursor->scratch;
+    line->length = length;
+    line->segment = NULL;
+    return apivalue_stdio_success;
+  }
+
+static void stdio_release_chain(struct api_stdio * api, struct stdio_chain * chain)
+  {
+    struct stdio_span * next;
+    struct stdio_span * span;
+    struct api_stdlib * stdlib_api;
+
+    (void) api;
+
+    stdlib_api = chain->api_stdlib;
+    for (span = chain->head; span != NULL; span = next)
+      {
+        next = span->next;
+        if (--span->segment->references == 0)
+          stdlib_api->free(stdlib_api, span->segment);
+        stdlib_api->free(stdlib_api, span);
+      }
+    chain->head = NULL;
+    chain->tail = NULL;
+    chain->length = 0;
+  }
+
+static void stdio_release_cursor(struct api_stdio * api, struct stdio_cursor * cursor)
+  {
+    (void) api;
+
+    cursor->chain->api_stdlib->free(cursor->chain->api_stdlib, cursor->scratch);
+    cursor->scratch = NULL;
+    cursor->scratch_capacity = 0;
+  }
+
+/* Writes what's been gathered and gives back the buffer */
+static int stdio_release_sink(struct api_stdio * api, struct stdio_sink * sink)
+  {
+    int rv;
+
+    rv = api->flush_sink(api, sink);
+    sink->api_stdlib->free(sink->api_stdlib, sink->buffer);
+    sink->buffer = NULL;
+    sink->capacity = 0;
+    return rv;
+  }
+
+/*
+ * Writes text that lies within a segment.  When the output is going to a
+ * chain, the segment is referred to, instead of the text being copied
+ */
+static size_t stdio_share(struct api_stdio * api, struct stdio_segment * segment, const char * text, size_t length, FILE * stream)
+  {
+    struct stdio_chain * chain;
+    size_t offset;
+    struct stdio_span * span;
+
+    if (stream != stdout || api->output == NULL || segment == NULL || length == 0)
+      return api->fwrite(api, text, 1, length, stream);
+
+    chain = api->output;
+    offset = (size_t) (text - segment_text(segment));
+    span = chain->tail;
+    if (span != NULL && span->segment == segment && span->offset + span->length == offset)
+      {
+        span->length += length;
+        chain->length += length;
+        api->output_bytes += (unsigned long int) length;
+        return length;
+      }
+    span = chain->api_stdlib->malloc(chain->api_stdlib, sizeof *span);
+    if (span == NULL)
+      return 0;
+    ++segment->references;
+    span->next = NULL;
+    span->segment = segment;
+    span->offset = offset;
+    span->length = length;
+    if (chain->tail != NULL)
+      chain->tail->next = span;
+      else
+      chain->head = span;
+    chain->tail = span;
+    chain->length += length;
+    api->output_bytes += (unsigned long int) length;
+    return length;
+  }
+
 static int stdio_ungetc(struct api_stdio * api, int c, FILE * stream)
   {
     (void) api;
 
     return ungetc(c, stream);
   }
+
+/* Bigger writes go out with whatever's been gathered, without being copied */
+static int write_to_sink(struct stdio_sink * sink, const void * buffer, size_t size)
+  {
+    char * text;
+
+    if (size == 0)
+      return EXIT_SUCCESS;
+    if (size >= apivalue_stdio_sink_threshold)
+      return drain_sink(sink, buffer, size);
+    text = reserve_in_sink(sink, size);
+    if (text == NULL)
+      return EXIT_FAILURE;
+    memcpy(text, buffer, size);
+    sink->used += size;
+    return EXIT_SUCCESS;
+  }
+
+#if CMDCTOY_POSIX
+/* Both pieces go in one system call, unless it's interrupted or only some is written */
+static int write_pieces(int descriptor, const void * first, size_t first_size, const void * second, size_t second_size)
+  {
+    ssize_t count;
+    int piece;
+    struct iovec pieces[2];
+
+    pieces[0].iov_base = (void *) first;
+    pieces[0].iov_len = first_size;
+    pieces[1].iov_base = (void *) second;
+    pieces[1].iov_len = second_size;
+    piece = 0;
+    while (piece < 2)
+      {
+        if (pieces[piece].iov_len == 0)
+          {
+            ++piece;
+            continue;
+          }
+        count = writev(descriptor, pieces + piece, 2 - piece);
+        if (count < 0)
+          {
+            if (errno == EINTR)
+              continue;
+            return EXIT_FAILURE;
+          }
+        for (; piece < 2 && (size_t) count >= pieces[piece].iov_len; ++piece)
+          count -= (ssize_t) pieces[piece].iov_len;
+        if (piece < 2)
+          {
+            pieces[piece].iov_base = (char *) pieces[piece].iov_base + count;
+            pieces[piece].iov_len -= (size_t) count;
+          }
+      }
+    return EXIT_SUCCESS;
+  }
+#endif /* CMDCTOY_POSIX */
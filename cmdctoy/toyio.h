@@ -9,16 +9,48 @@
 enum apivalue_stdio
   {
     apivalue_stdio_success,
+    apivalue_stdio_end_of_chain,
+    apivalue_stdio_error_out_of_memory,
+    /* The usual capacity of a segment, unless a single write needs more */
+    apivalue_stdio_segment_size = 4096,
+    /* Kinds of sink */
+    apivalue_stdio_sink_file,
+    apivalue_stdio_sink_descriptor,
+    apivalue_stdio_sink_memory,
+    /* A sink writes what it's gathered once it has this much, and bigger writes go straight through */
+    apivalue_stdio_sink_threshold = 65536,
     apivalue_stdio_stdio_zero = 0
   };
 
 struct api_stdio;
+struct api_stdlib;
+struct stdio_chain;
+struct stdio_cursor;
+struct stdio_line;
+struct stdio_segment;
+struct stdio_sink;
+struct stdio_span;
 
 typedef enum apivalue_stdio apifunction_stdio_api_initialize(struct api_stdio *);
+typedef size_t apifunction_stdio_append_hex(struct api_stdio *, const void *, size_t, const char *, FILE *);
+typedef size_t apifunction_stdio_append_pointer(struct api_stdio *, const void *, FILE *);
+typedef size_t apifunction_stdio_append_string(struct api_stdio *, const char *, FILE *);
+typedef size_t apifunction_stdio_append_unsigned(struct api_stdio *, unsigned long int, FILE *);
 typedef int apifunction_stdio_feof(struct api_stdio *, FILE *);
 typedef int apifunction_stdio_ferror(struct api_stdio *, FILE *);
 typedef int apifunction_stdio_fgetc(struct api_stdio *, FILE *);
+typedef int apifunction_stdio_flush_sink(struct api_stdio *, struct stdio_sink *);
 typedef int apifunction_stdio_fprintf(struct api_stdio *, FILE *, const char *, ...);
+typedef size_t apifunction_stdio_fwrite(struct api_stdio *, const void *, size_t, size_t, FILE *);
+typedef int apifunction_stdio_grow_buffer(struct api_stdio *, struct api_stdlib *, char **, size_t *, size_t);
+typedef void apifunction_stdio_initialize_chain(struct api_stdio *, struct stdio_chain *, struct api_stdlib *);
+typedef void apifunction_stdio_initialize_cursor(struct api_stdio *, struct stdio_cursor *, struct stdio_chain *);
+typedef void apifunction_stdio_initialize_sink(struct api_stdio *, struct stdio_sink *, enum apivalue_stdio, struct api_stdlib *);
+typedef enum apivalue_stdio apifunction_stdio_read_line(struct api_stdio *, struct stdio_cursor *, struct stdio_line *);
+typedef void apifunction_stdio_release_chain(struct api_stdio *, struct stdio_chain *);
+typedef void apifunction_stdio_release_cursor(struct api_stdio *, struct stdio_cursor *);
+typedef int apifunction_stdio_release_sink(struct api_stdio *, struct stdio_sink *);
+typedef size_t apifunction_stdio_share(struct api_stdio *, struct stdio_segment *, const char *, size_t, FILE *);
 typedef int apifunction_stdio_ungetc(struct api_stdio *, int, FILE *);
 
 extern apifunction_stdio_api_initialize api_stdio_initialize;
@@ -26,12 +58,98 @@ extern apifunction_stdio_api_initialize api_stdio_initialize;
 struct api_stdio
   {
     apifunction_stdio_api_initialize * api_initialize;
+    /* Formatting without printf.  Each gives how many characters were written, which is short on error */
+    apifunction_stdio_append_hex * append_hex;
+    apifunction_stdio_append_pointer * append_pointer;
+    apifunction_stdio_append_string * append_string;
+    apifunction_stdio_append_unsigned * append_unsigned;
     /* The underscore is someWat of a hack for compilers that make feof and ferror macros */
     apifunction_stdio_feof * f_eof;
     apifunction_stdio_ferror * f_error;
     apifunction_stdio_fgetc * fgetc;
+    apifunction_stdio_flush_sink * flush_sink;
     apifunction_stdio_fprintf * fprintf;
+    apifunction_stdio_fwrite * fwrite;
+    /* Makes a buffer at least so many bytes long, doubling its capacity */
+    apifunction_stdio_grow_buffer * grow_buffer;
+    apifunction_stdio_initialize_chain * initialize_chain;
+    apifunction_stdio_initialize_cursor * initialize_cursor;
+    apifunction_stdio_initialize_sink * initialize_sink;
+    apifunction_stdio_read_line * read_line;
+    apifunction_stdio_release_chain * release_chain;
+    apifunction_stdio_release_cursor * release_cursor;
+    apifunction_stdio_release_sink * release_sink;
+    apifunction_stdio_share * share;
     apifunction_stdio_ungetc * ungetc;
+    /* When not NULL, output meant for standard output is gathered here and written in large pieces */
+    struct stdio_sink * sink;
+    /* When not NULL, output meant for standard output goes here, and takes precedence over the sink */
+    struct stdio_chain * output;
+    /* When not NULL, output meant for standard error goes here */
+    struct stdio_chain * error_output;
+    /* Bytes written for standard output, wherever they went, for profiling */
+    unsigned long int output_bytes;
+  };
+
+/* Reference-counted storage, which the text follows */
+struct stdio_segment
+  {
+    size_t references;
+    size_t capacity;
+    size_t used;
+  };
+
+/* Part of a segment */
+struct stdio_span
+  {
+    struct stdio_span * next;
+    struct stdio_segment * segment;
+    size_t offset;
+    size_t length;
+  };
+
+/* In-memory output, such as between the commands of a pipeline */
+struct stdio_chain
+  {
+    struct api_stdlib * api_stdlib;
+    struct stdio_span * head;
+    struct stdio_span * tail;
+    size_t length;
+  };
+
+struct stdio_cursor
+  {
+    struct stdio_chain * chain;
+    struct stdio_span * span;
+    size_t position;
+    /* For lines that cross from one span into another */
+    char * scratch;
+    size_t scratch_capacity;
+  };
+
+/* Includes the line's newline, if it has one */
+struct stdio_line
+  {
+    const char * text;
+    size_t length;
+    /* Where the text is, for sharing it, or NULL if it had to be gathered into scratch */
+    struct stdio_segment * segment;
+  };
+
+/*
+ * Where output is gathered before it's written to a file, to a descriptor
+ * such as a socket's, or to a chain.  Only the member for the kind is used
+ */
+struct stdio_sink
+  {
+    struct api_stdlib * api_stdlib;
+    enum apivalue_stdio kind;
+    FILE * file;
+    int descriptor;
+    struct stdio_chain * chain;
+    char * buffer;
+    size_t capacity;
+    size_t used;
   };
 
 #endif /* INC_CMDCTOY_STDIO */
@@ -1,25 +1,213 @@
 /*
  * Copyright (C) 2024 Shao Miller.  All rights reserved.
  */
+/* TODO: Support more than Linux */
+#if CMDCTOY_POSIX && defined(__linux__)
+/* For MAP_ANONYMOUS and madvise */
+#define _DEFAULT_SOURCE
+#include <sys/mman.h>
+#include <unistd.h>
+#define CMDCTOY_MAP_LARGE 1
+#else
+#define CMDCTOY_MAP_LARGE 0
+#endif /* CMDCTOY_POSIX && defined(__linux__) */
 #include <stdlib.h>
+#include <string.h>
 #include "toylib.h"
 
+#if CMDCTOY_MAP_LARGE
+struct mapping;
+
+/* A large allocation, which has a mapping of its own */
+struct mapping
+  {
+    struct mapping * next;
+    /* What was handed out, and how much of the mapping follows it */
+    void * address;
+    size_t size;
+    /* The whole mapping */
+    void * start;
+    size_t length;
+  };
+
+enum toylib_value
+  {
+    /* The body of a mapping starts on, and is a multiple of, this */
+    huge_page_size = 2097152,
+    toylib_zero = 0
+  };
+
+/* For the alignment that malloc would give */
+union toylib_align
+  {
+    long int align_long;
+    long double align_long_double;
+    void * align_pointer;
+  };
+
+static struct mapping * find_mapping(void *);
+static void * map_block(size_t);
+static void unmap_block(struct mapping *);
+#endif /* CMDCTOY_MAP_LARGE */
 static apifunction_stdlib_free stdlib_free;
 static apifunction_stdlib_malloc stdlib_malloc;
 static apifunction_stdlib_realloc stdlib_realloc;
 
+static struct stdlib_map_counts map_counts;
+#if CMDCTOY_MAP_LARGE
+static struct mapping * mappings;
+static size_t page_size;
+#endif /* CMDCTOY_MAP_LARGE */
+
 static struct api_stdlib api_stdlib_defaults =
   {
     &api_stdlib_initialize,
     &stdlib_free,
     &stdlib_malloc,
-    &stdlib_realloc
+    &stdlib_realloc,
+    0,
+    0
   };
 
+#if CMDCTOY_MAP_LARGE
+/* Blocks are at, or a page or less before, a huge page, so most pointers are ruled out without searching */
+static struct mapping * find_mapping(void * ptr)
+  {
+    struct mapping * mapping;
+    size_t offset;
+
+    if (mappings == NULL)
+      return NULL;
+    offset = (size_t) ptr % huge_page_size;
+    if (offset != 0 && offset < huge_page_size - page_size)
+      return NULL;
+    for (mapping = mappings; mapping != NULL; mapping = mapping->next)
+      {
+        if (mapping->address == ptr)
+          return mapping;
+      }
+    return NULL;
+  }
+
+/*
+ * Reserved huge pages are tried first.  Otherwise, more is mapped than is
+ * needed, then trimmed so that it's aligned for the kernel to back it with
+ * transparent huge pages, which it's advised to do.
+ *
+ * Arenas, and things like identifiers, put headers before what their callers
+ * asked for, so a size that's only a little past a multiple of huge pages is
+ * taken to be such headers.  Then a page is mapped before the body and the
+ * block starts near its end, so that the headers fill the rest of it, what
+ * follows them starts on (or within alignment of) a huge page, and no huge
+ * page is spent on them
+ */
+static void * map_block(size_t size)
+  {
+    char * address;
+    size_t body;
+    size_t head;
+    size_t lead;
+    long int page;
+    struct mapping * mapping;
+    size_t slack;
+
+    if (size > (size_t) -1 - 3 * huge_page_size)
+      return NULL;
+    if (page_size == 0)
+      {
+        page = sysconf(_SC_PAGESIZE);
+        if (page <= 0 || (size_t) page >= huge_page_size || huge_page_size % page != 0)
+          return NULL;
+        page_size = page;
+      }
+    slack = size % huge_page_size;
+    if (slack > page_size - sizeof (union toylib_align))
+      slack = 0;
+    lead = slack > 0 ? page_size : 0;
+    body = (size - slack + huge_page_size - 1) / huge_page_size * huge_page_size;
+    /* The block still has to be aligned for whatever's in it */
+    slack = (slack + sizeof (union toylib_align) - 1) / sizeof (union toylib_align) * sizeof (union toylib_align);
+    mapping = malloc(sizeof *mapping);
+    if (mapping == NULL)
+      return NULL;
+
+#ifdef MAP_HUGETLB
+    /* A lead would cost a whole huge page of its own */
+    if (lead == 0)
+      {
+        address = mmap(NULL, body, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (address != MAP_FAILED)
+          {
+            ++map_counts.huge_maps;
+            goto mapped;
+          }
+      }
+#endif /* MAP_HUGETLB */
+
+    address = mmap(NULL, lead + body + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (address == MAP_FAILED)
+      {
+        free(mapping);
+        return NULL;
+      }
+    head = (huge_page_size - ((size_t) address + lead) % huge_page_size) % huge_page_size;
+    if (head > 0)
+      (void) munmap(address, head);
+    (void) munmap(address + head + lead + body, huge_page_size - head);
+    address += head;
+#ifdef MADV_HUGEPAGE
+    /* Only a hint, so failure doesn't matter */
+    if (madvise(address + lead, body, MADV_HUGEPAGE) == 0)
+      ++map_counts.advised_maps;
+#endif /* MADV_HUGEPAGE */
+
+#ifdef MAP_HUGETLB
+    mapped:
+#endif /* MAP_HUGETLB */
+    mapping->start = address;
+    mapping->length = lead + body;
+    mapping->address = address + lead - slack;
+    mapping->size = body + slack;
+    mapping->next = mappings;
+    mappings = mapping;
+    ++map_counts.mappings;
+    map_counts.mapped_bytes += (unsigned long int) mapping->length;
+    ++map_counts.maps;
+    return mapping->address;
+  }
+
+/* The pages go back to the system straight away */
+static void unmap_block(struct mapping * mapping)
+  {
+    struct mapping ** link;
+
+    for (link = &mappings; *link != mapping; link = &(*link)->next)
+      ;
+    *link = mapping->next;
+    (void) munmap(mapping->start, mapping->length);
+    --map_counts.mappings;
+    map_counts.mapped_bytes -= (unsigned long int) mapping->length;
+    ++map_counts.unmaps;
+    free(mapping);
+  }
+#endif /* CMDCTOY_MAP_LARGE */
+
 static void stdlib_free(struct api_stdlib * api, void * ptr)
   {
+#if CMDCTOY_MAP_LARGE
+    struct mapping * mapping;
+#endif /* CMDCTOY_MAP_LARGE */
+
     (void) api;
 
+#if CMDCTOY_MAP_LARGE
+    mapping = find_mapping(ptr);
+    if (mapping != NULL)
+      {
+        unmap_block(mapping);
+        return;
+      }
+#endif /* CMDCTOY_MAP_LARGE */
     free(ptr);
   }
 
@@ -29,16 +217,66 @@ enum apivalue_stdlib api_stdlib_initialize(struct api_stdlib * api)
     return apivalue_stdlib_success;
   }
 
+const struct stdlib_map_counts * stdlib_map_counts(void)
+  {
+    return &map_counts;
+  }
+
+/* Large allocations are mapped, or come from malloc if they can't be */
 static void * stdlib_malloc(struct api_stdlib * api, size_t size)
   {
-    (void) api;
+    void * ptr;
 
-    return malloc(size);
+    ptr = NULL;
+#if CMDCTOY_MAP_LARGE
+    if (size >= apivalue_stdlib_map_threshold)
+      ptr = map_block(size);
+#endif /* CMDCTOY_MAP_LARGE */
+    if (ptr == NULL)
+      ptr = malloc(size);
+    if (ptr != NULL)
+      {
+        ++api->allocations;
+        api->allocated_bytes += size;
+      }
+    return ptr;
   }
 
+/*
+ * A mapped block stays put if it's big enough, or else moves to a bigger
+ * mapping.  Blocks from malloc stay with malloc, since their sizes aren't
+ * known for copying them into a mapping
+ */
 static void * stdlib_realloc(struct api_stdlib * api, void * ptr, size_t size)
   {
-    (void) api;
+#if CMDCTOY_MAP_LARGE
+    struct mapping * mapping;
+    void * new_ptr;
 
-    return realloc(ptr, size);
+    mapping = find_mapping(ptr);
+    if (mapping != NULL && size <= mapping->size)
+      {
+        ++api->allocations;
+        api->allocated_bytes += size;
+        return ptr;
+      }
+    if (mapping != NULL)
+      {
+        new_ptr = stdlib_malloc(api, size);
+        if (new_ptr == NULL)
+          return NULL;
+        memcpy(new_ptr, ptr, mapping->size);
+        unmap_block(mapping);
+        return new_ptr;
+      }
+#endif /* CMDCTOY_MAP_LARGE */
+    if (ptr == NULL)
+      return stdlib_malloc(api, size);
+    ptr = realloc(ptr, size);
+    if (ptr != NULL)
+      {
+        ++api->allocations;
+        api->allocated_bytes += size;
+      }
+    return ptr;
   }
@@ -9,10 +9,13 @@
 enum apivalue_stdlib
   {
     apivalue_stdlib_success,
-    apivalue_stdlib_zero = 0
+    apivalue_stdlib_zero = 0,
+    /* Allocations at least this big are mapped by themselves, where that's supported */
+    apivalue_stdlib_map_threshold = 2097152
   };
 
 struct api_stdlib;
+struct stdlib_map_counts;
 
 typedef enum apivalue_stdlib apifunction_stdlib_api_initialize(struct api_stdlib *);
 typedef void apifunction_stdlib_free(struct api_stdlib *, void *);
@@ -20,6 +23,9 @@ typedef void * apifunction_stdlib_malloc(struct api_stdlib *, size_t);
 typedef void * apifunction_stdlib_realloc(struct api_stdlib *, void *, size_t);
 
 extern apifunction_stdlib_api_initialize api_stdlib_initialize;
+/* Small allocations come from size-classes of slabs, for the '--slabs' option */
+extern apifunction_stdlib_api_initialize api_stdlib_initialize_slabs;
+extern const struct stdlib_map_counts * stdlib_map_counts(void);
 
 struct api_stdlib
   {
@@ -27,6 +33,23 @@ struct api_stdlib
     apifunction_stdlib_free * free;
     apifunction_stdlib_malloc * malloc;
     apifunction_stdlib_realloc * realloc;
+    /* Successful calls to malloc and realloc, and the sizes asked for, for profiling */
+    unsigned long int allocations;
+    unsigned long int allocated_bytes;
+  };
+
+/* Of the allocations that were mapped by themselves, for every api_stdlib */
+struct stdlib_map_counts
+  {
+    /* Now */
+    unsigned long int mappings;
+    unsigned long int mapped_bytes;
+    /* Ever */
+    unsigned long int maps;
+    unsigned long int unmaps;
+    /* Of 'maps', how many were of reserved huge pages, and how many others were advised to use them */
+    unsigned long int huge_maps;
+    unsigned long int advised_maps;
   };
 
 #endif /* INC_CMDCTOY_STDLIB */
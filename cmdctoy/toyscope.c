@@ -34,7 +34,9 @@ static struct api_toy_scope api_toy_scope_defaults =
     &toy_scope_grow_allocated_chain,
     &toy_scope_initialize_identifier,
     &toy_scope_initialize_scope,
-    &toy_scope_remove_identifier_from_scope
+    &toy_scope_remove_identifier_from_scope,
+    NULL,
+    0
   };
 
 enum apivalue_toy_scope api_toy_scope_initialize(struct api_toy_scope * api)
@@ -69,6 +71,7 @@ static enum apivalue_toy_scope toy_scope_add_identifier_to_scope(struct api_toy_
     btree_rv = btree_api->find_or_insert(btree_api, &identifier->btree_node, &scope->btree, &toy_scope_compare_identifiers, apivalue_btree_insertion_always, &old_btree_node);
     if (btree_rv != apivalue_btree_success)
       return apivalue_toy_scope_error_btree_api;
+    ++api->version;
     if (old_btree_node != NULL)
       {
         old_identifier = type_with_member_at_ptr(struct toy_scope_identifier, btree_node, old_btree_node);
@@ -106,7 +109,7 @@ static enum apivalue_toy_scope toy_scope_allocate_identifier(struct api_toy_scop
         object_type = (void *) type;
         alignment = object_type->alignment;
         if (alignment > 0)
-          padding = (sizeof **identifier + name_size + alignment) % alignment;
+          padding = (alignment - (sizeof **identifier + name_size) % alignment) % alignment;
           else
           padding = 0;
         value_size = object_type->size;
@@ -116,6 +119,8 @@ static enum apivalue_toy_scope toy_scope_allocate_identifier(struct api_toy_scop
         padding = 0;
         value_size = 0;
       }
+    if (value_size > (size_t) -1 - (sizeof *new_identifier + name_size + padding))
+      return apivalue_toy_scope_error_out_of_memory;
     stdlib_api = api->api_stdlib;
     mem = stdlib_api->malloc(stdlib_api, sizeof *new_identifier + name_size + padding + value_size);
     if (mem == NULL)
@@ -245,6 +250,7 @@ static enum apivalue_toy_scope toy_scope_remove_identifier_from_scope(struct api
     btree_rv = btree_api->delete(btree_api, &scope->btree, &identifier->btree_node);
     if (btree_rv != apivalue_btree_success)
       return apivalue_toy_scope_error_not_found;
+    ++api->version;
     /* Unlike a replacement during addition, the caller must free the identifier, if appropriate */
     return apivalue_toy_scope_success;
   }
@@ -51,6 +51,10 @@ struct api_toy_scope
     apifunction_toy_scope_initialize_identifier * initialize_identifier;
     apifunction_toy_scope_initialize_scope * initialize_scope;
     apifunction_toy_scope_remove_identifier_from_scope * remove_identifier_from_scope;
+    /* Set by whichever module provides the primary toy-scope-chain, if any */
+    struct toy_scope_chain * primary_chain;
+    /* Bumped whenever an identifier is added or removed, or the scopes are rearranged */
+    unsigned long int version;
   };
 
 struct toy_scope
@@ -1,8 +1,13 @@
 /*
  * Copyright (C) 2024 Shao Miller.  All rights reserved.
  */
+#include <float.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "toydef.h"
+#include "toylib.h"
 #include "type.h"
 
 /*
@@ -25,8 +30,16 @@ static char sd_enum_name_apivalue_type_success[] = "apivalue_type_success";
 static enum apivalue_type sd_enum_value_apivalue_type_success = apivalue_type_success;
 static char sd_enum_name_apivalue_type_error_buffer_too_small[] = "apivalue_type_error_buffer_too_small";
 static enum apivalue_type sd_enum_value_apivalue_type_error_buffer_too_small = apivalue_type_error_buffer_too_small;
+static char sd_enum_name_apivalue_type_error_invalid_count[] = "apivalue_type_error_invalid_count";
+static enum apivalue_type sd_enum_value_apivalue_type_error_invalid_count = apivalue_type_error_invalid_count;
 static char sd_enum_name_apivalue_type_error_not_compatible[] = "apivalue_type_error_not_compatible";
 static enum apivalue_type sd_enum_value_apivalue_type_error_not_compatible = apivalue_type_error_not_compatible;
+static char sd_enum_name_apivalue_type_error_not_found[] = "apivalue_type_error_not_found";
+static enum apivalue_type sd_enum_value_apivalue_type_error_not_found = apivalue_type_error_not_found;
+static char sd_enum_name_apivalue_type_error_null_argument[] = "apivalue_type_error_null_argument";
+static enum apivalue_type sd_enum_value_apivalue_type_error_null_argument = apivalue_type_error_null_argument;
+static char sd_enum_name_apivalue_type_error_out_of_memory[] = "apivalue_type_error_out_of_memory";
+static enum apivalue_type sd_enum_value_apivalue_type_error_out_of_memory = apivalue_type_error_out_of_memory;
 static char sd_enum_name_apivalue_type_zero[] = "apivalue_type_zero";
 static enum apivalue_type sd_enum_value_apivalue_type_zero = apivalue_type_zero;
 
@@ -34,7 +47,11 @@ static struct type_enum_value sd_enum_values_apivalue_type[] =
   {
     { sd_enum_name_apivalue_type_success, &sd_enum_value_apivalue_type_success },
     { sd_enum_name_apivalue_type_error_buffer_too_small, &sd_enum_value_apivalue_type_error_buffer_too_small },
+    { sd_enum_name_apivalue_type_error_invalid_count, &sd_enum_value_apivalue_type_error_invalid_count },
     { sd_enum_name_apivalue_type_error_not_compatible, &sd_enum_value_apivalue_type_error_not_compatible },
+    { sd_enum_name_apivalue_type_error_not_found, &sd_enum_value_apivalue_type_error_not_found },
+    { sd_enum_name_apivalue_type_error_null_argument, &sd_enum_value_apivalue_type_error_null_argument },
+    { sd_enum_name_apivalue_type_error_out_of_memory, &sd_enum_value_apivalue_type_error_out_of_memory },
     { sd_enum_name_apivalue_type_zero, &sd_enum_value_apivalue_type_zero }
   };
 
@@ -74,7 +91,9 @@ static struct type_enum sd_enum_type_apivalue_type =
     /* value_count */
     countof(sd_enum_values_apivalue_type),
     /* values */
-    sd_enum_values_apivalue_type
+    sd_enum_values_apivalue_type,
+    /* index */
+    NULL
   };
 
 static char sd_enum_name_apivalue_type_arithmetic_integer[] = "apivalue_type_arithmetic_integer";
@@ -127,7 +146,9 @@ static struct type_enum sd_enum_type_apivalue_type_arithmetic =
     /* value_count */
     countof(sd_enum_values_apivalue_type_arithmetic),
     /* values */
-    sd_enum_values_apivalue_type_arithmetic
+    sd_enum_values_apivalue_type_arithmetic,
+    /* index */
+    NULL
   };
 
 static char sd_enum_name_apivalue_type_floating_float[] = "apivalue_type_floating_float";
@@ -183,7 +204,9 @@ static struct type_enum sd_enum_type_apivalue_type_floating =
     /* value_count */
     countof(sd_enum_values_apivalue_type_floating),
     /* values */
-    sd_enum_values_apivalue_type_floating
+    sd_enum_values_apivalue_type_floating,
+    /* index */
+    NULL
   };
 
 static char sd_enum_name_apivalue_type_integer_char[] = "apivalue_type_integer_char";
@@ -251,7 +274,9 @@ static struct type_enum sd_enum_type_apivalue_type_integer =
     /* value_count */
     countof(sd_enum_values_apivalue_type_integer),
     /* values */
-    sd_enum_values_apivalue_type_integer
+    sd_enum_values_apivalue_type_integer,
+    /* index */
+    NULL
   };
 
 static char sd_enum_name_apivalue_type_object_void[] = "apivalue_type_object_void";
@@ -316,7 +341,9 @@ static struct type_enum sd_enum_type_apivalue_type_object =
     /* value_count */
     countof(sd_enum_values_apivalue_type_object),
     /* values */
-    sd_enum_values_apivalue_type_object
+    sd_enum_values_apivalue_type_object,
+    /* index */
+    NULL
   };
 
 static char sd_enum_name_apivalue_type_partition_function[] = "apivalue_type_partition_function";
@@ -369,7 +396,9 @@ static struct type_enum sd_enum_type_apivalue_type_partition =
     /* value_count */
     countof(sd_enum_values_apivalue_type_partition),
     /* values */
-    sd_enum_values_apivalue_type_partition
+    sd_enum_values_apivalue_type_partition,
+    /* index */
+    NULL
   };
 
 static char sd_enum_name_apivalue_type_sign_implementation_defined[] = "apivalue_type_sign_implementation_defined";
@@ -425,7 +454,9 @@ static struct type_enum sd_enum_type_apivalue_type_sign =
     /* value_count */
     countof(sd_enum_values_apivalue_type_sign),
     /* values */
-    sd_enum_values_apivalue_type_sign
+    sd_enum_values_apivalue_type_sign,
+    /* index */
+    NULL
   };
 
 typedef struct alignof_char { char c; char t; } alignof_char;
@@ -551,6 +582,330 @@ static struct type_integer sd_integer_size_t =
     apivalue_type_unsigned
   };
 
+typedef struct alignof_signed_char { char c; signed char t; } alignof_signed_char;
+static struct type_integer sd_integer_signed_char =
+  {
+    /* arithmetic */
+    {
+      /* object */
+      {
+        /* type */
+        {
+          /* partition */
+          apivalue_type_partition_object,
+          /* nice_name */
+          "signed char"
+        },
+        /* object_type */
+        apivalue_type_object_arithmetic,
+        /* alignment */
+        align_hack(alignof_signed_char),
+        /* size */
+        sizeof (signed char)
+      },
+      /* arithmetic_type */
+      apivalue_type_arithmetic_integer
+    },
+    /* integer_type */
+    apivalue_type_integer_char,
+    /* sign */
+    apivalue_type_signed
+  };
+
+typedef struct alignof_unsigned_char { char c; unsigned char t; } alignof_unsigned_char;
+static struct type_integer sd_integer_unsigned_char =
+  {
+    /* arithmetic */
+    {
+      /* object */
+      {
+        /* type */
+        {
+          /* partition */
+          apivalue_type_partition_object,
+          /* nice_name */
+          "unsigned char"
+        },
+        /* object_type */
+        apivalue_type_object_arithmetic,
+        /* alignment */
+        align_hack(alignof_unsigned_char),
+        /* size */
+        sizeof (unsigned char)
+      },
+      /* arithmetic_type */
+      apivalue_type_arithmetic_integer
+    },
+    /* integer_type */
+    apivalue_type_integer_char,
+    /* sign */
+    apivalue_type_unsigned
+  };
+
+typedef struct alignof_short { char c; short int t; } alignof_short;
+static struct type_integer sd_integer_short =
+  {
+    /* arithmetic */
+    {
+      /* object */
+      {
+        /* type */
+        {
+          /* partition */
+          apivalue_type_partition_object,
+          /* nice_name */
+          "short int"
+        },
+        /* object_type */
+        apivalue_type_object_arithmetic,
+        /* alignment */
+        align_hack(alignof_short),
+        /* size */
+        sizeof (short int)
+      },
+      /* arithmetic_type */
+      apivalue_type_arithmetic_integer
+    },
+    /* integer_type */
+    apivalue_type_integer_short,
+    /* sign */
+    apivalue_type_signed
+  };
+
+typedef struct alignof_unsigned_short { char c; unsigned short int t; } alignof_unsigned_short;
+static struct type_integer sd_integer_unsigned_short =
+  {
+    /* arithmetic */
+    {
+      /* object */
+      {
+        /* type */
+        {
+          /* partition */
+          apivalue_type_partition_object,
+          /* nice_name */
+          "unsigned short int"
+        },
+        /* object_type */
+        apivalue_type_object_arithmetic,
+        /* alignment */
+        align_hack(alignof_unsigned_short),
+        /* size */
+        sizeof (unsigned short int)
+      },
+      /* arithmetic_type */
+      apivalue_type_arithmetic_integer
+    },
+    /* integer_type */
+    apivalue_type_integer_short,
+    /* sign */
+    apivalue_type_unsigned
+  };
+
+typedef struct alignof_int { char c; int t; } alignof_int;
+static struct type_integer sd_integer_int =
+  {
+    /* arithmetic */
+    {
+      /* object */
+      {
+        /* type */
+        {
+          /* partition */
+          apivalue_type_partition_object,
+          /* nice_name */
+          "int"
+        },
+        /* object_type */
+        apivalue_type_object_arithmetic,
+        /* alignment */
+        align_hack(alignof_int),
+        /* size */
+        sizeof (int)
+      },
+      /* arithmetic_type */
+      apivalue_type_arithmetic_integer
+    },
+    /* integer_type */
+    apivalue_type_integer_int,
+    /* sign */
+    apivalue_type_signed
+  };
+
+typedef struct alignof_unsigned_int { char c; unsigned int t; } alignof_unsigned_int;
+static struct type_integer sd_integer_unsigned_int =
+  {
+    /* arithmetic */
+    {
+      /* object */
+      {
+        /* type */
+        {
+          /* partition */
+          apivalue_type_partition_object,
+          /* nice_name */
+          "unsigned int"
+        },
+        /* object_type */
+        apivalue_type_object_arithmetic,
+        /* alignment */
+        align_hack(alignof_unsigned_int),
+        /* size */
+        sizeof (unsigned int)
+      },
+      /* arithmetic_type */
+      apivalue_type_arithmetic_integer
+    },
+    /* integer_type */
+    apivalue_type_integer_int,
+    /* sign */
+    apivalue_type_unsigned
+  };
+
+typedef struct alignof_long { char c; long int t; } alignof_long;
+static struct type_integer sd_integer_long =
+  {
+    /* arithmetic */
+    {
+      /* object */
+      {
+        /* type */
+        {
+          /* partition */
+          apivalue_type_partition_object,
+          /* nice_name */
+          "long int"
+        },
+        /* object_type */
+        apivalue_type_object_arithmetic,
+        /* alignment */
+        align_hack(alignof_long),
+        /* size */
+        sizeof (long int)
+      },
+      /* arithmetic_type */
+      apivalue_type_arithmetic_integer
+    },
+    /* integer_type */
+    apivalue_type_integer_long,
+    /* sign */
+    apivalue_type_signed
+  };
+
+typedef struct alignof_unsigned_long { char c; unsigned long int t; } alignof_unsigned_long;
+static struct type_integer sd_integer_unsigned_long =
+  {
+    /* arithmetic */
+    {
+      /* object */
+      {
+        /* type */
+        {
+          /* partition */
+          apivalue_type_partition_object,
+          /* nice_name */
+          "unsigned long int"
+        },
+        /* object_type */
+        apivalue_type_object_arithmetic,
+        /* alignment */
+        align_hack(alignof_unsigned_long),
+        /* size */
+        sizeof (unsigned long int)
+      },
+      /* arithmetic_type */
+      apivalue_type_arithmetic_integer
+    },
+    /* integer_type */
+    apivalue_type_integer_long,
+    /* sign */
+    apivalue_type_unsigned
+  };
+
+typedef struct alignof_float { char c; float t; } alignof_float;
+static struct type_floating sd_floating_float =
+  {
+    /* arithmetic */
+    {
+      /* object */
+      {
+        /* type */
+        {
+          /* partition */
+          apivalue_type_partition_object,
+          /* nice_name */
+          "float"
+        },
+        /* object_type */
+        apivalue_type_object_arithmetic,
+        /* alignment */
+        align_hack(alignof_float),
+        /* size */
+        sizeof (float)
+      },
+      /* arithmetic_type */
+      apivalue_type_arithmetic_floating
+    },
+    /* floating_type */
+    apivalue_type_floating_float
+  };
+
+typedef struct alignof_double { char c; double t; } alignof_double;
+static struct type_floating sd_floating_double =
+  {
+    /* arithmetic */
+    {
+      /* object */
+      {
+        /* type */
+        {
+          /* partition */
+          apivalue_type_partition_object,
+          /* nice_name */
+          "double"
+        },
+        /* object_type */
+        apivalue_type_object_arithmetic,
+        /* alignment */
+        align_hack(alignof_double),
+        /* size */
+        sizeof (double)
+      },
+      /* arithmetic_type */
+      apivalue_type_arithmetic_floating
+    },
+    /* floating_type */
+    apivalue_type_floating_double
+  };
+
+typedef struct alignof_long_double { char c; long double t; } alignof_long_double;
+static struct type_floating sd_floating_long_double =
+  {
+    /* arithmetic */
+    {
+      /* object */
+      {
+        /* type */
+        {
+          /* partition */
+          apivalue_type_partition_object,
+          /* nice_name */
+          "long double"
+        },
+        /* object_type */
+        apivalue_type_object_arithmetic,
+        /* alignment */
+        align_hack(alignof_long_double),
+        /* size */
+        sizeof (long double)
+      },
+      /* arithmetic_type */
+      apivalue_type_arithmetic_floating
+    },
+    /* floating_type */
+    apivalue_type_floating_long_double
+  };
+
 static struct type_struct_member sd_struct_members_type[] =
   {
     { "partition", &sd_enum_type_apivalue_type_partition.integer.arithmetic.object, offsetof(struct type, partition), 0 }
@@ -883,7 +1238,8 @@ static struct type_struct_member sd_struct_members_type_enum[] =
     { "integer", &sd_struct_type_integer.object, offsetof(struct type_enum, integer), 0 },
     { "tag", &sd_pointer_to_char.object, offsetof(struct type_enum, tag), 0 },
     { "value_count", &sd_integer_size_t.arithmetic.object, offsetof(struct type_enum, value_count), 0 },
-    { "values", &sd_pointer_to_struct_enum_value.object, offsetof(struct type_enum, values), 0 }
+    { "values", &sd_pointer_to_struct_enum_value.object, offsetof(struct type_enum, values), 0 },
+    { "index", &sd_pointer_to_void.object, offsetof(struct type_enum, index), 0 }
   };
 
 typedef struct alignof_struct_type_enum { char c; struct type_enum t; } alignof_struct_type_enum;
@@ -1141,8 +1497,19 @@ static struct sd_type sd_types[] =
     { "sd_enum_type_apivalue_type_object", &sd_enum_type_apivalue_type_object.integer.arithmetic.object.type },
     { "sd_enum_type_apivalue_type_partition", &sd_enum_type_apivalue_type_partition.integer.arithmetic.object.type },
     { "sd_enum_type_apivalue_type_sign", &sd_enum_type_apivalue_type_sign.integer.arithmetic.object.type },
+    { "sd_floating_double", &sd_floating_double.arithmetic.object.type },
+    { "sd_floating_float", &sd_floating_float.arithmetic.object.type },
+    { "sd_floating_long_double", &sd_floating_long_double.arithmetic.object.type },
     { "sd_integer_char", &sd_integer_char.arithmetic.object.type },
+    { "sd_integer_int", &sd_integer_int.arithmetic.object.type },
+    { "sd_integer_long", &sd_integer_long.arithmetic.object.type },
+    { "sd_integer_short", &sd_integer_short.arithmetic.object.type },
+    { "sd_integer_signed_char", &sd_integer_signed_char.arithmetic.object.type },
     { "sd_integer_size_t", &sd_integer_size_t.arithmetic.object.type },
+    { "sd_integer_unsigned_char", &sd_integer_unsigned_char.arithmetic.object.type },
+    { "sd_integer_unsigned_int", &sd_integer_unsigned_int.arithmetic.object.type },
+    { "sd_integer_unsigned_long", &sd_integer_unsigned_long.arithmetic.object.type },
+    { "sd_integer_unsigned_short", &sd_integer_unsigned_short.arithmetic.object.type },
     { "sd_pointer_to_char", &sd_pointer_to_char.object.type },
     { "sd_pointer_to_struct_enum_value", &sd_pointer_to_struct_enum_value.object.type },
     { "sd_pointer_to_struct_type", &sd_pointer_to_struct_type.object.type },
@@ -1168,24 +1535,91 @@ static struct sd_type sd_types[] =
     { NULL, NULL }
   };
 
+enum type_sort_key
+  {
+    type_sort_key_signed,
+    type_sort_key_unsigned,
+    type_sort_key_float,
+    type_sort_key_double,
+    type_sort_key_long_double,
+    type_sort_keys
+  };
+
+struct type_compatibility_visit
+  {
+    struct type * type_a;
+    struct type * type_b;
+    struct type_compatibility_visit * outer;
+  };
+
+static apifunction_type_array_type type_array_type;
 static apifunction_type_compatible_types type_compatible_types;
+static apifunction_type_enum_name_of_value type_enum_name_of_value;
+static apifunction_type_enum_value_of_name type_enum_value_of_name;
+static apifunction_type_forget_caches type_forget_caches;
 static apifunction_type_fulltype_of_type type_fulltype_of_type;
+static apifunction_type_read_enum type_read_enum;
+static apifunction_type_release_types type_release_types;
+static apifunction_type_sort_array type_sort_array;
+static struct type_compatibility * compatibility_find(struct type_compatibility_table *, struct type *, struct type *);
+static int compatibility_grow(struct api_type *, struct type_compatibility_table *);
+static size_t compatibility_hash(struct type *, struct type *);
+static void compatibility_note(struct api_type *, struct type *, struct type *, enum apivalue_type);
+static void compatibility_settle(struct api_type *, enum apivalue_type_memo);
+static enum apivalue_type compatible_types_visit(struct api_type *, struct type *, struct type *, struct type_compatibility_visit *);
+static int compare_enum_pairs(const void *, const void *);
+static struct type_enum_index * enum_index(struct api_type *, struct type_enum *);
+static size_t hash_name(const char *);
+static int names_differ(const char *, const char *);
+static int sort_bits_fit(size_t);
+static int sort_compare_keys(enum type_sort_key, const unsigned char *, const unsigned char *, size_t);
+static enum type_sort_key sort_key_of_type(struct type_object *);
+static unsigned long int sort_load_bits(const unsigned char *, size_t);
+static enum apivalue_type sort_merge(struct api_type *, unsigned char *, size_t, size_t, size_t, size_t, enum type_sort_key, int);
+static enum apivalue_type sort_radix(struct api_type *, unsigned char *, size_t, size_t, enum type_sort_key, int);
+static void sort_store_bits(unsigned char *, size_t, unsigned long int);
 
 static struct api_type api_type_defaults =
   {
+    NULL,
     &api_type_initialize,
+    &type_array_type,
     &type_compatible_types,
+    &type_enum_name_of_value,
+    &type_enum_value_of_name,
+    &type_forget_caches,
     &type_fulltype_of_type,
+    &type_read_enum,
+    &type_release_types,
+    &type_sort_array,
     countof(sd_types) - 1,
     sd_types,
+    0,
+    {
+      0,
+      0,
+      NULL
+    },
+    {
+      0,
+      0,
+      NULL
+    },
+    NULL,
+    NULL,
     0
   };
 
 enum apivalue_type api_type_initialize(struct api_type * api)
   {
     unsigned char * hint[2];
+    struct api_stdlib * stdlib_api;
 
+    stdlib_api = api->api_stdlib;
+    if (stdlib_api == NULL)
+      return apivalue_type_error_null_argument;
     *api = api_type_defaults;
+    api->api_stdlib = stdlib_api;
     /* Consider possible endianness */
     hint[0] = (unsigned char *) hint + 0;
     hint[1] = (unsigned char *) hint + 1;
@@ -1195,8 +1629,249 @@ enum apivalue_type api_type_initialize(struct api_type * api)
     return apivalue_type_success;
   }
 
-/* This can be slow */
+static enum apivalue_type type_array_type(struct api_type * api, struct type_object * element_type, size_t element_count, struct type_array ** array_type)
+  {
+    size_t digits;
+    struct type_array_instance * instance;
+    char * mem;
+    size_t name_size;
+    struct api_stdlib * stdlib_api;
+    size_t temp;
+
+    if (api == NULL || element_type == NULL || array_type == NULL)
+      return apivalue_type_error_null_argument;
+    if (element_count == 0)
+      return apivalue_type_error_invalid_count;
+    /* Arrays of incomplete types aren't allowed */
+    if (element_type->size == 0)
+      return apivalue_type_error_not_compatible;
+    if (element_count > (size_t) -1 / element_type->size)
+      return apivalue_type_error_out_of_memory;
+    /* Each array type is only made once */
+    for (instance = api->array_types; instance != NULL; instance = instance->next)
+      {
+        if (instance->array.element_type == element_type && instance->array.element_count == element_count)
+          {
+            *array_type = &instance->array;
+            return apivalue_type_success;
+          }
+      }
+    for (digits = 1, temp = element_count; temp >= 10; temp /= 10)
+      ++digits;
+    /* For the brackets and the terminator */
+    name_size = strlen(element_type->type.nice_name) + digits + 3;
+    stdlib_api = api->api_stdlib;
+    mem = stdlib_api->malloc(stdlib_api, sizeof *instance + name_size);
+    if (mem == NULL)
+      return apivalue_type_error_out_of_memory;
+    instance = (void *) mem;
+    instance->array.object.type.partition = apivalue_type_partition_object;
+    instance->array.object.type.nice_name = mem + sizeof *instance;
+    (void) sprintf(instance->array.object.type.nice_name, "%s[%lu]", element_type->type.nice_name, (unsigned long int) element_count);
+    instance->array.object.object_type = apivalue_type_object_array;
+    instance->array.object.alignment = element_type->alignment;
+    instance->array.object.size = element_count * element_type->size;
+    instance->array.element_type = element_type;
+    instance->array.element_count = element_count;
+    instance->next = api->array_types;
+    api->array_types = instance;
+    ++api->version;
+    *array_type = &instance->array;
+    return apivalue_type_success;
+  }
+
+static struct type_compatibility * compatibility_find(struct type_compatibility_table * table, struct type * type_a, struct type * type_b)
+  {
+    struct type_compatibility * entry;
+    size_t i;
+    size_t mask;
+
+    if (table->capacity == 0)
+      return NULL;
+    mask = table->capacity - 1;
+    for (i = compatibility_hash(type_a, type_b) & mask; ; i = (i + 1) & mask)
+      {
+        entry = table->entries + i;
+        if (entry->memo == apivalue_type_memo_empty)
+          return NULL;
+        if (entry->memo == apivalue_type_memo_removed)
+          continue;
+        if (entry->type_a == type_a && entry->type_b == type_b)
+          return entry;
+        /* Compatibility is symmetric */
+        if (entry->type_a == type_b && entry->type_b == type_a)
+          return entry;
+      }
+  }
+
+static int compatibility_grow(struct api_type * api, struct type_compatibility_table * table)
+  {
+    struct type_compatibility * entries;
+    struct type_compatibility * entry;
+    size_t i;
+    size_t j;
+    size_t mask;
+    size_t new_capacity;
+    struct api_stdlib * stdlib_api;
+
+    stdlib_api = api->api_stdlib;
+    new_capacity = table->capacity == 0 ? 64 : table->capacity * 2;
+    if (new_capacity < table->capacity || new_capacity > (size_t) -1 / sizeof *entries)
+      return EXIT_FAILURE;
+    entries = stdlib_api->malloc(stdlib_api, new_capacity * sizeof *entries);
+    if (entries == NULL)
+      return EXIT_FAILURE;
+    for (i = 0; i < new_capacity; ++i)
+      entries[i].memo = apivalue_type_memo_empty;
+    /* Re-insert, leaving removed entries behind */
+    mask = new_capacity - 1;
+    for (i = 0; i < table->capacity; ++i)
+      {
+        entry = table->entries + i;
+        if (entry->memo == apivalue_type_memo_empty || entry->memo == apivalue_type_memo_removed)
+          continue;
+        for (j = compatibility_hash(entry->type_a, entry->type_b) & mask; entries[j].memo != apivalue_type_memo_empty; j = (j + 1) & mask)
+          continue;
+        entries[j] = *entry;
+      }
+    table->count = 0;
+    for (i = 0; i < new_capacity; ++i)
+      {
+        if (entries[i].memo != apivalue_type_memo_empty)
+          ++table->count;
+      }
+    stdlib_api->free(stdlib_api, table->entries);
+    table->entries = entries;
+    table->capacity = new_capacity;
+    return EXIT_SUCCESS;
+  }
+
+/* Hash the pointer representations, symmetrically, since the pair's order doesn't matter */
+static size_t compatibility_hash(struct type * type_a, struct type * type_b)
+  {
+    unsigned char bytes[2][sizeof (struct type *)];
+    size_t hash[2];
+    size_t i;
+    size_t j;
+
+    memcpy(bytes[0], &type_a, sizeof type_a);
+    memcpy(bytes[1], &type_b, sizeof type_b);
+    for (i = 0; i < countof(bytes); ++i)
+      {
+        hash[i] = 2166136261UL;
+        for (j = 0; j < sizeof bytes[i]; ++j)
+          {
+            hash[i] ^= bytes[i][j];
+            hash[i] *= 16777619UL;
+          }
+      }
+    return hash[0] ^ hash[1];
+  }
+
+/*
+ * A negative outcome is final, even when found beneath a pair that was assumed
+ * to be compatible.  A positive outcome only becomes final once the outermost
+ * check succeeds, so until then, it's tentative
+ */
+static void compatibility_note(struct api_type * api, struct type * type_a, struct type * type_b, enum apivalue_type outcome)
+  {
+    struct type_compatibility * entry;
+    size_t i;
+    size_t mask;
+    enum apivalue_type_memo memo;
+    struct type_compatibility * pending;
+    struct api_stdlib * stdlib_api;
+    struct type_compatibility_table * table;
+
+    stdlib_api = api->api_stdlib;
+    if (outcome == apivalue_type_success)
+      {
+        memo = apivalue_type_memo_tentative;
+        table = &api->compatibility_pending;
+        if (table->count == table->capacity)
+          {
+            if (table->capacity == 0)
+              i = 16;
+              else
+              i = table->capacity * 2;
+            if (i < table->capacity || i > (size_t) -1 / sizeof *pending)
+              return;
+            pending = stdlib_api->realloc(stdlib_api, table->entries, i * sizeof *pending);
+            if (pending == NULL)
+              return;
+            table->entries = pending;
+            table->capacity = i;
+          }
+        pending = table->entries + table->count;
+        pending->type_a = type_a;
+        pending->type_b = type_b;
+        pending->memo = memo;
+        ++table->count;
+      }
+      else
+      {
+        memo = apivalue_type_memo_not_compatible;
+        pending = NULL;
+      }
+    table = &api->compatibility_memo;
+    /* Keep at least a quarter of the table empty, so that probing terminates quickly */
+    if ((table->count + 1) * 4 > table->capacity * 3 && compatibility_grow(api, table) != EXIT_SUCCESS)
+      {
+        /* Not remembering is only slower, but forget the pending pair */
+        if (pending != NULL)
+          --api->compatibility_pending.count;
+        return;
+      }
+    mask = table->capacity - 1;
+    for (i = compatibility_hash(type_a, type_b) & mask; ; i = (i + 1) & mask)
+      {
+        entry = table->entries + i;
+        if (entry->memo == apivalue_type_memo_empty)
+          {
+            ++table->count;
+            break;
+          }
+        if (entry->memo == apivalue_type_memo_removed)
+          break;
+      }
+    entry->type_a = type_a;
+    entry->type_b = type_b;
+    entry->memo = memo;
+  }
+
+static void compatibility_settle(struct api_type * api, enum apivalue_type_memo memo)
+  {
+    struct type_compatibility * entry;
+    size_t i;
+    struct type_compatibility * pending;
+
+    for (i = 0; i < api->compatibility_pending.count; ++i)
+      {
+        pending = api->compatibility_pending.entries + i;
+        entry = compatibility_find(&api->compatibility_memo, pending->type_a, pending->type_b);
+        if (entry != NULL && entry->memo == apivalue_type_memo_tentative)
+          entry->memo = memo;
+      }
+    api->compatibility_pending.count = 0;
+  }
+
 static enum apivalue_type type_compatible_types(struct api_type * api, struct type * type_a, struct type * type_b)
+  {
+    enum apivalue_type rv;
+
+    if (api == NULL || type_a == NULL || type_b == NULL)
+      return apivalue_type_error_null_argument;
+    rv = compatible_types_visit(api, type_a, type_b, NULL);
+    /* Assumptions made along the way have now been either confirmed or refuted */
+    if (rv == apivalue_type_success)
+      compatibility_settle(api, apivalue_type_memo_compatible);
+      else
+      compatibility_settle(api, apivalue_type_memo_removed);
+    return rv;
+  }
+
+/* This can be slow, the first time for a given pair of structures or unions */
+static enum apivalue_type compatible_types_visit(struct api_type * api, struct type * type_a, struct type * type_b, struct type_compatibility_visit * visit)
   {
     struct type_array * array_a;
     struct type_array * array_b;
@@ -1206,20 +1881,30 @@ static enum apivalue_type type_compatible_types(struct api_type * api, struct ty
     struct type_enum * enum_a;
     struct type_enum * enum_b;
     struct type_enum_value * enum_value_a;
-    struct type_enum_value * enum_value_b;
     struct type_floating * floating_a;
     struct type_floating * floating_b;
     size_t i;
     struct type_integer * integer_a;
     struct type_integer * integer_b;
+    size_t j;
+    struct type_struct_member * member_a;
+    struct type_struct_member * member_b;
+    struct type_compatibility * memo;
     struct type_object * object_a;
     struct type_object * object_b;
+    struct type_compatibility_visit * outer;
     struct type_pointer * pointer_a;
     struct type_pointer * pointer_b;
+    enum apivalue_type rv;
     struct type_struct * struct_a;
     struct type_struct * struct_b;
+    struct type_compatibility_visit this_visit;
     struct type_union * union_a;
     struct type_union * union_b;
+    struct type_union_member * union_member_a;
+    struct type_union_member * union_member_b;
+    long int value_a;
+    long int value_b;
 
     /* 2 types are compatible if they are the same type, believe it or not */
     if (type_a == type_b)
@@ -1255,7 +1940,7 @@ static enum apivalue_type type_compatible_types(struct api_type * api, struct ty
               {
                 case apivalue_type_arithmetic_integer:
                 integer_a = type_with_member_at_ptr(struct type_integer, arithmetic, arithmetic_a);
-                integer_b = type_with_member_at_ptr(struct type_integer, arithmetic, arithmetic_a);
+                integer_b = type_with_member_at_ptr(struct type_integer, arithmetic, arithmetic_b);
                 if (integer_a->integer_type != integer_b->integer_type)
                   return apivalue_type_error_not_compatible;
                 if (integer_a->sign != integer_b->sign)
@@ -1276,28 +1961,20 @@ static enum apivalue_type type_compatible_types(struct api_type * api, struct ty
                     count = enum_a->value_count;
                     if (count != enum_b->value_count)
                       return apivalue_type_error_not_compatible;
-                    if (enum_a->tag != enum_b->tag)
-                      {
-                        if (strcmp(enum_a->tag, enum_b->tag) != 0)
-                          return apivalue_type_error_not_compatible;
-                      }
+                    if (names_differ(enum_a->tag, enum_b->tag))
+                      return apivalue_type_error_not_compatible;
                     if (enum_a->values != enum_b->values)
                       {
-                        /* TODO: This expects the same order of values, which isn't right */
+                        /* The enumeration constants can be listed in any order */
                         for (i = 0; i < count; ++i)
                           {
                             enum_value_a = enum_a->values + i;
-                            enum_value_b = enum_b->values + i;
-                            if (enum_value_a->name != enum_value_b->name)
-                              {
-                                if (strcmp(enum_value_a->name, enum_value_b->name) != 0)
-                                  return apivalue_type_error_not_compatible;
-                              }
-                            if (enum_value_a->value != enum_value_b->value)
-                              {
-                                if (memcmp(enum_value_a->value, enum_value_b->value, object_a->size) != 0)
-                                  return apivalue_type_error_not_compatible;
-                              }
+                            if (api->read_enum(api, enum_a, enum_value_a->value, &value_a) != apivalue_type_success)
+                              return apivalue_type_error_not_compatible;
+                            if (api->enum_value_of_name(api, enum_b, enum_value_a->name, &value_b) != apivalue_type_success)
+                              return apivalue_type_error_not_compatible;
+                            if (value_a != value_b)
+                              return apivalue_type_error_not_compatible;
                           }
                       }
                     return apivalue_type_success;
@@ -1323,38 +2000,88 @@ static enum apivalue_type type_compatible_types(struct api_type * api, struct ty
             array_b = type_with_member_at_ptr(struct type_array, object, object_b);
             if (array_a->element_count != array_b->element_count)
               return apivalue_type_error_not_compatible;
-            return api->compatible_types(api, &array_a->element_type->type, &array_b->element_type->type);
+            return compatible_types_visit(api, &array_a->element_type->type, &array_b->element_type->type, visit);
 
             case apivalue_type_object_struct:
-            struct_a = type_with_member_at_ptr(struct type_struct, object, object_a);
-            struct_b = type_with_member_at_ptr(struct type_struct, object, object_b);
-            if (struct_a->tag != struct_b->tag)
+            case apivalue_type_object_union:
+            /* Has this pair been seen before? */
+            memo = compatibility_find(&api->compatibility_memo, type_a, type_b);
+            if (memo != NULL)
               {
-                if (strcmp(struct_a->tag, struct_b->tag) != 0)
+                /* A tentative pair can only turn out to be wrong if the outermost check fails, anyway */
+                if (memo->memo == apivalue_type_memo_not_compatible)
                   return apivalue_type_error_not_compatible;
+                return apivalue_type_success;
               }
-            if (struct_a->member_count != struct_b->member_count)
-              return apivalue_type_error_not_compatible;
-            /* TODO: Finish the member-checking, later */
-            return apivalue_type_success;
-
-            case apivalue_type_object_union:
-            union_a = type_with_member_at_ptr(struct type_union, object, object_a);
-            union_b = type_with_member_at_ptr(struct type_union, object, object_b);
-            if (union_a->tag != union_b->tag)
+            /* Is this pair already being checked, further out?  If so, assume so, for now */
+            for (outer = visit; outer != NULL; outer = outer->outer)
               {
-                if (strcmp(union_a->tag, union_b->tag) != 0)
-                  return apivalue_type_error_not_compatible;
+                if (outer->type_a == type_a && outer->type_b == type_b)
+                  return apivalue_type_success;
+                if (outer->type_a == type_b && outer->type_b == type_a)
+                  return apivalue_type_success;
               }
-            if (union_a->member_count != union_b->member_count)
-              return apivalue_type_error_not_compatible;
-            /* TODO: Finish the member-checking, later */
-            return apivalue_type_success;
+            this_visit.type_a = type_a;
+            this_visit.type_b = type_b;
+            this_visit.outer = visit;
+            rv = apivalue_type_success;
+            if (object_a->object_type == apivalue_type_object_struct)
+              {
+                struct_a = type_with_member_at_ptr(struct type_struct, object, object_a);
+                struct_b = type_with_member_at_ptr(struct type_struct, object, object_b);
+                if (names_differ(struct_a->tag, struct_b->tag))
+                  rv = apivalue_type_error_not_compatible;
+                  else if (struct_a->member_count != struct_b->member_count)
+                  rv = apivalue_type_error_not_compatible;
+                /* Structure members must correspond in order */
+                for (i = 0; i < struct_a->member_count && rv == apivalue_type_success; ++i)
+                  {
+                    member_a = struct_a->members + i;
+                    member_b = struct_b->members + i;
+                    if (names_differ(member_a->name, member_b->name))
+                      rv = apivalue_type_error_not_compatible;
+                      else if (member_a->offset != member_b->offset)
+                      rv = apivalue_type_error_not_compatible;
+                      else if (member_a->bitfield_width != member_b->bitfield_width)
+                      rv = apivalue_type_error_not_compatible;
+                      else
+                      rv = compatible_types_visit(api, &member_a->type->type, &member_b->type->type, &this_visit);
+                  }
+              }
+              else
+              {
+                union_a = type_with_member_at_ptr(struct type_union, object, object_a);
+                union_b = type_with_member_at_ptr(struct type_union, object, object_b);
+                if (names_differ(union_a->tag, union_b->tag))
+                  rv = apivalue_type_error_not_compatible;
+                  else if (union_a->member_count != union_b->member_count)
+                  rv = apivalue_type_error_not_compatible;
+                /* Union members correspond by name, in any order */
+                for (i = 0; i < union_a->member_count && rv == apivalue_type_success; ++i)
+                  {
+                    union_member_a = union_a->members + i;
+                    union_member_b = NULL;
+                    for (j = 0; j < union_b->member_count; ++j)
+                      {
+                        if (!names_differ(union_member_a->name, union_b->members[j].name))
+                          {
+                            union_member_b = union_b->members + j;
+                            break;
+                          }
+                      }
+                    if (union_member_b == NULL)
+                      rv = apivalue_type_error_not_compatible;
+                      else
+                      rv = compatible_types_visit(api, &union_member_a->type->type, &union_member_b->type->type, &this_visit);
+                  }
+              }
+            compatibility_note(api, type_a, type_b, rv);
+            return rv;
 
             case apivalue_type_object_pointer:
             pointer_a = type_with_member_at_ptr(struct type_pointer, object, object_a);
             pointer_b = type_with_member_at_ptr(struct type_pointer, object, object_b);
-            return api->compatible_types(api, pointer_a->referenced_type, pointer_b->referenced_type);
+            return compatible_types_visit(api, pointer_a->referenced_type, pointer_b->referenced_type, visit);
 
             default:
             return apivalue_type_error_not_compatible;
@@ -1367,6 +2094,236 @@ static enum apivalue_type type_compatible_types(struct api_type * api, struct ty
     return apivalue_type_error_not_compatible;
   }
 
+static int compare_enum_pairs(const void * a, const void * b)
+  {
+    const struct type_enum_pair * pair_a;
+    const struct type_enum_pair * pair_b;
+
+    pair_a = a;
+    pair_b = b;
+    if (pair_a->value != pair_b->value)
+      return pair_a->value < pair_b->value ? -1 : 1;
+    /* For duplicate values, the first-declared name wins */
+    if (pair_a->position != pair_b->position)
+      return pair_a->position < pair_b->position ? -1 : 1;
+    return 0;
+  }
+
+/* Returns NULL if the index can't be built, in which case callers search linearly */
+static struct type_enum_index * enum_index(struct api_type * api, struct type_enum * type_enum)
+  {
+    size_t count;
+    size_t dense_count;
+    size_t i;
+    struct type_enum_index * index;
+    size_t j;
+    size_t mask;
+    long int maximum;
+    char * mem;
+    long int minimum;
+    size_t name_capacity;
+    unsigned long int range;
+    size_t size;
+    struct api_stdlib * stdlib_api;
+    long int value;
+
+    if (type_enum->index != NULL)
+      return type_enum->index;
+    count = type_enum->value_count;
+    if (count == 0 || count > ((size_t) -1 >> 4) / sizeof (struct type_enum_pair))
+      return NULL;
+    /* Find the range of values */
+    minimum = 0;
+    maximum = 0;
+    for (i = 0; i < count; ++i)
+      {
+        if (type_enum->values[i].name == NULL)
+          return NULL;
+        if (api->read_enum(api, type_enum, type_enum->values[i].value, &value) != apivalue_type_success)
+          return NULL;
+        if (i == 0 || value < minimum)
+          minimum = value;
+        if (i == 0 || value > maximum)
+          maximum = value;
+      }
+    /* At most half-empty, for the names */
+    for (name_capacity = 16; name_capacity < count * 2; name_capacity *= 2)
+      continue;
+    /* Values that are close together can be looked up directly */
+    range = (unsigned long int) maximum - (unsigned long int) minimum;
+    if (range < count * 2 + 16)
+      dense_count = (size_t) range + 1;
+      else
+      dense_count = 0;
+    /* The index's members include a long int and a size_t, so its size suits the pairs' alignment */
+    size = sizeof *index + name_capacity * sizeof *index->names;
+    if (dense_count > 0)
+      size += dense_count * sizeof *index->dense;
+      else
+      size += count * sizeof *index->sorted;
+    stdlib_api = api->api_stdlib;
+    mem = stdlib_api->malloc(stdlib_api, size);
+    if (mem == NULL)
+      return NULL;
+    index = (void *) mem;
+    index->type_enum = type_enum;
+    index->minimum = minimum;
+    index->maximum = maximum;
+    index->name_capacity = name_capacity;
+    mem += sizeof *index;
+    if (dense_count > 0)
+      {
+        index->sorted = NULL;
+      }
+      else
+      {
+        index->sorted = (void *) mem;
+        mem += count * sizeof *index->sorted;
+      }
+    index->names = (void *) mem;
+    mem += name_capacity * sizeof *index->names;
+    if (dense_count > 0)
+      index->dense = (void *) mem;
+      else
+      index->dense = NULL;
+    /* Positions are stored plus one, so that zero means nothing */
+    for (i = 0; i < name_capacity; ++i)
+      index->names[i] = 0;
+    for (i = 0; i < dense_count; ++i)
+      index->dense[i] = 0;
+    mask = name_capacity - 1;
+    for (i = 0; i < count; ++i)
+      {
+        for (j = hash_name(type_enum->values[i].name) & mask; index->names[j] != 0; j = (j + 1) & mask)
+          continue;
+        index->names[j] = i + 1;
+        (void) api->read_enum(api, type_enum, type_enum->values[i].value, &value);
+        if (index->dense != NULL)
+          {
+            j = (size_t) ((unsigned long int) value - (unsigned long int) minimum);
+            /* For duplicate values, the first-declared name wins */
+            if (index->dense[j] == 0)
+              index->dense[j] = i + 1;
+          }
+          else
+          {
+            index->sorted[i].value = value;
+            index->sorted[i].position = i;
+          }
+      }
+    if (index->sorted != NULL)
+      qsort(index->sorted, count, sizeof *index->sorted, &compare_enum_pairs);
+    index->next = api->enum_indices;
+    api->enum_indices = index;
+    type_enum->index = index;
+    /* The index is part of what 'typedump' shows */
+    ++api->version;
+    return index;
+  }
+
+static enum apivalue_type type_enum_name_of_value(struct api_type * api, struct type_enum * type_enum, long int value, char ** name)
+  {
+    size_t high;
+    size_t i;
+    struct type_enum_index * index;
+    size_t low;
+    size_t middle;
+    long int other;
+
+    if (api == NULL || type_enum == NULL || name == NULL)
+      return apivalue_type_error_null_argument;
+    index = enum_index(api, type_enum);
+    if (index == NULL)
+      {
+        for (i = 0; i < type_enum->value_count; ++i)
+          {
+            if (api->read_enum(api, type_enum, type_enum->values[i].value, &other) != apivalue_type_success)
+              continue;
+            if (other == value)
+              {
+                *name = type_enum->values[i].name;
+                return apivalue_type_success;
+              }
+          }
+        return apivalue_type_error_not_found;
+      }
+    if (value < index->minimum || value > index->maximum)
+      return apivalue_type_error_not_found;
+    if (index->dense != NULL)
+      {
+        i = index->dense[(size_t) ((unsigned long int) value - (unsigned long int) index->minimum)];
+        if (i == 0)
+          return apivalue_type_error_not_found;
+        *name = type_enum->values[i - 1].name;
+        return apivalue_type_success;
+      }
+    /* Find the first pair having the value */
+    low = 0;
+    high = type_enum->value_count;
+    while (low < high)
+      {
+        middle = low + (high - low) / 2;
+        if (index->sorted[middle].value < value)
+          low = middle + 1;
+          else
+          high = middle;
+      }
+    if (low == type_enum->value_count || index->sorted[low].value != value)
+      return apivalue_type_error_not_found;
+    *name = type_enum->values[index->sorted[low].position].name;
+    return apivalue_type_success;
+  }
+
+static enum apivalue_type type_enum_value_of_name(struct api_type * api, struct type_enum * type_enum, const char * name, long int * value)
+  {
+    size_t i;
+    struct type_enum_index * index;
+    size_t mask;
+
+    if (api == NULL || type_enum == NULL || name == NULL || value == NULL)
+      return apivalue_type_error_null_argument;
+    index = enum_index(api, type_enum);
+    if (index == NULL)
+      {
+        for (i = 0; i < type_enum->value_count; ++i)
+          {
+            if (!names_differ(type_enum->values[i].name, name))
+              return api->read_enum(api, type_enum, type_enum->values[i].value, value);
+          }
+        return apivalue_type_error_not_found;
+      }
+    mask = index->name_capacity - 1;
+    for (i = hash_name(name) & mask; index->names[i] != 0; i = (i + 1) & mask)
+      {
+        if (strcmp(type_enum->values[index->names[i] - 1].name, name) == 0)
+          return api->read_enum(api, type_enum, type_enum->values[index->names[i] - 1].value, value);
+      }
+    return apivalue_type_error_not_found;
+  }
+
+static void type_forget_caches(struct api_type * api)
+  {
+    struct type_enum_index * index;
+    struct api_stdlib * stdlib_api;
+
+    stdlib_api = api->api_stdlib;
+    stdlib_api->free(stdlib_api, api->compatibility_memo.entries);
+    api->compatibility_memo.entries = NULL;
+    api->compatibility_memo.capacity = 0;
+    api->compatibility_memo.count = 0;
+    stdlib_api->free(stdlib_api, api->compatibility_pending.entries);
+    api->compatibility_pending.entries = NULL;
+    api->compatibility_pending.capacity = 0;
+    api->compatibility_pending.count = 0;
+    while ((index = api->enum_indices) != NULL)
+      {
+        api->enum_indices = index->next;
+        index->type_enum->index = NULL;
+        stdlib_api->free(stdlib_api, index);
+        ++api->version;
+      }
+  }
+
 static struct type * type_fulltype_of_type(struct api_type * api, struct type * type)
   {
     struct type_arithmetic * arithmetic;
@@ -1427,3 +2384,482 @@ static struct type * type_fulltype_of_type(struct api_type * api, struct type *
       }
     return NULL;
   }
+
+static size_t hash_name(const char * name)
+  {
+    size_t hash;
+
+    hash = 2166136261UL;
+    for (; *name != '\0'; ++name)
+      {
+        hash ^= (unsigned char) *name;
+        hash *= 16777619UL;
+      }
+    return hash;
+  }
+
+/* Enumerated types are compatible with some integer type, so read the value as such */
+static enum apivalue_type type_read_enum(struct api_type * api, struct type_enum * type_enum, const void * object, long int * value)
+  {
+    int is_unsigned;
+    signed char sc;
+    short int si;
+    int i;
+    long int li;
+    size_t size;
+    unsigned char uc;
+    unsigned short int usi;
+    unsigned int ui;
+    unsigned long int uli;
+
+    (void) api;
+
+    if (type_enum == NULL || object == NULL || value == NULL)
+      return apivalue_type_error_null_argument;
+    size = type_enum->integer.arithmetic.object.size;
+    is_unsigned = type_enum->integer.sign == apivalue_type_unsigned;
+    if (size == sizeof i)
+      {
+        if (is_unsigned)
+          {
+            memcpy(&ui, object, sizeof ui);
+            *value = (long int) ui;
+          }
+          else
+          {
+            memcpy(&i, object, sizeof i);
+            *value = i;
+          }
+        return apivalue_type_success;
+      }
+    if (size == sizeof li)
+      {
+        if (is_unsigned)
+          {
+            memcpy(&uli, object, sizeof uli);
+            *value = (long int) uli;
+          }
+          else
+          {
+            memcpy(&li, object, sizeof li);
+            *value = li;
+          }
+        return apivalue_type_success;
+      }
+    if (size == sizeof si)
+      {
+        if (is_unsigned)
+          {
+            memcpy(&usi, object, sizeof usi);
+            *value = usi;
+          }
+          else
+          {
+            memcpy(&si, object, sizeof si);
+            *value = si;
+          }
+        return apivalue_type_success;
+      }
+    if (size == sizeof sc)
+      {
+        if (is_unsigned)
+          {
+            memcpy(&uc, object, sizeof uc);
+            *value = uc;
+          }
+          else
+          {
+            memcpy(&sc, object, sizeof sc);
+            *value = sc;
+          }
+        return apivalue_type_success;
+      }
+    return apivalue_type_error_not_compatible;
+  }
+
+static void type_release_types(struct api_type * api)
+  {
+    struct type_array_instance * instance;
+    struct api_stdlib * stdlib_api;
+
+    stdlib_api = api->api_stdlib;
+    while ((instance = api->array_types) != NULL)
+      {
+        api->array_types = instance->next;
+        stdlib_api->free(stdlib_api, instance);
+      }
+    ++api->version;
+  }
+
+/* Sorting */
+
+static enum type_sort_key sort_key_of_type(struct type_object * object_type)
+  {
+    struct type_arithmetic * arithmetic_type;
+    struct type_floating * floating_type;
+    struct type_integer * integer_type;
+
+    if (object_type->object_type != apivalue_type_object_arithmetic)
+      return type_sort_keys;
+    arithmetic_type = type_with_member_at_ptr(struct type_arithmetic, object, object_type);
+    if (arithmetic_type->arithmetic_type == apivalue_type_arithmetic_floating)
+      {
+        floating_type = type_with_member_at_ptr(struct type_floating, arithmetic, arithmetic_type);
+        switch (floating_type->floating_type)
+          {
+            case apivalue_type_floating_float:
+            return object_type->size == sizeof (float) ? type_sort_key_float : type_sort_keys;
+
+            case apivalue_type_floating_double:
+            return object_type->size == sizeof (double) ? type_sort_key_double : type_sort_keys;
+
+            case apivalue_type_floating_long_double:
+            return object_type->size == sizeof (long double) ? type_sort_key_long_double : type_sort_keys;
+
+            case apivalue_type_floatings:
+            break;
+          }
+        return type_sort_keys;
+      }
+    integer_type = type_with_member_at_ptr(struct type_integer, arithmetic, arithmetic_type);
+    /* Without 'long long int' in C89, there's nothing to read wider integers into */
+    if (!sort_bits_fit(object_type->size))
+      return type_sort_keys;
+    if (integer_type->integer_type == apivalue_type_integer_size_t || integer_type->sign == apivalue_type_unsigned)
+      return type_sort_key_unsigned;
+    if (integer_type->integer_type == apivalue_type_integer_char && integer_type->sign == apivalue_type_sign_implementation_defined && CHAR_MIN == 0)
+      return type_sort_key_unsigned;
+    return type_sort_key_signed;
+  }
+
+static int sort_bits_fit(size_t size)
+  {
+    return size == sizeof (unsigned char) || size == sizeof (unsigned short int) || size == sizeof (unsigned int) || size == sizeof (unsigned long int);
+  }
+
+static unsigned long int sort_load_bits(const unsigned char * object, size_t size)
+  {
+    unsigned char uc;
+    unsigned int ui;
+    unsigned long int uli;
+    unsigned short int usi;
+
+    if (size == sizeof ui)
+      {
+        memcpy(&ui, object, sizeof ui);
+        return ui;
+      }
+    if (size == sizeof uli)
+      {
+        memcpy(&uli, object, sizeof uli);
+        return uli;
+      }
+    if (size == sizeof usi)
+      {
+        memcpy(&usi, object, sizeof usi);
+        return usi;
+      }
+    uc = *object;
+    return uc;
+  }
+
+static void sort_store_bits(unsigned char * object, size_t size, unsigned long int bits)
+  {
+    unsigned int ui;
+    unsigned short int usi;
+
+    if (size == sizeof ui)
+      {
+        ui = (unsigned int) bits;
+        memcpy(object, &ui, sizeof ui);
+        return;
+      }
+    if (size == sizeof bits)
+      {
+        memcpy(object, &bits, sizeof bits);
+        return;
+      }
+    if (size == sizeof usi)
+      {
+        usi = (unsigned short int) bits;
+        memcpy(object, &usi, sizeof usi);
+        return;
+      }
+    *object = (unsigned char) bits;
+  }
+
+static int sort_compare_keys(enum type_sort_key key, const unsigned char * a, const unsigned char * b, size_t size)
+  {
+    double da;
+    double db;
+    float fa;
+    float fb;
+    long double lda;
+    long double ldb;
+    long int sa;
+    long int sb;
+    unsigned long int ua;
+    unsigned long int ub;
+    unsigned long int sign;
+
+    switch (key)
+      {
+        case type_sort_key_signed:
+        /* Sign-extend */
+        sign = 1UL << (size * CHAR_BIT - 1);
+        ua = sort_load_bits(a, size);
+        ub = sort_load_bits(b, size);
+        sa = ua & sign ? -(long int) (~ua & (sign - 1)) - 1 : (long int) ua;
+        sb = ub & sign ? -(long int) (~ub & (sign - 1)) - 1 : (long int) ub;
+        return (sa > sb) - (sa < sb);
+
+        case type_sort_key_unsigned:
+        ua = sort_load_bits(a, size);
+        ub = sort_load_bits(b, size);
+        return (ua > ub) - (ua < ub);
+
+        case type_sort_key_float:
+        memcpy(&fa, a, sizeof fa);
+        memcpy(&fb, b, sizeof fb);
+        return (fa > fb) - (fa < fb);
+
+        case type_sort_key_double:
+        memcpy(&da, a, sizeof da);
+        memcpy(&db, b, sizeof db);
+        return (da > db) - (da < db);
+
+        case type_sort_key_long_double:
+        memcpy(&lda, a, sizeof lda);
+        memcpy(&ldb, b, sizeof ldb);
+        return (lda > ldb) - (lda < ldb);
+
+        case type_sort_keys:
+        break;
+      }
+    return 0;
+  }
+
+/* Stable, bottom-up, over positions, so that large elements are only moved once */
+static enum apivalue_type sort_merge(struct api_type * api, unsigned char * array, size_t count, size_t element_size, size_t key_offset, size_t key_size, enum type_sort_key key, int descending)
+  {
+    int comparison;
+    unsigned char * elements;
+    size_t i;
+    size_t left;
+    size_t left_end;
+    char * mem;
+    size_t * positions;
+    size_t right;
+    size_t right_end;
+    size_t start;
+    struct api_stdlib * stdlib_api;
+    size_t * swap;
+    size_t * temp;
+    size_t width;
+
+    if (count > ((size_t) -1 / 2) / sizeof *positions || count > (size_t) -1 / element_size)
+      return apivalue_type_error_out_of_memory;
+    stdlib_api = api->api_stdlib;
+    mem = stdlib_api->malloc(stdlib_api, count * 2 * sizeof *positions);
+    if (mem == NULL)
+      return apivalue_type_error_out_of_memory;
+    positions = (void *) mem;
+    temp = positions + count;
+    for (i = 0; i < count; ++i)
+      positions[i] = i;
+    for (width = 1; width < count; width *= 2)
+      {
+        for (start = 0; start < count; start += 2 * width)
+          {
+            left = start;
+            left_end = start + width < count ? start + width : count;
+            right = left_end;
+            right_end = left_end + width < count ? left_end + width : count;
+            i = start;
+            while (left < left_end && right < right_end)
+              {
+                comparison = sort_compare_keys(key, array + positions[right] * element_size + key_offset, array + positions[left] * element_size + key_offset, key_size);
+                if (descending)
+                  comparison = -comparison;
+                /* Equal keys keep their order */
+                if (comparison < 0)
+                  temp[i++] = positions[right++];
+                  else
+                  temp[i++] = positions[left++];
+              }
+            while (left < left_end)
+              temp[i++] = positions[left++];
+            while (right < right_end)
+              temp[i++] = positions[right++];
+          }
+        swap = positions;
+        positions = temp;
+        temp = swap;
+      }
+    /* Arrange the elements */
+    elements = stdlib_api->malloc(stdlib_api, count * element_size);
+    if (elements == NULL)
+      {
+        stdlib_api->free(stdlib_api, mem);
+        return apivalue_type_error_out_of_memory;
+      }
+    for (i = 0; i < count; ++i)
+      memcpy(elements + i * element_size, array + positions[i] * element_size, element_size);
+    memcpy(array, elements, count * element_size);
+    stdlib_api->free(stdlib_api, elements);
+    stdlib_api->free(stdlib_api, mem);
+    return apivalue_type_success;
+  }
+
+/*
+ * Least-significant digit first, over keys whose unsigned order is the
+ * elements' order.  The keys are turned back into elements afterwards, so
+ * only the keys are moved around
+ */
+static enum apivalue_type sort_radix(struct api_type * api, unsigned char * array, size_t count, size_t element_size, enum type_sort_key key, int descending)
+  {
+    unsigned long int bits;
+    size_t counts[256];
+    size_t digit;
+    size_t i;
+    unsigned long int * keys;
+    unsigned long int mask;
+    unsigned long int * other;
+    size_t position;
+    unsigned int shift;
+    unsigned long int sign;
+    struct api_stdlib * stdlib_api;
+    unsigned long int * swap;
+    unsigned long int * temp;
+    size_t total;
+    unsigned int width;
+
+    if (count > ((size_t) -1 / 2) / sizeof *keys)
+      return apivalue_type_error_out_of_memory;
+    stdlib_api = api->api_stdlib;
+    keys = stdlib_api->malloc(stdlib_api, count * 2 * sizeof *keys);
+    if (keys == NULL)
+      return apivalue_type_error_out_of_memory;
+    temp = keys;
+    other = keys + count;
+    width = (unsigned int) (element_size * CHAR_BIT);
+    sign = 1UL << (width - 1);
+    mask = sign | (sign - 1);
+    for (i = 0; i < count; ++i)
+      {
+        bits = sort_load_bits(array + i * element_size, element_size);
+        switch (key)
+          {
+            case type_sort_key_signed:
+            bits ^= sign;
+            break;
+
+            case type_sort_key_float:
+            case type_sort_key_double:
+            /* Negative numbers are in reverse order */
+            bits = bits & sign ? ~bits & mask : bits | sign;
+            break;
+
+            default:
+            break;
+          }
+        keys[i] = bits;
+      }
+    for (shift = 0; shift < width; shift += 8)
+      {
+        for (digit = 0; digit < countof(counts); ++digit)
+          counts[digit] = 0;
+        for (i = 0; i < count; ++i)
+          ++counts[(keys[i] >> shift) & 0xFF];
+        /* Skip a digit that every key shares */
+        if (counts[(keys[0] >> shift) & 0xFF] == count)
+          continue;
+        for (total = 0, digit = 0; digit < countof(counts); ++digit)
+          {
+            position = counts[digit];
+            counts[digit] = total;
+            total += position;
+          }
+        for (i = 0; i < count; ++i)
+          other[counts[(keys[i] >> shift) & 0xFF]++] = keys[i];
+        swap = keys;
+        keys = other;
+        other = swap;
+      }
+    for (i = 0; i < count; ++i)
+      {
+        bits = keys[i];
+        switch (key)
+          {
+            case type_sort_key_signed:
+            bits ^= sign;
+            break;
+
+            case type_sort_key_float:
+            case type_sort_key_double:
+            bits = bits & sign ? bits ^ sign : ~bits & mask;
+            break;
+
+            default:
+            break;
+          }
+        sort_store_bits(array + (descending ? count - 1 - i : i) * element_size, element_size, bits);
+      }
+    stdlib_api->free(stdlib_api, temp);
+    return apivalue_type_success;
+  }
+
+static enum apivalue_type type_sort_array(struct api_type * api, struct type_array * array_type, void * array, const char * member_name, int descending)
+  {
+    struct type_object * element_type;
+    enum type_sort_key key;
+    size_t i;
+    struct type_struct_member * member;
+    struct type_struct * struct_type;
+
+    if (api == NULL || array_type == NULL || array == NULL)
+      return apivalue_type_error_null_argument;
+    element_type = array_type->element_type;
+    if (element_type->size == 0)
+      return apivalue_type_error_not_compatible;
+    if (array_type->element_count < 2)
+      return apivalue_type_success;
+    if (member_name == NULL)
+      {
+        key = sort_key_of_type(element_type);
+        if (key == type_sort_keys)
+          return apivalue_type_error_not_compatible;
+        /* The bit-flipping trick assumes IEEE 754 */
+        if (key == type_sort_key_long_double || (key == type_sort_key_float && (FLT_MANT_DIG != 24 || !sort_bits_fit(sizeof (float)))) || (key == type_sort_key_double && (DBL_MANT_DIG != 53 || !sort_bits_fit(sizeof (double)))))
+          return sort_merge(api, array, array_type->element_count, element_type->size, 0, element_type->size, key, descending);
+        return sort_radix(api, array, array_type->element_count, element_type->size, key, descending);
+      }
+    /* Otherwise, sort structures by a member */
+    if (element_type->object_type != apivalue_type_object_struct)
+      return apivalue_type_error_not_compatible;
+    struct_type = type_with_member_at_ptr(struct type_struct, object, element_type);
+    for (i = 0; i < struct_type->member_count; ++i)
+      {
+        member = struct_type->members + i;
+        if (!names_differ(member->name, member_name))
+          break;
+      }
+    if (i == struct_type->member_count)
+      return apivalue_type_error_not_found;
+    if (member->bitfield_width != 0)
+      return apivalue_type_error_not_compatible;
+    key = sort_key_of_type(member->type);
+    if (key == type_sort_keys)
+      return apivalue_type_error_not_compatible;
+    return sort_merge(api, array, array_type->element_count, element_type->size, member->offset, member->type->size, key, descending);
+  }
+
+/* Tags and member names can be absent */
+static int names_differ(const char * name_a, const char * name_b)
+  {
+    if (name_a == name_b)
+      return 0;
+    if (name_a == NULL || name_b == NULL)
+      return 1;
+    return strcmp(name_a, name_b) != 0;
+  }
@@ -10,7 +10,11 @@ enum apivalue_type
   {
     apivalue_type_success,
     apivalue_type_error_buffer_too_small,
+    apivalue_type_error_invalid_count,
     apivalue_type_error_not_compatible,
+    apivalue_type_error_not_found,
+    apivalue_type_error_null_argument,
+    apivalue_type_error_out_of_memory,
     apivalue_type_zero = 0
   };
 
@@ -41,6 +45,16 @@ enum apivalue_type_integer
     apivalue_type_integers
   };
 
+enum apivalue_type_memo
+  {
+    apivalue_type_memo_empty,
+    apivalue_type_memo_removed,
+    apivalue_type_memo_tentative,
+    apivalue_type_memo_compatible,
+    apivalue_type_memo_not_compatible,
+    apivalue_type_memos
+  };
+
 enum apivalue_type_object
   {
     apivalue_type_object_void,
@@ -71,8 +85,13 @@ struct api_type;
 struct sd_type;
 struct type;
 struct type_array;
+struct type_array_instance;
 struct type_arithmetic;
+struct type_compatibility;
+struct type_compatibility_table;
 struct type_enum;
+struct type_enum_index;
+struct type_enum_pair;
 struct type_floating;
 struct type_function;
 struct type_integer;
@@ -85,19 +104,58 @@ struct type_union_alignment;
 struct type_union_members;
 
 typedef enum apivalue_type apifunction_type_api_initialize(struct api_type *);
+typedef enum apivalue_type apifunction_type_array_type(struct api_type *, struct type_object *, size_t, struct type_array **);
 typedef enum apivalue_type apifunction_type_compatible_types(struct api_type *, struct type *, struct type *);
+typedef enum apivalue_type apifunction_type_enum_name_of_value(struct api_type *, struct type_enum *, long int, char **);
+typedef enum apivalue_type apifunction_type_enum_value_of_name(struct api_type *, struct type_enum *, const char *, long int *);
+typedef void apifunction_type_forget_caches(struct api_type *);
 typedef struct type * apifunction_type_fulltype_of_type(struct api_type *, struct type *);
+typedef enum apivalue_type apifunction_type_read_enum(struct api_type *, struct type_enum *, const void *, long int *);
+typedef void apifunction_type_release_types(struct api_type *);
+typedef enum apivalue_type apifunction_type_sort_array(struct api_type *, struct type_array *, void *, const char *, int);
 
 extern apifunction_type_api_initialize api_type_initialize;
 
+struct type_compatibility
+  {
+    struct type * type_a;
+    struct type * type_b;
+    enum apivalue_type_memo memo;
+  };
+
+struct type_compatibility_table
+  {
+    size_t capacity;
+    size_t count;
+    struct type_compatibility * entries;
+  };
+
 struct api_type
   {
+    struct api_stdlib * api_stdlib;
     apifunction_type_api_initialize * api_initialize;
+    apifunction_type_array_type * array_type;
     apifunction_type_compatible_types * compatible_types;
+    apifunction_type_enum_name_of_value * enum_name_of_value;
+    apifunction_type_enum_value_of_name * enum_value_of_name;
+    apifunction_type_forget_caches * forget_caches;
     apifunction_type_fulltype_of_type * fulltype_of_type;
+    apifunction_type_read_enum * read_enum;
+    apifunction_type_release_types * release_types;
+    apifunction_type_sort_array * sort_array;
     size_t type_count;
     struct sd_type * types;
     int pointer_hint;
+    /* Outcomes for pairs of structures and unions, so that each pair is only walked once */
+    struct type_compatibility_table compatibility_memo;
+    /* Pairs found compatible during a check that hasn't finished, yet */
+    struct type_compatibility_table compatibility_pending;
+    /* Every enumeration index that has been built, so that they can be forgotten */
+    struct type_enum_index * enum_indices;
+    /* Array types made at run-time, which last until release_types */
+    struct type_array_instance * array_types;
+    /* Bumped whenever array types are made or released, and whenever enumeration indices are built or forgotten */
+    unsigned long int version;
   };
 
 struct sd_type
@@ -132,6 +190,12 @@ struct type_array
     size_t element_count;
   };
 
+struct type_array_instance
+  {
+    struct type_array_instance * next;
+    struct type_array array;
+  };
+
 struct type_arithmetic
   {
     struct type_object object;
@@ -157,6 +221,8 @@ struct type_enum
     char * tag;
     size_t value_count;
     struct type_enum_value * values;
+    /* Built upon first use */
+    struct type_enum_index * index;
   };
 
 struct type_enum_value
@@ -165,6 +231,28 @@ struct type_enum_value
     void * value;
   };
 
+struct type_enum_pair
+  {
+    long int value;
+    size_t position;
+  };
+
+/*
+ * Names hash to positions in the values array.  Values map to positions
+ * directly, when the values are close together, or else by binary search
+ */
+struct type_enum_index
+  {
+    struct type_enum_index * next;
+    struct type_enum * type_enum;
+    long int minimum;
+    long int maximum;
+    size_t name_capacity;
+    size_t * names;
+    size_t * dense;
+    struct type_enum_pair * sorted;
+  };
+
 /* Not intended for use outside of sizeof and offsetof */
 struct type_enum_alignment
   {
@@ -207,7 +295,7 @@ struct type_union
     struct type_object object;
     char * tag;
     size_t member_count;
-    struct type_union_mmeber * members;
+    struct type_union_member * members;
   };
 
 struct type_union_member